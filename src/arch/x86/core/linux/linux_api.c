@@ -46,6 +46,16 @@ __kernel_ssize_t linux_write ( int fd, const void *buf,
 	return linux_syscall  (  __NR_write, fd, buf, count );
 }
 
+__kernel_ssize_t linux_readv ( int fd, const struct linux_iovec *iov,
+			       int iovcnt ) {
+	return linux_syscall ( __NR_readv, fd, iov, iovcnt );
+}
+
+__kernel_ssize_t linux_writev ( int fd, const struct linux_iovec *iov,
+				int iovcnt ) {
+	return linux_syscall ( __NR_writev, fd, iov, iovcnt );
+}
+
 int linux_fcntl ( int fd, int cmd, ... ) {
 	long arg;
 	va_list list;
@@ -104,3 +114,24 @@ void * linux_mremap ( void *old_address, __kernel_size_t old_size,
 int linux_munmap ( void *addr, __kernel_size_t length ) {
 	return linux_syscall ( __NR_munmap, addr, length );
 }
+
+int linux_socket ( int domain, int type, int protocol ) {
+	return linux_syscall ( __NR_socket, domain, type, protocol );
+}
+
+int linux_bind ( int fd, const struct sockaddr *addr, int addrlen ) {
+	return linux_syscall ( __NR_bind, fd, addr, addrlen );
+}
+
+int linux_setsockopt ( int fd, int level, int optname,
+		       const void *optval, int optlen ) {
+	return linux_syscall ( __NR_setsockopt, fd, level, optname,
+			       optval, optlen );
+}
+
+__kernel_ssize_t linux_sendto ( int fd, const void *buf,
+				__kernel_size_t len, int flags,
+				const struct sockaddr *addr, int addrlen ) {
+	return linux_syscall ( __NR_sendto, fd, buf, len, flags,
+			       addr, addrlen );
+}
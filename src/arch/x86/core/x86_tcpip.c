@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+/** @file
+ *
+ * TCP/IP checksum
+ *
+ */
+
+#include <ipxe/tcpip.h>
+
+/** Number of native words summed per loop iteration */
+#define X86_TCPIP_UNROLL 4
+
+/** Number of bytes summed per loop iteration */
+#define X86_TCPIP_BLOCK ( X86_TCPIP_UNROLL * sizeof ( unsigned long ) )
+
+/**
+ * Calculate continued TCP/IP checkum
+ *
+ * @v partial		Checksum of already-summed data, in network byte order
+ * @v data		Data buffer
+ * @v len		Length of data buffer
+ * @ret cksum		Updated checksum, in network byte order
+ *
+ * The bulk of the data is summed a native word (32 or 64 bits) at a
+ * time using add-with-carry, with the carry flag propagated across
+ * the whole block and folded only once at the end.  Any trailing
+ * partial block is handed off to the generic implementation.
+ *
+ * x86 permits unaligned accesses, and the ones' complement sum is
+ * independent of the word size used, so no alignment fixups are
+ * required.
+ */
+uint16_t x86_tcpip_continue_chksum ( uint16_t partial,
+				     const void *data, size_t len ) {
+	unsigned long sum = ( ( ~partial ) & 0xffff );
+	unsigned long count = ( len / X86_TCPIP_BLOCK );
+	const void *end;
+	unsigned long discard_count;
+
+	/* Sum whole blocks */
+	if ( count ) {
+		__asm__ ( "clc\n\t"
+			  "\n1:\n\t"
+			  "adc 0(%2), %0\n\t"
+			  "adc %c6(%2), %0\n\t"
+			  "adc %c7(%2), %0\n\t"
+			  "adc %c8(%2), %0\n\t"
+			  /* "lea" and "dec" preserve the carry flag */
+			  "lea %c9(%2), %2\n\t"
+			  "dec %1\n\t"
+			  "jnz 1b\n\t"
+			  /* Add in final carry (which may itself carry) */
+			  "adc $0, %0\n\t"
+			  "adc $0, %0\n\t"
+			  : "=r" ( sum ), "=r" ( discard_count ),
+			    "=r" ( end )
+			  : "0" ( sum ), "1" ( count ), "2" ( data ),
+			    "i" ( 1 * sizeof ( unsigned long ) ),
+			    "i" ( 2 * sizeof ( unsigned long ) ),
+			    "i" ( 3 * sizeof ( unsigned long ) ),
+			    "i" ( X86_TCPIP_BLOCK )
+			  : "memory" );
+		data = end;
+		len -= ( count * X86_TCPIP_BLOCK );
+
+		/* Fold sum down to 16 bits */
+		if ( sizeof ( sum ) > sizeof ( uint32_t ) ) {
+			sum = ( ( sum & 0xffffffffUL ) +
+				( ( ( uint64_t ) sum ) >> 32 ) );
+			sum = ( ( sum & 0xffffffffUL ) +
+				( ( ( uint64_t ) sum ) >> 32 ) );
+		}
+		sum = ( ( sum & 0xffff ) + ( sum >> 16 ) );
+		sum = ( ( sum & 0xffff ) + ( sum >> 16 ) );
+		sum = ( ( sum & 0xffff ) + ( sum >> 16 ) );
+	}
+
+	/* Sum any remaining data */
+	return generic_tcpip_continue_chksum ( ~sum, data, len );
+}
@@ -132,6 +132,14 @@ REQUIRE_OBJECT ( tftm );
 REQUIRE_OBJECT ( slam );
 #endif
 
+/*
+ * Drag in all requested HTTP extensions
+ *
+ */
+#ifdef HTTP_ENC_GZIP
+REQUIRE_OBJECT ( httpgzip );
+#endif
+
 /*
  * Drag in all requested SAN boot protocols
  *
@@ -244,6 +252,18 @@ REQUIRE_OBJECT ( vlan_cmd );
 #ifdef REBOOT_CMD
 REQUIRE_OBJECT ( reboot_cmd );
 #endif
+#ifdef MEMSTAT_CMD
+REQUIRE_OBJECT ( memstat_cmd );
+#endif
+#ifdef PROCESS_CMD
+REQUIRE_OBJECT ( process_cmd );
+#endif
+#ifdef PROFSTAT_CMD
+REQUIRE_OBJECT ( profstat_cmd );
+#endif
+#ifdef DNS_CMD
+REQUIRE_OBJECT ( dns_cmd );
+#endif
 
 /*
  * Drag in miscellaneous objects
@@ -274,6 +294,10 @@ REQUIRE_OBJECT ( embedded );
 /* linux drivers aren't picked up by the parserom utility so drag them in here */
 #ifdef DRIVERS_LINUX
 REQUIRE_OBJECT ( tap );
+REQUIRE_OBJECT ( af_packet );
+#ifdef PROFSTAT_CMD
+REQUIRE_OBJECT ( linux_profile );
+#endif
 #endif
 
 /*
@@ -0,0 +1,25 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2, or (at
+ * your option) any later version.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <config/general.h>
+
+/** @file
+ *
+ * TCP configuration options
+ *
+ */
+
+/*
+ * Drag in exactly one TCP congestion control algorithm
+ */
+#ifdef TCP_CONGESTION_CUBIC
+REQUIRE_OBJECT ( tcp_cubic );
+#else
+REQUIRE_OBJECT ( tcp_newreno );
+#endif
@@ -61,6 +61,13 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #undef	DOWNLOAD_PROTO_TFTM	/* Multicast Trivial File Transfer Protocol */
 #undef	DOWNLOAD_PROTO_SLAM	/* Scalable Local Area Multicast */
 
+/*
+ * HTTP extensions
+ *
+ */
+
+#undef	HTTP_ENC_GZIP		/* HTTP gzip/deflate content encoding */
+
 /*
  * SAN boot protocols
  *
@@ -79,6 +86,15 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define	CRYPTO_80211_WPA	/* WPA Personal, authenticating with passphrase */
 #define	CRYPTO_80211_WPA2	/* Add support for stronger WPA cryptography */
 
+/*
+ * TCP congestion control algorithm
+ *
+ * NewReno is used unless an alternative is selected here.
+ *
+ */
+
+#undef	TCP_CONGESTION_CUBIC	/* CUBIC congestion control */
+
 /*
  * Name resolution modules
  *
@@ -126,6 +142,10 @@ FILE_LICENCE ( GPL2_OR_LATER );
 //#define VLAN_CMD		/* VLAN commands */
 //#define PXE_CMD		/* PXE commands */
 //#define REBOOT_CMD		/* Reboot command */
+//#define MEMSTAT_CMD		/* Memory statistics command */
+//#define PROCESS_CMD		/* Process statistics command */
+//#define PROFSTAT_CMD		/* Profiling statistics command */
+//#define DNS_CMD		/* DNS cache commands */
 
 /*
  * ROM-specific options
@@ -147,6 +167,13 @@ FILE_LICENCE ( GPL2_OR_LATER );
  */
 
 #define	NETDEV_DISCARD_RATE 0	/* Drop every N packets (0=>no drop) */
+#define	NETDEV_RX_BUDGET 16	/* Process up to N received packets per
+				 * device per poll */
+#define	NETDEV_RX_RING 256	/* Default receive ring size */
+#define	NETDEV_TX_RING 256	/* Default transmit ring size */
+#define	HEAP_SIZE ( 128 * 1024 ) /* Size of internal heap */
+#define	HEAP_GROW_SIZE ( 256 * 1024 ) /* Grow heap from external memory
+				 * in units of N bytes (0=>no growth) */
 #undef	BUILD_SERIAL		/* Include an automatic build serial
 				 * number.  Add "bs" to the list of
 				 * make targets.  For example:
@@ -157,6 +184,8 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #undef	GDBSERIAL		/* Remote GDB debugging over serial */
 #undef	GDBUDP			/* Remote GDB debugging over UDP
 				 * (both may be set) */
+#undef	PROFILE_STATS		/* Collect profiling statistics, as
+				 * shown by PROFSTAT_CMD */
 
 #include <config/local/general.h>
 
@@ -28,6 +28,8 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/uaccess.h>
 #include <ipxe/umalloc.h>
 #include <ipxe/image.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/profile.h>
 #include <ipxe/downloader.h>
 
 /** @file
@@ -50,8 +52,14 @@ struct downloader {
 	struct image *image;
 	/** Current position within image buffer */
 	size_t pos;
+	/** Allocated length of image buffer */
+	size_t alloc_len;
 };
 
+/** Data delivery profiler */
+static struct profiler downloader_rx_profiler __profiler =
+	{ .name = "downloader.rx" };
+
 /**
  * Free downloader object
  *
@@ -65,6 +73,32 @@ static void downloader_free ( struct refcnt *refcnt ) {
 	free ( downloader );
 }
 
+/**
+ * Trim download buffer to its final size
+ *
+ * @v downloader	Downloader
+ */
+static void downloader_trim ( struct downloader *downloader ) {
+	struct image *image = downloader->image;
+	userptr_t new_buffer;
+
+	/* Do nothing unless buffer has spare space at the end */
+	if ( ( image->len == 0 ) || ( image->len >= downloader->alloc_len ) )
+		return;
+
+	DBGC ( downloader, "Downloader %p trimming from %zd to %zd bytes\n",
+	       downloader, downloader->alloc_len, image->len );
+
+	/* Shrink buffer.  Failure is harmless, since the buffer is
+	 * already large enough.
+	 */
+	new_buffer = urealloc ( image->data, image->len );
+	if ( ! new_buffer )
+		return;
+	image->data = new_buffer;
+	downloader->alloc_len = image->len;
+}
+
 /**
  * Terminate download
  *
@@ -73,6 +107,9 @@ static void downloader_free ( struct refcnt *refcnt ) {
  */
 static void downloader_finished ( struct downloader *downloader, int rc ) {
 
+	/* Release any unused buffer space */
+	downloader_trim ( downloader );
+
 	/* Shut down interfaces */
 	intf_shutdown ( &downloader->xfer, rc );
 	intf_shutdown ( &downloader->job, rc );
@@ -84,27 +121,52 @@ static void downloader_finished ( struct downloader *downloader, int rc ) {
  * @v downloader	Downloader
  * @v len		Required minimum size
  * @ret rc		Return status code
+ *
+ * The buffer is grown geometrically, so that a download of unknown
+ * length requires only a logarithmic number of reallocations.  Any
+ * excess space is released when the download terminates.  A size
+ * hint provided via xfer_seek() (e.g. from an HTTP Content-Length or
+ * a TFTP "tsize" option) will normally arrive before any data, and
+ * so will result in a single allocation of exactly the right size.
  */
 static int downloader_ensure_size ( struct downloader *downloader,
 				    size_t len ) {
+	struct image *image = downloader->image;
 	userptr_t new_buffer;
+	size_t alloc_len;
 
 	/* If buffer is already large enough, do nothing */
-	if ( len <= downloader->image->len )
+	if ( len <= image->len )
 		return 0;
 
-	DBGC ( downloader, "Downloader %p extending to %zd bytes\n",
-	       downloader, len );
-
-	/* Extend buffer */
-	new_buffer = urealloc ( downloader->image->data, len );
-	if ( ! new_buffer ) {
-		DBGC ( downloader, "Downloader %p could not extend buffer to "
-		       "%zd bytes\n", downloader, len );
-		return -ENOBUFS;
+	/* Extend buffer, if necessary */
+	if ( len > downloader->alloc_len ) {
+
+		/* Aim to at least double the allocated length */
+		alloc_len = ( 2 * downloader->alloc_len );
+		if ( alloc_len < len )
+			alloc_len = len;
+
+		DBGC ( downloader, "Downloader %p extending to %zd bytes\n",
+		       downloader, alloc_len );
+
+		/* Extend buffer, falling back to the minimum length */
+		new_buffer = urealloc ( image->data, alloc_len );
+		if ( ( ! new_buffer ) && ( alloc_len > len ) ) {
+			alloc_len = len;
+			new_buffer = urealloc ( image->data, alloc_len );
+		}
+		if ( ! new_buffer ) {
+			DBGC ( downloader, "Downloader %p could not extend "
+			       "buffer to %zd bytes\n", downloader, len );
+			return -ENOBUFS;
+		}
+		image->data = new_buffer;
+		downloader->alloc_len = alloc_len;
 	}
-	downloader->image->data = new_buffer;
-	downloader->image->len = len;
+
+	/* Record new image length */
+	image->len = len;
 
 	return 0;
 }
@@ -153,6 +215,8 @@ static int downloader_xfer_deliver ( struct downloader *downloader,
 	size_t max;
 	int rc;
 
+	profile_start ( &downloader_rx_profiler );
+
 	/* Calculate new buffer position */
 	if ( meta->flags & XFER_FL_ABS_OFFSET )
 		downloader->pos = 0;
@@ -173,12 +237,64 @@ static int downloader_xfer_deliver ( struct downloader *downloader,
 
  done:
 	free_iob ( iobuf );
+	profile_stop ( &downloader_rx_profiler );
+	return rc;
+}
+
+/**
+ * Handle received data with deferred checksum verification
+ *
+ * @v downloader	Downloader
+ * @v data		Data
+ * @v len		Length of data
+ * @v partial		TCP/IP checksum of preceding data
+ * @ret rc		Return status code
+ *
+ * The data is checksummed while being copied into the image buffer.
+ * If the checksum is incorrect, the image length and current buffer
+ * position are left unchanged, so that the corrupted data lies
+ * beyond the end of the image and will be overwritten when the data
+ * is retransmitted.
+ */
+static int downloader_xfer_deliver_chksum ( struct downloader *downloader,
+					    const void *data, size_t len,
+					    uint16_t partial ) {
+	size_t old_len = downloader->image->len;
+	void *dest;
+	uint16_t csum;
+	int rc;
+
+	profile_start ( &downloader_rx_profiler );
+
+	/* Ensure that we have enough buffer space for this data */
+	if ( ( rc = downloader_ensure_size ( downloader,
+					     ( downloader->pos + len ) ) ) != 0 )
+		goto done;
+
+	/* Copy and checksum data */
+	dest = user_to_virt ( downloader->image->data, downloader->pos );
+	csum = tcpip_copy_chksum ( partial, dest, data, len );
+	if ( csum != 0 ) {
+		DBGC ( downloader, "Downloader %p checksum incorrect (is "
+		       "%04x, should be 0000)\n", downloader, csum );
+		downloader->image->len = old_len;
+		rc = -EINVAL;
+		goto done;
+	}
+
+	/* Update current buffer position */
+	downloader->pos += len;
+
+ done:
+	profile_stop ( &downloader_rx_profiler );
 	return rc;
 }
 
 /** Downloader data transfer interface operations */
 static struct interface_operation downloader_xfer_operations[] = {
 	INTF_OP ( xfer_deliver, struct downloader *, downloader_xfer_deliver ),
+	INTF_OP ( xfer_deliver_chksum, struct downloader *,
+		  downloader_xfer_deliver_chksum ),
 	INTF_OP ( intf_close, struct downloader *, downloader_finished ),
 };
 
@@ -236,6 +352,7 @@ int create_downloader ( struct interface *job, struct image *image,
 	intf_init ( &downloader->xfer, &downloader_xfer_desc,
 		    &downloader->refcnt );
 	downloader->image = image_get ( image );
+	downloader->alloc_len = image->len;
 	va_start ( args, type );
 
 	/* Instantiate child objects and attach to our interfaces */
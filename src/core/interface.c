@@ -86,6 +86,25 @@ void intf_plug_plug ( struct interface *a, struct interface *b ) {
 	intf_plug ( b, a );
 }
 
+/**
+ * Insert a filter interface pair
+ *
+ * @v intf		Object interface
+ * @v upper		Upper end of filter
+ * @v lower		Lower end of filter
+ *
+ * Plugs @c intf into @c upper, and @c lower into whatever @c intf was
+ * previously plugged into.
+ */
+void intf_insert ( struct interface *intf, struct interface *upper,
+		   struct interface *lower ) {
+	struct interface *dest = intf_get ( intf->dest );
+
+	intf_plug_plug ( intf, upper );
+	intf_plug_plug ( lower, dest );
+	intf_put ( dest );
+}
+
 /**
  * Unplug an object interface
  *
@@ -22,6 +22,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <errno.h>
 #include <ipxe/malloc.h>
 #include <ipxe/iobuf.h>
+#include <ipxe/profile.h>
 
 /** @file
  *
@@ -29,6 +30,50 @@ FILE_LICENCE ( GPL2_OR_LATER );
  *
  */
 
+/** I/O buffer allocation profiler */
+static struct profiler alloc_iob_profiler __profiler = { .name = "iobuf.alloc" };
+
+/** I/O buffer pools
+ *
+ * These cover a standard Ethernet frame, a page-aligned 2kB buffer
+ * (as used by many drivers for their receive rings), and a jumbo
+ * Ethernet frame.  Each pool holds buffers of exactly the pool's
+ * length, and is used only for allocations of at least half that
+ * length, so as to limit the wasted space.
+ */
+struct io_buffer_pool iob_pools[IOB_NUM_POOLS] = {
+	{
+		.len = 1536,
+		.free = LIST_HEAD_INIT ( iob_pools[0].free ),
+	},
+	{
+		.len = 2048,
+		.free = LIST_HEAD_INIT ( iob_pools[1].free ),
+	},
+	{
+		.len = 9216,
+		.free = LIST_HEAD_INIT ( iob_pools[2].free ),
+	},
+};
+
+/**
+ * Identify I/O buffer pool for a given buffer length
+ *
+ * @v len		Buffer length (excluding descriptor)
+ * @ret pool		I/O buffer pool, or NULL
+ */
+static struct io_buffer_pool * iob_pool ( size_t len ) {
+	struct io_buffer_pool *pool;
+	unsigned int i;
+
+	for ( i = 0 ; i < IOB_NUM_POOLS ; i++ ) {
+		pool = &iob_pools[i];
+		if ( ( len <= pool->len ) && ( len > ( pool->len / 2 ) ) )
+			return pool;
+	}
+	return NULL;
+}
+
 /**
  * Allocate I/O buffer
  *
@@ -40,8 +85,11 @@ FILE_LICENCE ( GPL2_OR_LATER );
  */
 struct io_buffer * alloc_iob ( size_t len ) {
 	struct io_buffer *iobuf = NULL;
+	struct io_buffer_pool *pool;
 	void *data;
 
+	profile_start ( &alloc_iob_profiler );
+
 	/* Pad to minimum length */
 	if ( len < IOB_ZLEN )
 		len = IOB_ZLEN;
@@ -49,15 +97,37 @@ struct io_buffer * alloc_iob ( size_t len ) {
 	/* Align buffer length */
 	len = ( len + __alignof__( *iobuf ) - 1 ) &
 		~( __alignof__( *iobuf ) - 1 );
-	
+
+	/* Use a pooled buffer, if available */
+	pool = iob_pool ( len );
+	if ( pool ) {
+		iobuf = list_first_entry ( &pool->free, struct io_buffer,
+					   list );
+		if ( iobuf ) {
+			list_del ( &iobuf->list );
+			pool->count--;
+			pool->hits++;
+			iobuf->data = iobuf->tail = iobuf->head;
+			iobuf->flags = 0;
+			profile_stop ( &alloc_iob_profiler );
+			return iobuf;
+		}
+		pool->misses++;
+		len = pool->len;
+	}
+
 	/* Allocate memory for buffer plus descriptor */
 	data = malloc_dma ( len + sizeof ( *iobuf ), IOB_ALIGN );
-	if ( ! data )
+	if ( ! data ) {
+		profile_stop ( &alloc_iob_profiler );
 		return NULL;
+	}
 
 	iobuf = ( struct io_buffer * ) ( data + len );
 	iobuf->head = iobuf->data = iobuf->tail = data;
 	iobuf->end = iobuf;
+	iobuf->flags = 0;
+	profile_stop ( &alloc_iob_profiler );
 	return iobuf;
 }
 
@@ -67,15 +137,60 @@ struct io_buffer * alloc_iob ( size_t len ) {
  * @v iobuf	I/O buffer
  */
 void free_iob ( struct io_buffer *iobuf ) {
+	struct io_buffer_pool *pool;
+	size_t len;
+
 	if ( iobuf ) {
 		assert ( iobuf->head <= iobuf->data );
 		assert ( iobuf->data <= iobuf->tail );
 		assert ( iobuf->tail <= iobuf->end );
-		free_dma ( iobuf->head,
-			   ( iobuf->end - iobuf->head ) + sizeof ( *iobuf ) );
+
+		/* Return to pool, if applicable */
+		len = ( iobuf->end - iobuf->head );
+		pool = iob_pool ( len );
+		if ( pool && ( len == pool->len ) ) {
+			list_add ( &iobuf->list, &pool->free );
+			pool->count++;
+			return;
+		}
+
+		free_dma ( iobuf->head, ( len + sizeof ( *iobuf ) ) );
+	}
+}
+
+/**
+ * Discard some cached I/O buffers
+ *
+ * @ret discarded	Number of cached items discarded
+ */
+static unsigned int iob_discard ( void ) {
+	struct io_buffer_pool *pool;
+	struct io_buffer *iobuf;
+	unsigned int i;
+
+	/* Discard a buffer from the pool holding the most memory */
+	pool = NULL;
+	for ( i = 0 ; i < IOB_NUM_POOLS ; i++ ) {
+		if ( ( ! pool ) || ( ( iob_pools[i].count * iob_pools[i].len )
+				     > ( pool->count * pool->len ) ) )
+			pool = &iob_pools[i];
 	}
+	iobuf = list_first_entry ( &pool->free, struct io_buffer, list );
+	if ( ! iobuf )
+		return 0;
+	list_del ( &iobuf->list );
+	pool->count--;
+	free_dma ( iobuf->head,
+		   ( ( iobuf->end - iobuf->head ) + sizeof ( *iobuf ) ) );
+
+	return 1;
 }
 
+/** I/O buffer cache discarder */
+struct cache_discarder iob_cache_discarder __cache_discarder = {
+	.discard = iob_discard,
+};
+
 /**
  * Ensure I/O buffer has sufficient headroom
  *
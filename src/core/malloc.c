@@ -22,12 +22,17 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <stdint.h>
 #include <string.h>
 #include <strings.h>
+#include <errno.h>
+#include <assert.h>
 #include <ipxe/io.h>
 #include <ipxe/list.h>
 #include <ipxe/init.h>
 #include <ipxe/refcnt.h>
 #include <ipxe/malloc.h>
+#include <ipxe/uaccess.h>
+#include <ipxe/umalloc.h>
 #include <valgrind/memcheck.h>
+#include <config/general.h>
 
 /** @file
  *
@@ -54,9 +59,49 @@ struct memory_block {
 	struct list_head list;
 };
 
+/** Minimum memory block size
+ *
+ * All memory blocks are a multiple of this size, and all heap
+ * regions are divided into granules of this size.
+ */
 #define MIN_MEMBLOCK_SIZE \
 	( ( size_t ) ( 1 << ( fls ( sizeof ( struct memory_block ) - 1 ) ) ) )
 
+/** A region of memory available for the heap
+ *
+ * Each region carries a bitmap with one bit per granule.  The bit is
+ * set for the first and last granules of each free block (which may
+ * be the same granule), and clear for all other granules.  The first
+ * word of the last granule of each free block holds the size of the
+ * block (which, for a single-granule block, is the block's own size
+ * field).  This allows a block being freed to be merged with its
+ * neighbours in constant time, without requiring any header or
+ * footer within allocated blocks.
+ */
+struct heap_region {
+	/** Start of usable memory (aligned to a granule boundary) */
+	void *start;
+	/** Number of granules */
+	size_t granules;
+	/** External memory block (if region was added by heap_grow()) */
+	userptr_t external;
+	/** Free block boundary bitmap */
+	unsigned long bitmap[0];
+};
+
+/** Maximum number of heap regions */
+#define HEAP_MAX_REGIONS 32
+
+/** Number of bits per bitmap entry */
+#define HEAP_BITMAP_BITS ( 8 * sizeof ( unsigned long ) )
+
+/** Number of segregated free lists
+ *
+ * Free list @c n holds blocks of between 2^n and (2^(n+1))-1
+ * granules.
+ */
+#define HEAP_BINS ( 8 * sizeof ( size_t ) )
+
 /** A block of allocated memory complete with size information */
 struct autosized_block {
 	/** Size of this block */
@@ -82,21 +127,160 @@ struct autosized_block {
  */
 #define NOWHERE ( ( void * ) ~( ( intptr_t ) 0 ) )
 
-/** List of free memory blocks */
-static LIST_HEAD ( free_blocks );
+/** Segregated lists of free memory blocks */
+static struct list_head free_blocks[HEAP_BINS];
+
+/** Heap regions, sorted by address */
+static struct heap_region *heap_regions[HEAP_MAX_REGIONS];
+
+/** Number of heap regions */
+static unsigned int heap_region_count;
 
 /** Total amount of free memory */
 size_t freemem;
 
+/** Total amount of memory in the heap */
+size_t heapmem;
+
+/** Maximum amount of memory ever allocated from the heap */
+size_t maxusedmem;
+
+/** The heap itself */
+static char heap[HEAP_SIZE] __attribute__ (( aligned ( __alignof__(void *) )));
+
 /**
- * Heap size
+ * Identify free list for a memory block
  *
- * Currently fixed at 128kB.
+ * @v size		Size of memory block
+ * @ret bin		Free list index
  */
-#define HEAP_SIZE ( 128 * 1024 )
+static inline unsigned int heap_bin ( size_t size ) {
+	return ( flsl ( size / MIN_MEMBLOCK_SIZE ) - 1 );
+}
 
-/** The heap itself */
-static char heap[HEAP_SIZE] __attribute__ (( aligned ( __alignof__(void *) )));
+/**
+ * Locate memory block footer
+ *
+ * @v block		Free memory block
+ * @v size		Size of memory block
+ * @ret footer		Footer (holding the size of the block)
+ */
+static inline size_t * heap_footer ( void *block, size_t size ) {
+	return ( block + size - MIN_MEMBLOCK_SIZE );
+}
+
+/**
+ * Identify heap region containing a memory block
+ *
+ * @v block		Memory block
+ * @ret region		Heap region
+ *
+ * Heap regions are held in an array sorted by address, so that the
+ * region may be found by a binary search.
+ */
+static struct heap_region * heap_region ( void *block ) {
+	struct heap_region *region;
+	unsigned int min = 0;
+	unsigned int max = heap_region_count;
+	unsigned int mid;
+
+	while ( min < max ) {
+		mid = ( ( min + max ) / 2 );
+		region = heap_regions[mid];
+		if ( block < region->start ) {
+			max = mid;
+		} else if ( block >= ( region->start +
+				       ( region->granules *
+					 MIN_MEMBLOCK_SIZE ) ) ) {
+			min = mid + 1;
+		} else {
+			return region;
+		}
+	}
+	assert ( 0 );
+	return NULL;
+}
+
+/**
+ * Identify granule index within heap region
+ *
+ * @v region		Heap region
+ * @v addr		Address within region
+ * @ret index		Granule index
+ */
+static inline size_t heap_granule ( struct heap_region *region,
+				    void *addr ) {
+	return ( ( addr - region->start ) / MIN_MEMBLOCK_SIZE );
+}
+
+/**
+ * Test boundary bit for a granule
+ *
+ * @v region		Heap region
+ * @v index		Granule index
+ * @ret is_set		Boundary bit is set
+ */
+static inline int heap_test ( struct heap_region *region, size_t index ) {
+	return ( ( region->bitmap[ index / HEAP_BITMAP_BITS ] >>
+		   ( index % HEAP_BITMAP_BITS ) ) & 1 );
+}
+
+/**
+ * Set or clear boundary bits for a free memory block
+ *
+ * @v region		Heap region
+ * @v block		Free memory block
+ * @v set		Set (rather than clear) boundary bits
+ */
+static void heap_mark ( struct heap_region *region,
+			struct memory_block *block, int set ) {
+	size_t first = heap_granule ( region, block );
+	size_t last = ( first + ( block->size / MIN_MEMBLOCK_SIZE ) - 1 );
+	unsigned long *first_word = &region->bitmap[first / HEAP_BITMAP_BITS];
+	unsigned long *last_word = &region->bitmap[last / HEAP_BITMAP_BITS];
+	unsigned long first_bit = ( 1UL << ( first % HEAP_BITMAP_BITS ) );
+	unsigned long last_bit = ( 1UL << ( last % HEAP_BITMAP_BITS ) );
+
+	if ( set ) {
+		*first_word |= first_bit;
+		*last_word |= last_bit;
+	} else {
+		*first_word &= ~first_bit;
+		*last_word &= ~last_bit;
+	}
+}
+
+/**
+ * Add block to free lists
+ *
+ * @v region		Heap region
+ * @v block		Memory block
+ * @v size		Size of memory block
+ */
+static void heap_add ( struct heap_region *region,
+		       struct memory_block *block, size_t size ) {
+	size_t *footer = heap_footer ( block, size );
+
+	VALGRIND_MAKE_MEM_DEFINED ( block, sizeof ( *block ) );
+	VALGRIND_MAKE_MEM_DEFINED ( footer, sizeof ( *footer ) );
+	block->size = size;
+	*footer = size;
+	heap_mark ( region, block, 1 );
+	list_add ( &block->list, &free_blocks[ heap_bin ( size ) ] );
+}
+
+/**
+ * Remove block from free lists
+ *
+ * @v region		Heap region
+ * @v block		Memory block
+ */
+static void heap_del ( struct heap_region *region,
+		       struct memory_block *block ) {
+
+	heap_mark ( region, block, 0 );
+	list_del ( &block->list );
+}
 
 /**
  * Mark all blocks in free list as defined
@@ -104,12 +288,20 @@ static char heap[HEAP_SIZE] __attribute__ (( aligned ( __alignof__(void *) )));
  */
 static inline void valgrind_make_blocks_defined ( void ) {
 	struct memory_block *block;
+	unsigned int bin;
 
 	if ( RUNNING_ON_VALGRIND > 0 ) {
 		VALGRIND_MAKE_MEM_DEFINED ( &free_blocks,
 					    sizeof ( free_blocks ) );
-		list_for_each_entry ( block, &free_blocks, list )
-			VALGRIND_MAKE_MEM_DEFINED ( block, sizeof ( *block ) );
+		for ( bin = 0 ; bin < HEAP_BINS ; bin++ ) {
+			list_for_each_entry ( block, &free_blocks[bin], list ) {
+				VALGRIND_MAKE_MEM_DEFINED ( block,
+							    sizeof ( *block ) );
+				VALGRIND_MAKE_MEM_DEFINED (
+					heap_footer ( block, block->size ),
+					sizeof ( size_t ) );
+			}
+		}
 	}
 }
 
@@ -120,10 +312,19 @@ static inline void valgrind_make_blocks_defined ( void ) {
 static inline void valgrind_make_blocks_noaccess ( void ) {
 	struct memory_block *block;
 	struct memory_block *tmp;
+	unsigned int bin;
 
 	if ( RUNNING_ON_VALGRIND > 0 ) {
-		list_for_each_entry_safe ( block, tmp, &free_blocks, list )
-			VALGRIND_MAKE_MEM_NOACCESS ( block, sizeof ( *block ) );
+		for ( bin = 0 ; bin < HEAP_BINS ; bin++ ) {
+			list_for_each_entry_safe ( block, tmp,
+						   &free_blocks[bin], list ) {
+				VALGRIND_MAKE_MEM_NOACCESS (
+					heap_footer ( block, block->size ),
+					sizeof ( size_t ) );
+				VALGRIND_MAKE_MEM_NOACCESS ( block,
+							     sizeof ( *block ) );
+			}
+		}
 		VALGRIND_MAKE_MEM_NOACCESS ( &free_blocks,
 					     sizeof ( free_blocks ) );
 	}
@@ -144,6 +345,148 @@ static unsigned int discard_cache ( void ) {
 	return discarded;
 }
 
+/**
+ * Add heap region
+ *
+ * @v start		Start address
+ * @v len		Length
+ * @ret region		Heap region, or NULL
+ *
+ * @c start must be aligned to at least a multiple of sizeof(void*).
+ */
+static struct heap_region * heap_populate ( void *start, size_t len ) {
+	struct heap_region *region;
+	size_t pre_size;
+	size_t header_len;
+	size_t granules;
+	unsigned int i;
+
+	/* Fail if there are too many regions */
+	if ( heap_region_count >= HEAP_MAX_REGIONS ) {
+		DBG ( "Too many heap regions; ignoring [%p,%p)\n",
+		      start, ( start + len ) );
+		return NULL;
+	}
+
+	/* Align start to a physical granule boundary, so that any
+	 * physical alignment of at least MIN_MEMBLOCK_SIZE can be
+	 * satisfied by a whole number of granules.
+	 */
+	pre_size = ( ( - virt_to_phys ( start ) ) & ( MIN_MEMBLOCK_SIZE - 1 ) );
+	if ( len <= pre_size )
+		return NULL;
+	region = ( start + pre_size );
+	len -= pre_size;
+
+	/* Place region descriptor and bitmap at start of region.  The
+	 * bitmap is sized for the whole region (including the
+	 * descriptor itself), which is a slight overestimate.
+	 */
+	granules = ( len / MIN_MEMBLOCK_SIZE );
+	header_len = ( sizeof ( *region ) +
+		       ( ( ( granules + HEAP_BITMAP_BITS - 1 ) /
+			   HEAP_BITMAP_BITS ) * sizeof ( region->bitmap[0] ) ) );
+	header_len = ( ( header_len + MIN_MEMBLOCK_SIZE - 1 ) &
+		       ~( MIN_MEMBLOCK_SIZE - 1 ) );
+	if ( len <= header_len )
+		return NULL;
+	VALGRIND_MAKE_MEM_DEFINED ( region, header_len );
+	memset ( region, 0, header_len );
+	region->start = ( ( ( void * ) region ) + header_len );
+	region->granules = ( ( len - header_len ) / MIN_MEMBLOCK_SIZE );
+	for ( i = heap_region_count ; i > 0 ; i-- ) {
+		if ( heap_regions[ i - 1 ]->start < region->start )
+			break;
+		heap_regions[i] = heap_regions[ i - 1 ];
+	}
+	heap_regions[i] = region;
+	heap_region_count++;
+	heapmem += ( region->granules * MIN_MEMBLOCK_SIZE );
+
+	/* Add memory to free lists */
+	free_memblock ( region->start,
+			( region->granules * MIN_MEMBLOCK_SIZE ) );
+
+	return region;
+}
+
+/**
+ * Grow the heap using external memory
+ *
+ * @v len		Minimum length required
+ * @ret rc		Return status code
+ *
+ * The heap is extended by at least HEAP_GROW_SIZE bytes at a time,
+ * using memory obtained via umalloc() (i.e. from the top of memory
+ * under PC BIOS, from boot services under EFI, or via mmap() under
+ * Linux).  The external memory is returned via ufree() once the
+ * region becomes entirely free again.
+ *
+ * Note that some umalloc() implementations are able to expand only
+ * the most recently allocated block, and so growing the heap may
+ * prevent subsequent expansion of existing external allocations.
+ * The heap is therefore grown only when no suitable free block
+ * exists and no cached data remains to be discarded.
+ */
+static int heap_grow ( size_t len ) {
+	struct heap_region *region;
+	userptr_t grow;
+
+	/* Do nothing if growth is disabled or no region is available */
+	if ( ( ! HEAP_GROW_SIZE ) || ( heap_region_count >= HEAP_MAX_REGIONS ) )
+		return -ENOMEM;
+
+	/* Allow for region descriptor, bitmap and alignment padding */
+	len *= 2;
+	if ( len < HEAP_GROW_SIZE )
+		len = HEAP_GROW_SIZE;
+
+	/* Allocate external memory */
+	grow = umalloc ( len );
+	if ( ! grow ) {
+		DBG ( "Could not grow heap by %#zx\n", len );
+		return -ENOMEM;
+	}
+	DBG ( "Growing heap by [%#lx,%#lx)\n",
+	      user_to_phys ( grow, 0 ), user_to_phys ( grow, len ) );
+
+	/* Add to heap */
+	region = heap_populate ( user_to_virt ( grow, 0 ), len );
+	if ( ! region ) {
+		ufree ( grow );
+		return -ENOMEM;
+	}
+	region->external = grow;
+
+	return 0;
+}
+
+/**
+ * Return an entirely free region to external memory
+ *
+ * @v region		Heap region
+ */
+static void heap_shrink ( struct heap_region *region ) {
+	size_t len = ( region->granules * MIN_MEMBLOCK_SIZE );
+	unsigned int i;
+
+	DBG ( "Shrinking heap by [%p,%p)\n",
+	      region->start, ( region->start + len ) );
+
+	/* Remove from list of regions */
+	for ( i = 0 ; heap_regions[i] != region ; i++ ) {}
+	heap_region_count--;
+	for ( ; i < heap_region_count ; i++ )
+		heap_regions[i] = heap_regions[ i + 1 ];
+
+	/* Update heap size and free memory counters */
+	heapmem -= len;
+	freemem -= len;
+
+	/* Return external memory */
+	ufree ( region->external );
+}
+
 /**
  * Allocate a memory block
  *
@@ -155,15 +498,19 @@ static unsigned int discard_cache ( void ) {
  * guarantees are provided for the alignment of the virtual address.
  *
  * @c align must be a power of two.  @c size may not be zero.
+ *
+ * Free blocks are held in segregated lists by size, so that the
+ * search starts with blocks of approximately the requested size
+ * rather than walking through every free block in the heap.
  */
 void * alloc_memblock ( size_t size, size_t align ) {
+	struct heap_region *region;
 	struct memory_block *block;
 	size_t align_mask;
 	size_t pre_size;
-	ssize_t post_size;
-	struct memory_block *pre;
-	struct memory_block *post;
-	struct memory_block *ptr;
+	size_t post_size;
+	unsigned int bin;
+	void *ptr;
 
 	valgrind_make_blocks_defined();
 
@@ -175,64 +522,60 @@ void * alloc_memblock ( size_t size, size_t align ) {
 
 	DBG ( "Allocating %#zx (aligned %#zx)\n", size, align );
 	while ( 1 ) {
-		/* Search through blocks for the first one with enough space */
-		list_for_each_entry ( block, &free_blocks, list ) {
-			pre_size = ( - virt_to_phys ( block ) ) & align_mask;
-			post_size = block->size - pre_size - size;
-			if ( post_size >= 0 ) {
+		/* Search through free lists, starting with the list
+		 * that would contain a block of exactly the requested
+		 * size, for the first block with enough space.
+		 */
+		for ( bin = heap_bin ( size ) ; bin < HEAP_BINS ; bin++ ) {
+			list_for_each_entry ( block, &free_blocks[bin], list ){
+				pre_size = ( ( - virt_to_phys ( block ) ) &
+					     align_mask );
+				if ( block->size < ( pre_size + size ) )
+					continue;
+				post_size = ( block->size - pre_size - size );
 				/* Split block into pre-block, block, and
-				 * post-block.  After this split, the "pre"
-				 * block is the one currently linked into the
-				 * free list.
-				 */
-				pre   = block;
-				block = ( ( ( void * ) pre   ) + pre_size );
-				post  = ( ( ( void * ) block ) + size     );
-				DBG ( "[%p,%p) -> [%p,%p) + [%p,%p)\n", pre,
-				      ( ( ( void * ) pre ) + pre->size ),
-				      pre, block, post,
-				      ( ( ( void * ) pre ) + pre->size ) );
-				/* If there is a "post" block, add it in to
-				 * the free list.  Leak it if it is too small
-				 * (which can happen only at the very end of
-				 * the heap).
+				 * post-block, returning the pre-block and
+				 * post-block (if any) to the free lists.
 				 */
-				if ( (size_t) post_size >= MIN_MEMBLOCK_SIZE ) {
-					VALGRIND_MAKE_MEM_DEFINED ( post,
-							     sizeof ( *post ) );
-					post->size = post_size;
-					list_add ( &post->list, &pre->list );
+				region = heap_region ( block );
+				heap_del ( region, block );
+				ptr = ( ( ( void * ) block ) + pre_size );
+				DBG ( "[%p,%p) -> [%p,%p) + [%p,%p)\n", block,
+				      ( ( ( void * ) block ) + block->size ),
+				      block, ptr, ( ptr + size ),
+				      ( ( ( void * ) block ) + block->size ) );
+				if ( pre_size )
+					heap_add ( region, block, pre_size );
+				if ( post_size ) {
+					heap_add ( region, ( ptr + size ),
+						   post_size );
 				}
-				/* Shrink "pre" block, leaving the main block
-				 * isolated and no longer part of the free
-				 * list.
-				 */
-				pre->size = pre_size;
-				/* If there is no "pre" block, remove it from
-				 * the list.  Also remove it (i.e. leak it) if
-				 * it is too small, which can happen only at
-				 * the very start of the heap.
-				 */
-				if ( pre_size < MIN_MEMBLOCK_SIZE )
-					list_del ( &pre->list );
 				/* Update total free memory */
 				freemem -= size;
+				if ( ( heapmem - freemem ) > maxusedmem )
+					maxusedmem = ( heapmem - freemem );
 				/* Return allocated block */
-				DBG ( "Allocated [%p,%p)\n", block,
-				      ( ( ( void * ) block ) + size ) );
-				ptr = block;
+				DBG ( "Allocated [%p,%p)\n", ptr,
+				      ( ptr + size ) );
 				goto done;
 			}
 		}
 
 		/* Try discarding some cached data to free up memory */
-		if ( ! discard_cache() ) {
-			/* Nothing available to discard */
-			DBG ( "Failed to allocate %#zx (aligned %#zx)\n",
-			      size, align );
-			ptr = NULL;
-			goto done;
+		if ( discard_cache() )
+			continue;
+
+		/* Nothing available to discard; try growing the heap */
+		if ( heap_grow ( size + align ) == 0 ) {
+			valgrind_make_blocks_defined();
+			continue;
 		}
+
+		/* Nothing available to discard, and heap cannot grow */
+		DBG ( "Failed to allocate %#zx (aligned %#zx)\n",
+		      size, align );
+		ptr = NULL;
+		goto done;
 	}
 
  done:
@@ -249,11 +592,11 @@ void * alloc_memblock ( size_t size, size_t align ) {
  * If @c ptr is NULL, no action is taken.
  */
 void free_memblock ( void *ptr, size_t size ) {
+	struct heap_region *region;
 	struct memory_block *freeing;
 	struct memory_block *block;
-	struct memory_block *tmp;
-	ssize_t gap_before;
-	ssize_t gap_after = -1;
+	size_t first;
+	size_t last;
 
 	/* Allow for ptr==NULL */
 	if ( ! ptr )
@@ -266,49 +609,53 @@ void free_memblock ( void *ptr, size_t size ) {
 	 */
 	size = ( size + MIN_MEMBLOCK_SIZE - 1 ) & ~( MIN_MEMBLOCK_SIZE - 1 );
 	freeing = ptr;
-	VALGRIND_MAKE_MEM_DEFINED ( freeing, sizeof ( *freeing ) );
-	freeing->size = size;
 	DBG ( "Freeing [%p,%p)\n", freeing, ( ( ( void * ) freeing ) + size ));
 
-	/* Insert/merge into free list */
-	list_for_each_entry_safe ( block, tmp, &free_blocks, list ) {
-		/* Calculate gaps before and after the "freeing" block */
-		gap_before = ( ( ( void * ) freeing ) - 
-			       ( ( ( void * ) block ) + block->size ) );
-		gap_after = ( ( ( void * ) block ) - 
-			      ( ( ( void * ) freeing ) + freeing->size ) );
-		/* Merge with immediately preceding block, if possible */
-		if ( gap_before == 0 ) {
-			DBG ( "[%p,%p) + [%p,%p) -> [%p,%p)\n", block,
-			      ( ( ( void * ) block ) + block->size ), freeing,
-			      ( ( ( void * ) freeing ) + freeing->size ),block,
-			      ( ( ( void * ) freeing ) + freeing->size ) );
-			block->size += size;
-			list_del ( &block->list );
-			freeing = block;
-		}
-		/* Stop processing as soon as we reach a following block */
-		if ( gap_after >= 0 )
-			break;
+	/* Update free memory counter */
+	freemem += size;
+
+	/* Identify surrounding granules */
+	region = heap_region ( freeing );
+	first = heap_granule ( region, freeing );
+	last = ( first + ( size / MIN_MEMBLOCK_SIZE ) - 1 );
+
+	/* Merge with immediately preceding block, if free */
+	if ( ( first > 0 ) && heap_test ( region, ( first - 1 ) ) ) {
+		block = ( ( ( void * ) freeing ) -
+			  *( ( size_t * ) ( ( ( void * ) freeing ) -
+					    MIN_MEMBLOCK_SIZE ) ) );
+		DBG ( "[%p,%p) + [%p,%p) -> [%p,%p)\n", block,
+		      ( ( ( void * ) block ) + block->size ), freeing,
+		      ( ( ( void * ) freeing ) + size ), block,
+		      ( ( ( void * ) freeing ) + size ) );
+		heap_del ( region, block );
+		size += block->size;
+		freeing = block;
 	}
 
-	/* Insert before the immediately following block.  If
-	 * possible, merge the following block into the "freeing"
-	 * block.
-	 */
-	DBG ( "[%p,%p)\n", freeing, ( ( ( void * ) freeing ) + freeing->size));
-	list_add_tail ( &freeing->list, &block->list );
-	if ( gap_after == 0 ) {
+	/* Merge with immediately following block, if free */
+	if ( ( ( last + 1 ) < region->granules ) &&
+	     heap_test ( region, ( last + 1 ) ) ) {
+		block = ( ( ( void * ) freeing ) + size );
 		DBG ( "[%p,%p) + [%p,%p) -> [%p,%p)\n", freeing,
-		      ( ( ( void * ) freeing ) + freeing->size ), block,
+		      ( ( ( void * ) freeing ) + size ), block,
 		      ( ( ( void * ) block ) + block->size ), freeing,
 		      ( ( ( void * ) block ) + block->size ) );
-		freeing->size += block->size;
-		list_del ( &block->list );
+		heap_del ( region, block );
+		size += block->size;
 	}
 
-	/* Update free memory counter */
-	freemem += size;
+	/* Return region to external memory if it is now entirely
+	 * free, otherwise add to free lists.
+	 */
+	if ( region->external &&
+	     ( size == ( region->granules * MIN_MEMBLOCK_SIZE ) ) ) {
+		heap_shrink ( region );
+	} else {
+		DBG ( "[%p,%p)\n", freeing,
+		      ( ( ( void * ) freeing ) + size ) );
+		heap_add ( region, freeing, size );
+	}
 
 	valgrind_make_blocks_noaccess();
 }
@@ -430,18 +777,40 @@ void * zalloc ( size_t size ) {
  * Add memory to allocation pool
  *
  * @v start		Start address
- * @v end		End address
+ * @v len		Length
  *
- * Adds a block of memory [start,end) to the allocation pool.  This is
- * a one-way operation; there is no way to reclaim this memory.
+ * Adds a block of memory [start,start+len) to the allocation pool.
+ * This is a one-way operation; there is no way to reclaim this
+ * memory.
  *
  * @c start must be aligned to at least a multiple of sizeof(void*).
  */
 void mpopulate ( void *start, size_t len ) {
-	/* Prevent free_memblock() from rounding up len beyond the end
-	 * of what we were actually given...
-	 */
-	free_memblock ( start, ( len & ~( MIN_MEMBLOCK_SIZE - 1 ) ) );
+	heap_populate ( start, len );
+}
+
+/**
+ * Find largest free memory block
+ *
+ * @ret len		Length of largest free memory block
+ */
+size_t mlargest ( void ) {
+	struct memory_block *block;
+	size_t largest = 0;
+	int bin;
+
+	valgrind_make_blocks_defined();
+	for ( bin = ( HEAP_BINS - 1 ) ; bin >= 0 ; bin-- ) {
+		list_for_each_entry ( block, &free_blocks[bin], list ) {
+			if ( block->size > largest )
+				largest = block->size;
+		}
+		if ( largest )
+			break;
+	}
+	valgrind_make_blocks_noaccess();
+
+	return largest;
 }
 
 /**
@@ -449,6 +818,10 @@ void mpopulate ( void *start, size_t len ) {
  *
  */
 static void init_heap ( void ) {
+	unsigned int bin;
+
+	for ( bin = 0 ; bin < HEAP_BINS ; bin++ )
+		INIT_LIST_HEAD ( &free_blocks[bin] );
 	VALGRIND_MAKE_MEM_NOACCESS ( heap, sizeof ( heap ) );
 	mpopulate ( heap, sizeof ( heap ) );
 }
@@ -466,11 +839,15 @@ struct init_fn heap_init_fn __init_fn ( INIT_EARLY ) = {
  */
 void mdumpfree ( void ) {
 	struct memory_block *block;
+	unsigned int bin;
 
 	printf ( "Free block list:\n" );
-	list_for_each_entry ( block, &free_blocks, list ) {
-		printf ( "[%p,%p] (size %#zx)\n", block,
-			 ( ( ( void * ) block ) + block->size ), block->size );
+	for ( bin = 0 ; bin < HEAP_BINS ; bin++ ) {
+		list_for_each_entry ( block, &free_blocks[bin], list ) {
+			printf ( "[%p,%p] (size %#zx)\n", block,
+				 ( ( ( void * ) block ) + block->size ),
+				 block->size );
+		}
 	}
 }
 #endif
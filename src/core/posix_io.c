@@ -26,6 +26,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
 #include <ipxe/process.h>
+#include <ipxe/tcpip.h>
 #include <ipxe/posix_io.h>
 
 /** @file
@@ -58,6 +59,14 @@ struct posix_file {
 	size_t filesize;
 	/** Received data queue */
 	struct list_head data;
+	/** Registered receive buffer (if any) */
+	userptr_t rx_buffer;
+	/** Offset within registered receive buffer */
+	off_t rx_offset;
+	/** Maximum length of data to place in registered receive buffer */
+	size_t rx_max_len;
+	/** Length of data placed in registered receive buffer */
+	size_t rx_len;
 };
 
 /** List of open files */
@@ -92,6 +101,23 @@ static void posix_file_finished ( struct posix_file *file, int rc ) {
 	file->rc = rc;
 }
 
+/**
+ * Check for space in registered receive buffer
+ *
+ * @v file		POSIX file
+ * @v len		Length of data
+ * @ret has_space	Data may be placed in registered receive buffer
+ *
+ * Data may be placed directly into the registered receive buffer
+ * only if there is no earlier data still queued.
+ */
+static int posix_file_rx_space ( struct posix_file *file, size_t len ) {
+
+	return ( ( file->rx_buffer != UNULL ) && len &&
+		 ( len <= ( file->rx_max_len - file->rx_len ) ) &&
+		 list_empty ( &file->data ) );
+}
+
 /**
  * Handle deliver_iob() event
  *
@@ -111,7 +137,17 @@ static int posix_file_xfer_deliver ( struct posix_file *file,
 	if ( file->filesize < file->pos )
 		file->filesize = file->pos;
 
-	if ( iob_len ( iobuf ) ) {
+	/* Place data directly into registered receive buffer, if
+	 * possible, otherwise add to received data queue.
+	 */
+	if ( posix_file_rx_space ( file, iob_len ( iobuf ) ) ) {
+		copy_to_user ( file->rx_buffer,
+			       ( file->rx_offset + file->rx_len ),
+			       iobuf->data, iob_len ( iobuf ) );
+		file->rx_len += iob_len ( iobuf );
+		file->pos += iob_len ( iobuf );
+		free_iob ( iobuf );
+	} else if ( iob_len ( iobuf ) ) {
 		list_add_tail ( &iobuf->list, &file->data );
 	} else {
 		free_iob ( iobuf );
@@ -120,9 +156,44 @@ static int posix_file_xfer_deliver ( struct posix_file *file,
 	return 0;
 }
 
+/**
+ * Handle deliver_chksum() event
+ *
+ * @v file		POSIX file
+ * @v data		Data
+ * @v len		Length of data
+ * @v partial		TCP/IP checksum of preceding data
+ * @ret rc		Return status code
+ */
+static int posix_file_xfer_deliver_chksum ( struct posix_file *file,
+					    const void *data, size_t len,
+					    uint16_t partial ) {
+	void *dest;
+
+	/* Accept data only if it fits within the registered buffer */
+	if ( ! posix_file_rx_space ( file, len ) )
+		return -ENOTSUP;
+
+	/* Copy and checksum data into registered receive buffer */
+	dest = user_to_virt ( file->rx_buffer,
+			      ( file->rx_offset + file->rx_len ) );
+	if ( tcpip_copy_chksum ( partial, dest, data, len ) != 0 )
+		return -EINVAL;
+	file->rx_len += len;
+	file->pos += len;
+
+	/* Keep track of file position solely for the filesize */
+	if ( file->filesize < file->pos )
+		file->filesize = file->pos;
+
+	return 0;
+}
+
 /** POSIX file data transfer interface operations */
 static struct interface_operation posix_file_xfer_operations[] = {
 	INTF_OP ( xfer_deliver, struct posix_file *, posix_file_xfer_deliver ),
+	INTF_OP ( xfer_deliver_chksum, struct posix_file *,
+		  posix_file_xfer_deliver_chksum ),
 	INTF_OP ( intf_close, struct posix_file *, posix_file_finished ),
 };
 
@@ -267,9 +338,19 @@ ssize_t read_user ( int fd, userptr_t buffer, off_t offset, size_t max_len ) {
 	if ( ! file )
 		return -EBADF;
 
-	/* Try to fetch more data if none available */
-	if ( list_empty ( &file->data ) )
+	/* Try to fetch more data if none available, allowing it to
+	 * be placed directly into the caller's buffer.
+	 */
+	if ( list_empty ( &file->data ) ) {
+		file->rx_buffer = buffer;
+		file->rx_offset = offset;
+		file->rx_max_len = max_len;
+		file->rx_len = 0;
 		step();
+		file->rx_buffer = UNULL;
+		if ( file->rx_len )
+			return file->rx_len;
+	}
 
 	/* Dequeue at most one received I/O buffer into user buffer */
 	list_for_each_entry ( iobuf, &file->data, list ) {
@@ -21,6 +21,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/list.h>
 #include <ipxe/init.h>
 #include <ipxe/process.h>
+#include <ipxe/profile.h>
 
 /** @file
  *
@@ -28,10 +29,20 @@ FILE_LICENCE ( GPL2_OR_LATER );
  *
  * We implement a trivial form of cooperative multitasking, in which
  * all processes share a single stack and address space.
+ *
+ * Each process belongs to a scheduling class, and each class has its
+ * own round-robin run queue.  A process that has nothing to do may
+ * remove itself from its run queue via process_del(), and be added
+ * back via process_add() when it next has work to do.
  */
 
-/** Process run queue */
-static LIST_HEAD ( run_queue );
+/** Process run queues, indexed by scheduling class */
+struct list_head run_queues[PROC_NUM_CLASSES] = {
+	[PROC_CLASS_BACKGROUND] =
+		LIST_HEAD_INIT ( run_queues[PROC_CLASS_BACKGROUND] ),
+	[PROC_CLASS_TX] = LIST_HEAD_INIT ( run_queues[PROC_CLASS_TX] ),
+	[PROC_CLASS_RX] = LIST_HEAD_INIT ( run_queues[PROC_CLASS_RX] ),
+};
 
 /**
  * Get pointer to object containing process
@@ -56,7 +67,8 @@ void process_add ( struct process *process ) {
 		DBGC ( PROC_COL ( process ), "PROCESS " PROC_FMT
 		       " starting\n", PROC_DBG ( process ) );
 		ref_get ( process->refcnt );
-		list_add_tail ( &process->list, &run_queue );
+		list_add_tail ( &process->list,
+				&run_queues[process->desc->class] );
 	} else {
 		DBGC ( PROC_COL ( process ), "PROCESS " PROC_FMT
 		       " already started\n", PROC_DBG ( process ) );
@@ -85,36 +97,55 @@ void process_del ( struct process *process ) {
 }
 
 /**
- * Single-step a single process
+ * Single-step the first process in a run queue
+ *
+ * @v run_queue		Run queue
  *
  * This executes a single step of the first process in the run queue,
  * and moves the process to the end of the run queue.
  */
-void step ( void ) {
+static void step_queue ( struct list_head *run_queue ) {
 	struct process *process;
 	struct process_descriptor *desc;
+	unsigned long started;
 	void *object;
 
-	if ( ( process = list_first_entry ( &run_queue, struct process,
+	if ( ( process = list_first_entry ( run_queue, struct process,
 					    list ) ) ) {
 		ref_get ( process->refcnt ); /* Inhibit destruction mid-step */
 		desc = process->desc;
 		object = process_object ( process );
 		if ( desc->reschedule ) {
 			list_del ( &process->list );
-			list_add_tail ( &process->list, &run_queue );
+			list_add_tail ( &process->list, run_queue );
 		} else {
 			process_del ( process );
 		}
 		DBGC2 ( PROC_COL ( process ), "PROCESS " PROC_FMT
 			" executing\n", PROC_DBG ( process ) );
+		started = profile_timestamp();
 		desc->step ( object );
+		process->cycles += ( profile_timestamp() - started );
+		process->runs++;
 		DBGC2 ( PROC_COL ( process ), "PROCESS " PROC_FMT
 			" finished executing\n", PROC_DBG ( process ) );
 		ref_put ( process->refcnt ); /* Allow destruction */
 	}
 }
 
+/**
+ * Single-step processes
+ *
+ * This executes a single step of the first process in each run
+ * queue, starting with the highest-priority scheduling class.
+ */
+void step ( void ) {
+	unsigned int class = PROC_NUM_CLASSES;
+
+	while ( class-- )
+		step_queue ( &run_queues[class] );
+}
+
 /**
  * Initialise processes
  *
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <stdio.h>
+#include <ipxe/profile.h>
+
+/** @file
+ *
+ * Profiling
+ *
+ * Each profiler maintains a running mean and accumulated variance
+ * using Welford's method, so that no individual samples need to be
+ * stored.
+ *
+ */
+
+/**
+ * Update profiler with a new sample
+ *
+ * @v profiler		Profiler
+ * @v sample		Sample value
+ */
+void profile_update ( struct profiler *profiler, unsigned long sample ) {
+	long delta;
+
+	/* Update sample count */
+	profiler->count++;
+
+	/* Update mean and accumulated variance.  The new mean lies
+	 * between the old mean and the sample, so the product below
+	 * is never negative.
+	 */
+	delta = ( sample - profiler->mean );
+	profiler->mean += ( delta / ( ( long ) profiler->count ) );
+	profiler->accvar += ( ( ( long long ) delta ) *
+			      ( ( long ) ( sample - profiler->mean ) ) );
+
+	DBGC2 ( profiler, "PROFILE %s sample %ld mean %ld count %ld\n",
+		profiler->name, sample, profiler->mean, profiler->count );
+}
+
+/**
+ * Get sample variance
+ *
+ * @v profiler		Profiler
+ * @ret variance	Sample variance
+ */
+unsigned long profile_variance ( struct profiler *profiler ) {
+	unsigned long long variance;
+
+	if ( ! profiler->count )
+		return 0;
+	variance = ( profiler->accvar / profiler->count );
+	if ( variance > ~0UL )
+		return ~0UL;
+	return variance;
+}
+
+/**
+ * Get sample standard deviation
+ *
+ * @v profiler		Profiler
+ * @ret stddev		Sample standard deviation
+ */
+unsigned long profile_stddev ( struct profiler *profiler ) {
+	unsigned long variance = profile_variance ( profiler );
+	unsigned long root = 0;
+	unsigned long bit;
+
+	/* Calculate integer square root, one bit at a time */
+	for ( bit = ( 1UL << ( ( 4 * sizeof ( root ) ) - 1 ) ) ; bit ;
+	      bit >>= 1 ) {
+		if ( ( ( root | bit ) * ( root | bit ) ) <= variance )
+			root |= bit;
+	}
+	return root;
+}
+
+/**
+ * Show profiling statistics
+ *
+ */
+void profstat ( void ) {
+	struct profiler *profiler;
+
+	for_each_table_entry ( profiler, PROFILERS ) {
+		printf ( "%s: %ld samples, mean %ld ticks, stddev %ld\n",
+			 profiler->name, profiler->count, profiler->mean,
+			 profile_stddev ( profiler ) );
+	}
+}
@@ -157,6 +157,39 @@ static char * format_decimal ( char *end, signed long num, int width,
 	return ptr;
 }
 
+/**
+ * Format an unsigned decimal number
+ *
+ * @v end		End of buffer to contain number
+ * @v num		Number to format
+ * @v width		Minimum field width
+ * @v flags		Format flags
+ * @ret ptr		End of buffer
+ *
+ * Fills a buffer in reverse order with a formatted unsigned decimal
+ * number.  The number will be padded to the specified width.
+ *
+ * There must be enough space in the buffer to contain the largest
+ * number that this function can format.
+ */
+static char * format_unsigned ( char *end, unsigned long long num, int width,
+				int flags ) {
+	char *ptr = end;
+	int pad = ( ( flags & ZPAD ) | ' ' );
+
+	/* Generate the number */
+	do {
+		*(--ptr) = '0' + ( num % 10 );
+		num /= 10;
+	} while ( num );
+
+	/* Pad to width */
+	while ( ( end - ptr ) < width )
+		*(--ptr) = pad;
+
+	return ptr;
+}
+
 /**
  * Print character via a printf context
  *
@@ -268,6 +301,17 @@ size_t vcprintf ( struct printf_context *ctx, const char *fmt, va_list args ) {
 				decimal = va_arg ( args, signed int );
 			}
 			ptr = format_decimal ( ptr, decimal, width, flags );
+		} else if ( *fmt == 'u' ) {
+			unsigned long long decimal;
+
+			if ( *length >= sizeof ( unsigned long long ) ) {
+				decimal = va_arg ( args, unsigned long long );
+			} else if ( *length >= sizeof ( unsigned long ) ) {
+				decimal = va_arg ( args, unsigned long );
+			} else {
+				decimal = va_arg ( args, unsigned int );
+			}
+			ptr = format_unsigned ( ptr, decimal, width, flags );
 		} else {
 			*(--ptr) = *fmt;
 		}
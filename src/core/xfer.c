@@ -219,6 +219,58 @@ int xfer_deliver ( struct interface *intf,
 	return rc;
 }
 
+/**
+ * Deliver data with deferred checksum verification
+ *
+ * @v intf		Data transfer interface
+ * @v data		Data
+ * @v len		Length of data
+ * @v partial		TCP/IP checksum of preceding data, in network byte order
+ * @ret rc		Return status code
+ *
+ * This allows a transport-layer protocol to defer verification of a
+ * received packet's TCP/IP checksum to the final consumer of the
+ * data, which can then verify the checksum in the same pass as
+ * copying the data to its ultimate destination (e.g. using
+ * tcpip_copy_chksum()).
+ *
+ * The recipient must consume the data if and only if the TCP/IP
+ * checksum over the data (continued from @c partial) is zero.  If
+ * the recipient returns an error, then the data has not been
+ * consumed, and the caller must fall back to verifying the checksum
+ * itself and delivering the data via xfer_deliver().  A recipient
+ * that declines the data may already have copied it into its buffer,
+ * but must not record it (e.g. as an increased length or position).
+ *
+ * The operation is never passed through to a further interface, since
+ * a filter (e.g. TLS) that declares itself as a pass-through
+ * interface may transform the data before its recipient sees it.  A
+ * filter that does not transform the data must provide its own
+ * xfer_deliver_chksum() method to forward it.
+ */
+int xfer_deliver_chksum ( struct interface *intf, const void *data,
+			  size_t len, uint16_t partial ) {
+	struct interface *dest;
+	xfer_deliver_chksum_TYPE ( void * ) *op =
+		intf_get_dest_op_no_passthru ( intf, xfer_deliver_chksum,
+					       &dest );
+	void *object = intf_object ( dest );
+	int rc;
+
+	DBGC2 ( INTF_COL ( intf ), "INTF " INTF_INTF_FMT " deliver_chksum "
+		"%zd\n", INTF_INTF_DBG ( intf, dest ), len );
+
+	if ( op ) {
+		rc = op ( object, data, len, partial );
+	} else {
+		/* Default is to decline the data */
+		rc = -ENOTSUP;
+	}
+
+	intf_put ( dest );
+	return rc;
+}
+
 /*****************************************************************************
  *
  * Data transfer interface helper functions
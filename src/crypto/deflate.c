@@ -0,0 +1,853 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <ipxe/deflate.h>
+
+/** @file
+ *
+ * DEFLATE decompression algorithm
+ *
+ * This implements the decompression half of the DEFLATE algorithm
+ * as defined by RFC 1951, along with the ZLIB (RFC 1950) and GZIP
+ * (RFC 1952) wrappers.
+ *
+ * The decompressor is a state machine which may be suspended at any
+ * point when it runs out of input data or output space, and resumed
+ * when more input data or output space becomes available.  Data can
+ * therefore be decompressed as it arrives from the network, without
+ * any need to buffer the compressed data.
+ *
+ * The checksums within the ZLIB and GZIP footers are not verified;
+ * only the GZIP uncompressed length is checked.
+ */
+
+/** Decompressor states */
+enum deflate_state {
+	DEFLATE_GZIP_HEADER = 0,
+	DEFLATE_GZIP_OPTIONS,
+	DEFLATE_GZIP_SKIP,
+	DEFLATE_GZIP_STRING,
+	DEFLATE_ZLIB_HEADER,
+	DEFLATE_BLOCK_HEADER,
+	DEFLATE_STORED_HEADER,
+	DEFLATE_STORED_DATA,
+	DEFLATE_DYNAMIC_HEADER,
+	DEFLATE_DYNAMIC_CODELEN,
+	DEFLATE_DYNAMIC_LENGTHS,
+	DEFLATE_DYNAMIC_REPEAT,
+	DEFLATE_LITLEN,
+	DEFLATE_LENGTH_EXTRA,
+	DEFLATE_DISTANCE,
+	DEFLATE_DISTANCE_EXTRA,
+	DEFLATE_COPY,
+	DEFLATE_TRAILER,
+	DEFLATE_DONE,
+	DEFLATE_ERROR,
+};
+
+/** GZIP magic signature */
+#define GZIP_MAGIC 0x8b1f
+
+/** GZIP and ZLIB compression method for DEFLATE */
+#define DEFLATE_METHOD 8
+
+/** GZIP header has extra fields */
+#define GZIP_FEXTRA 0x04
+
+/** GZIP header has original file name */
+#define GZIP_FNAME 0x08
+
+/** GZIP header has comment */
+#define GZIP_FCOMMENT 0x10
+
+/** GZIP header has header CRC */
+#define GZIP_FHCRC 0x02
+
+/** GZIP reserved header flags */
+#define GZIP_FRESERVED 0xe0
+
+/** ZLIB preset dictionary flag */
+#define ZLIB_FDICT 0x20
+
+/** Block types */
+enum deflate_block_type {
+	DEFLATE_STORED = 0,
+	DEFLATE_FIXED = 1,
+	DEFLATE_DYNAMIC = 2,
+};
+
+/** End of block literal/length symbol */
+#define DEFLATE_END_OF_BLOCK 256
+
+/** First length literal/length symbol */
+#define DEFLATE_FIRST_LENGTH 257
+
+/** Number of length symbols */
+#define DEFLATE_LENGTH_CODES 29
+
+/** Number of valid distance symbols */
+#define DEFLATE_VALID_DISTANCE_CODES 30
+
+/** Base lengths for length symbols */
+static const uint16_t deflate_length_base[DEFLATE_LENGTH_CODES] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+/** Number of extra bits for length symbols */
+static const uint8_t deflate_length_extra[DEFLATE_LENGTH_CODES] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+/** Base distances for distance symbols */
+static const uint16_t deflate_distance_base[DEFLATE_VALID_DISTANCE_CODES] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577
+};
+
+/** Number of extra bits for distance symbols */
+static const uint8_t deflate_distance_extra[DEFLATE_VALID_DISTANCE_CODES] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/** Order in which code length code lengths are transmitted */
+static const uint8_t deflate_codelen_order[DEFLATE_CODELEN_CODES] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/** Number of literal/length codes in fixed Huffman block */
+#define DEFLATE_FIXED_LITLEN_COUNT 288
+
+/** Number of distance codes in fixed Huffman block */
+#define DEFLATE_FIXED_DISTANCE_COUNT 32
+
+/**
+ * Reverse bits
+ *
+ * @v value		Value
+ * @v width		Width of value (in bits, at most 16)
+ * @ret reversed	Value with bits reversed
+ */
+static inline __attribute__ (( always_inline )) unsigned int
+deflate_reverse ( unsigned int value, unsigned int width ) {
+
+	value = ( ( ( value >> 1 ) & 0x5555 ) | ( ( value & 0x5555 ) << 1 ) );
+	value = ( ( ( value >> 2 ) & 0x3333 ) | ( ( value & 0x3333 ) << 2 ) );
+	value = ( ( ( value >> 4 ) & 0x0f0f ) | ( ( value & 0x0f0f ) << 4 ) );
+	value = ( ( ( value >> 8 ) & 0x00ff ) | ( ( value & 0x00ff ) << 8 ) );
+	return ( value >> ( 16 - width ) );
+}
+
+/**
+ * Construct Huffman alphabet
+ *
+ * @v huf		Huffman alphabet
+ * @v lengths		Code lengths
+ * @v count		Number of symbols
+ * @ret rc		Return status code
+ */
+static int deflate_huffman ( struct deflate_huffman *huf,
+			     const uint8_t *lengths, unsigned int count ) {
+	unsigned int counts[ DEFLATE_HUFFMAN_BITS + 1 ];
+	unsigned int index[ DEFLATE_HUFFMAN_BITS + 1 ];
+	unsigned int code;
+	unsigned int next;
+	unsigned int prefix;
+	unsigned int len;
+	unsigned int sym;
+	int left;
+
+	/* Count number of codes of each length */
+	memset ( counts, 0, sizeof ( counts ) );
+	for ( sym = 0 ; sym < count ; sym++ )
+		counts[ lengths[sym] ]++;
+	counts[0] = 0;
+
+	/* Reject over-subscribed code sets.  Incomplete code sets
+	 * are permitted (e.g. a single distance code), and any
+	 * unused codes will be rejected when decoding.
+	 */
+	left = 1;
+	for ( len = 1 ; len <= DEFLATE_HUFFMAN_BITS ; len++ ) {
+		left <<= 1;
+		left -= counts[len];
+		if ( left < 0 )
+			return -EINVAL;
+	}
+
+	/* Calculate limits and symbol table offsets */
+	code = 0;
+	next = 0;
+	for ( len = 1 ; len <= DEFLATE_HUFFMAN_BITS ; len++ ) {
+		index[len] = next;
+		huf->offset[len] = ( next - code );
+		code += counts[len];
+		next += counts[len];
+		huf->limit[len] = ( code << ( DEFLATE_HUFFMAN_BITS - len ) );
+		code <<= 1;
+	}
+
+	/* Populate symbol table in order of increasing code */
+	for ( sym = 0 ; sym < count ; sym++ ) {
+		len = lengths[sym];
+		if ( len )
+			huf->symbols[ index[len]++ ] = sym;
+	}
+
+	/* Populate quick-lookup table */
+	for ( prefix = 0 ; prefix < ( 1 << DEFLATE_HUFFMAN_QL_BITS ) ;
+	      prefix++ ) {
+		code = ( prefix << ( DEFLATE_HUFFMAN_BITS -
+				     DEFLATE_HUFFMAN_QL_BITS ) );
+		for ( len = 1 ; len < DEFLATE_HUFFMAN_BITS ; len++ ) {
+			if ( code < huf->limit[len] )
+				break;
+		}
+		huf->lookup[prefix] = len;
+	}
+
+	return 0;
+}
+
+/**
+ * Fill accumulator from input data
+ *
+ * @v deflate		Decompressor
+ * @v in		Compressed input data
+ * @v bits		Number of bits required
+ * @ret available	Required number of bits is available
+ */
+static inline __attribute__ (( always_inline )) int
+deflate_fill ( struct deflate *deflate, struct deflate_chunk *in,
+	       unsigned int bits ) {
+	const uint8_t *data = in->data;
+
+	while ( ( deflate->bits <= 24 ) && ( in->offset < in->len ) ) {
+		deflate->accumulator |= ( ( ( uint32_t ) data[ in->offset++ ] )
+					  << deflate->bits );
+		deflate->bits += 8;
+	}
+	return ( deflate->bits >= bits );
+}
+
+/**
+ * Extract bits from accumulator
+ *
+ * @v deflate		Decompressor
+ * @v bits		Number of bits (at most 16)
+ * @ret value		Extracted value
+ */
+static inline __attribute__ (( always_inline )) unsigned int
+deflate_extract ( struct deflate *deflate, unsigned int bits ) {
+	unsigned int value;
+
+	assert ( bits <= deflate->bits );
+	value = ( deflate->accumulator & ( ( 1 << bits ) - 1 ) );
+	deflate->accumulator >>= bits;
+	deflate->bits -= bits;
+	return value;
+}
+
+/**
+ * Discard bits up to the next byte boundary
+ *
+ * @v deflate		Decompressor
+ */
+static inline void deflate_align ( struct deflate *deflate ) {
+
+	deflate_extract ( deflate, ( deflate->bits & 7 ) );
+}
+
+/**
+ * Decode Huffman-coded symbol
+ *
+ * @v deflate		Decompressor
+ * @v in		Compressed input data
+ * @v huf		Huffman alphabet
+ * @ret sym		Symbol, or negative error
+ *
+ * Returns -EAGAIN if more input data is required.
+ */
+static inline __attribute__ (( always_inline )) int
+deflate_decode ( struct deflate *deflate, struct deflate_chunk *in,
+		 struct deflate_huffman *huf ) {
+	unsigned int code;
+	unsigned int len;
+
+	/* Peek at next code.  Any bits beyond the end of the
+	 * available data will read as zero; this is harmless since
+	 * we check the code length before consuming any bits.
+	 */
+	deflate_fill ( deflate, in, DEFLATE_HUFFMAN_BITS );
+	code = deflate_reverse ( ( deflate->accumulator &
+				   ( ( 1 << DEFLATE_HUFFMAN_BITS ) - 1 ) ),
+				 DEFLATE_HUFFMAN_BITS );
+
+	/* Identify code length */
+	len = huf->lookup[ code >> ( DEFLATE_HUFFMAN_BITS -
+				     DEFLATE_HUFFMAN_QL_BITS ) ];
+	while ( code >= huf->limit[len] ) {
+		if ( ++len > DEFLATE_HUFFMAN_BITS )
+			return -EINVAL;
+	}
+	if ( len > deflate->bits )
+		return -EAGAIN;
+
+	/* Consume code and look up symbol */
+	deflate_extract ( deflate, len );
+	return huf->symbols[ huf->offset[len] +
+			     ( code >> ( DEFLATE_HUFFMAN_BITS - len ) ) ];
+}
+
+/**
+ * Write output byte
+ *
+ * @v deflate		Decompressor
+ * @v out		Output data buffer
+ * @v byte		Byte
+ */
+static inline __attribute__ (( always_inline )) void
+deflate_output ( struct deflate *deflate, struct deflate_chunk *out,
+		 uint8_t byte ) {
+	uint8_t *data = out->data;
+
+	data[ out->offset++ ] = byte;
+	deflate->window[ deflate->total++ & ( DEFLATE_WINDOW_SIZE - 1 ) ] =
+		byte;
+	if ( deflate->window_len < DEFLATE_WINDOW_SIZE )
+		deflate->window_len++;
+}
+
+/**
+ * Construct fixed Huffman alphabets
+ *
+ * @v deflate		Decompressor
+ * @ret rc		Return status code
+ */
+static int deflate_fixed ( struct deflate *deflate ) {
+	uint8_t *lengths = deflate->lengths;
+	unsigned int i;
+	int rc;
+
+	/* Construct literal/length alphabet */
+	for ( i = 0 ; i < DEFLATE_FIXED_LITLEN_COUNT ; i++ ) {
+		lengths[i] = ( ( i < 144 ) ? 8 : ( i < 256 ) ? 9 :
+			       ( i < 280 ) ? 7 : 8 );
+	}
+	if ( ( rc = deflate_huffman ( &deflate->litlen, lengths,
+				      DEFLATE_FIXED_LITLEN_COUNT ) ) != 0 )
+		return rc;
+
+	/* Construct distance alphabet */
+	memset ( lengths, 5, DEFLATE_FIXED_DISTANCE_COUNT );
+	if ( ( rc = deflate_huffman ( &deflate->dist, lengths,
+				      DEFLATE_FIXED_DISTANCE_COUNT ) ) != 0 )
+		return rc;
+
+	return 0;
+}
+
+/**
+ * Initialise decompressor
+ *
+ * @v deflate		Decompressor
+ * @v format		Compression format
+ */
+void deflate_init ( struct deflate *deflate, enum deflate_format format ) {
+	static const unsigned int initial[] = {
+		[DEFLATE_RAW] = DEFLATE_BLOCK_HEADER,
+		[DEFLATE_ZLIB] = DEFLATE_ZLIB_HEADER,
+		[DEFLATE_GZIP] = DEFLATE_GZIP_HEADER,
+	};
+
+	/* Reset state (excluding the sliding window) */
+	memset ( deflate, 0, offsetof ( struct deflate, window ) );
+	deflate->format = format;
+	deflate->state = initial[format];
+}
+
+/**
+ * Check if decompression has finished
+ *
+ * @v deflate		Decompressor
+ * @ret finished	Decompression has finished
+ */
+int deflate_finished ( struct deflate *deflate ) {
+
+	return ( deflate->state == DEFLATE_DONE );
+}
+
+/**
+ * Inflate compressed data
+ *
+ * @v deflate		Decompressor
+ * @v in		Compressed input data
+ * @v out		Output data buffer
+ * @ret rc		Return status code
+ *
+ * Decompression continues until either all input data has been
+ * consumed, the output data buffer is full, or the end of the
+ * compressed stream is reached.  The input and output offsets are
+ * updated to reflect the data consumed and produced.  If the output
+ * data buffer is not full on return, then no further output can be
+ * produced until more input data is available.
+ */
+int deflate_inflate ( struct deflate *deflate, struct deflate_chunk *in,
+		      struct deflate_chunk *out ) {
+	const uint8_t *src;
+	unsigned int magic;
+	unsigned int byte;
+	unsigned int extra;
+	unsigned int len;
+	unsigned int nlen;
+	unsigned int pos;
+	size_t frag_len;
+	int sym;
+	int rc;
+
+	while ( 1 ) {
+		switch ( deflate->state ) {
+
+		case DEFLATE_GZIP_HEADER:
+			/* Accumulate fixed-length header */
+			while ( deflate->index < sizeof ( deflate->header ) ) {
+				if ( ! deflate_fill ( deflate, in, 8 ) )
+					return 0;
+				deflate->header[ deflate->index++ ] =
+					deflate_extract ( deflate, 8 );
+			}
+			magic = ( deflate->header[0] |
+				  ( deflate->header[1] << 8 ) );
+			if ( ( magic != GZIP_MAGIC ) ||
+			     ( deflate->header[2] != DEFLATE_METHOD ) ||
+			     ( deflate->header[3] & GZIP_FRESERVED ) ) {
+				DBGC ( deflate, "DEFLATE %p invalid GZIP "
+				       "header\n", deflate );
+				rc = -EINVAL;
+				goto err;
+			}
+			deflate->flags = deflate->header[3];
+			deflate->state = DEFLATE_GZIP_OPTIONS;
+			break;
+
+		case DEFLATE_GZIP_OPTIONS:
+			/* Process each optional header field in turn */
+			if ( deflate->flags & GZIP_FEXTRA ) {
+				if ( ! deflate_fill ( deflate, in, 16 ) )
+					return 0;
+				deflate->remaining =
+					deflate_extract ( deflate, 16 );
+				deflate->flags &= ~GZIP_FEXTRA;
+				deflate->state = DEFLATE_GZIP_SKIP;
+			} else if ( deflate->flags & GZIP_FNAME ) {
+				deflate->flags &= ~GZIP_FNAME;
+				deflate->state = DEFLATE_GZIP_STRING;
+			} else if ( deflate->flags & GZIP_FCOMMENT ) {
+				deflate->flags &= ~GZIP_FCOMMENT;
+				deflate->state = DEFLATE_GZIP_STRING;
+			} else if ( deflate->flags & GZIP_FHCRC ) {
+				if ( ! deflate_fill ( deflate, in, 16 ) )
+					return 0;
+				deflate_extract ( deflate, 16 );
+				deflate->flags &= ~GZIP_FHCRC;
+			} else {
+				deflate->state = DEFLATE_BLOCK_HEADER;
+			}
+			break;
+
+		case DEFLATE_GZIP_SKIP:
+			/* Skip extra fields */
+			while ( deflate->remaining ) {
+				if ( ! deflate_fill ( deflate, in, 8 ) )
+					return 0;
+				deflate_extract ( deflate, 8 );
+				deflate->remaining--;
+			}
+			deflate->state = DEFLATE_GZIP_OPTIONS;
+			break;
+
+		case DEFLATE_GZIP_STRING:
+			/* Skip NUL-terminated string */
+			do {
+				if ( ! deflate_fill ( deflate, in, 8 ) )
+					return 0;
+			} while ( deflate_extract ( deflate, 8 ) != 0 );
+			deflate->state = DEFLATE_GZIP_OPTIONS;
+			break;
+
+		case DEFLATE_ZLIB_HEADER:
+			if ( ! deflate_fill ( deflate, in, 16 ) )
+				return 0;
+			deflate->header[0] = deflate_extract ( deflate, 8 );
+			deflate->header[1] = deflate_extract ( deflate, 8 );
+			if ( ( ( deflate->header[0] & 0x0f ) !=
+			       DEFLATE_METHOD ) ||
+			     ( deflate->header[1] & ZLIB_FDICT ) ||
+			     ( ( ( deflate->header[0] << 8 ) |
+				 deflate->header[1] ) % 31 ) ) {
+				DBGC ( deflate, "DEFLATE %p invalid ZLIB "
+				       "header\n", deflate );
+				rc = -EINVAL;
+				goto err;
+			}
+			deflate->state = DEFLATE_BLOCK_HEADER;
+			break;
+
+		case DEFLATE_BLOCK_HEADER:
+			if ( ! deflate_fill ( deflate, in, 3 ) )
+				return 0;
+			deflate->final = deflate_extract ( deflate, 1 );
+			switch ( deflate_extract ( deflate, 2 ) ) {
+			case DEFLATE_STORED:
+				deflate_align ( deflate );
+				deflate->state = DEFLATE_STORED_HEADER;
+				break;
+			case DEFLATE_FIXED:
+				if ( ( rc = deflate_fixed ( deflate ) ) != 0 )
+					goto err;
+				deflate->state = DEFLATE_LITLEN;
+				break;
+			case DEFLATE_DYNAMIC:
+				deflate->state = DEFLATE_DYNAMIC_HEADER;
+				break;
+			default:
+				DBGC ( deflate, "DEFLATE %p invalid block "
+				       "type\n", deflate );
+				rc = -EINVAL;
+				goto err;
+			}
+			break;
+
+		case DEFLATE_STORED_HEADER:
+			if ( ! deflate_fill ( deflate, in, 32 ) )
+				return 0;
+			len = deflate_extract ( deflate, 16 );
+			nlen = deflate_extract ( deflate, 16 );
+			if ( len != ( ( ~nlen ) & 0xffff ) ) {
+				DBGC ( deflate, "DEFLATE %p invalid stored "
+				       "block length\n", deflate );
+				rc = -EINVAL;
+				goto err;
+			}
+			deflate->remaining = len;
+			deflate->state = DEFLATE_STORED_DATA;
+			break;
+
+		case DEFLATE_STORED_DATA:
+			/* Copy any bytes remaining in the accumulator */
+			while ( deflate->remaining && deflate->bits ) {
+				if ( out->offset == out->len )
+					return 0;
+				byte = deflate_extract ( deflate, 8 );
+				deflate_output ( deflate, out, byte );
+				deflate->remaining--;
+			}
+
+			/* Copy directly from input data */
+			while ( deflate->remaining ) {
+				frag_len = deflate->remaining;
+				if ( frag_len > ( in->len - in->offset ) )
+					frag_len = ( in->len - in->offset );
+				if ( frag_len > ( out->len - out->offset ) )
+					frag_len = ( out->len - out->offset );
+				if ( ! frag_len )
+					return 0;
+				src = ( in->data + in->offset );
+				in->offset += frag_len;
+				deflate->remaining -= frag_len;
+				while ( frag_len-- ) {
+					byte = *(src++);
+					deflate_output ( deflate, out, byte );
+				}
+			}
+			deflate->index = 0;
+			deflate->state = ( deflate->final ? DEFLATE_TRAILER :
+					   DEFLATE_BLOCK_HEADER );
+			break;
+
+		case DEFLATE_DYNAMIC_HEADER:
+			if ( ! deflate_fill ( deflate, in, 14 ) )
+				return 0;
+			deflate->litlen_count =
+				( deflate_extract ( deflate, 5 ) + 257 );
+			deflate->distance_count =
+				( deflate_extract ( deflate, 5 ) + 1 );
+			deflate->codelen_count =
+				( deflate_extract ( deflate, 4 ) + 4 );
+			if ( deflate->litlen_count > 286 ) {
+				DBGC ( deflate, "DEFLATE %p invalid dynamic "
+				       "block header\n", deflate );
+				rc = -EINVAL;
+				goto err;
+			}
+			memset ( deflate->lengths, 0,
+				 sizeof ( deflate->lengths ) );
+			deflate->index = 0;
+			deflate->state = DEFLATE_DYNAMIC_CODELEN;
+			break;
+
+		case DEFLATE_DYNAMIC_CODELEN:
+			/* Accumulate code length code lengths */
+			while ( deflate->index < deflate->codelen_count ) {
+				if ( ! deflate_fill ( deflate, in, 3 ) )
+					return 0;
+				deflate->lengths[ deflate_codelen_order
+						  [ deflate->index++ ] ] =
+					deflate_extract ( deflate, 3 );
+			}
+			if ( ( rc = deflate_huffman ( &deflate->codelen,
+						      deflate->lengths,
+						      DEFLATE_CODELEN_CODES ) )
+			     != 0 ) {
+				DBGC ( deflate, "DEFLATE %p invalid code "
+				       "length codes\n", deflate );
+				goto err;
+			}
+			memset ( deflate->lengths, 0,
+				 sizeof ( deflate->lengths ) );
+			deflate->index = 0;
+			deflate->state = DEFLATE_DYNAMIC_LENGTHS;
+			break;
+
+		case DEFLATE_DYNAMIC_LENGTHS:
+			/* Decode literal/length and distance code lengths */
+			len = ( deflate->litlen_count +
+				deflate->distance_count );
+			while ( deflate->index < len ) {
+				sym = deflate_decode ( deflate, in,
+						       &deflate->codelen );
+				if ( sym == -EAGAIN )
+					return 0;
+				if ( sym < 0 ) {
+					rc = sym;
+					goto err;
+				}
+				if ( sym < 16 ) {
+					deflate->lengths[ deflate->index++ ] =
+						sym;
+				} else {
+					deflate->symbol = sym;
+					deflate->state =
+						DEFLATE_DYNAMIC_REPEAT;
+					break;
+				}
+			}
+			if ( deflate->state == DEFLATE_DYNAMIC_REPEAT )
+				break;
+
+			/* Construct alphabets */
+			if ( ! deflate->lengths[DEFLATE_END_OF_BLOCK] ) {
+				DBGC ( deflate, "DEFLATE %p missing end of "
+				       "block code\n", deflate );
+				rc = -EINVAL;
+				goto err;
+			}
+			if ( ( rc = deflate_huffman ( &deflate->litlen,
+						      deflate->lengths,
+						      deflate->litlen_count ) )
+			     != 0 ) {
+				DBGC ( deflate, "DEFLATE %p invalid literal/"
+				       "length codes\n", deflate );
+				goto err;
+			}
+			if ( ( rc = deflate_huffman ( &deflate->dist,
+						      ( deflate->lengths +
+							deflate->litlen_count ),
+						      deflate->distance_count ))
+			     != 0 ) {
+				DBGC ( deflate, "DEFLATE %p invalid distance "
+				       "codes\n", deflate );
+				goto err;
+			}
+			deflate->state = DEFLATE_LITLEN;
+			break;
+
+		case DEFLATE_DYNAMIC_REPEAT:
+			/* Repeat previous or zero code length */
+			if ( deflate->symbol == 16 ) {
+				if ( ! deflate_fill ( deflate, in, 2 ) )
+					return 0;
+				if ( ! deflate->index ) {
+					rc = -EINVAL;
+					goto err;
+				}
+				nlen = deflate->lengths[ deflate->index - 1 ];
+				len = ( deflate_extract ( deflate, 2 ) + 3 );
+			} else if ( deflate->symbol == 17 ) {
+				if ( ! deflate_fill ( deflate, in, 3 ) )
+					return 0;
+				nlen = 0;
+				len = ( deflate_extract ( deflate, 3 ) + 3 );
+			} else {
+				if ( ! deflate_fill ( deflate, in, 7 ) )
+					return 0;
+				nlen = 0;
+				len = ( deflate_extract ( deflate, 7 ) + 11 );
+			}
+			if ( ( deflate->index + len ) >
+			     ( deflate->litlen_count +
+			       deflate->distance_count ) ) {
+				DBGC ( deflate, "DEFLATE %p code length "
+				       "overrun\n", deflate );
+				rc = -EINVAL;
+				goto err;
+			}
+			memset ( ( deflate->lengths + deflate->index ),
+				 nlen, len );
+			deflate->index += len;
+			deflate->state = DEFLATE_DYNAMIC_LENGTHS;
+			break;
+
+		case DEFLATE_LITLEN:
+			/* Decode literals until we reach a length code */
+			while ( 1 ) {
+				if ( out->offset == out->len )
+					return 0;
+				sym = deflate_decode ( deflate, in,
+						       &deflate->litlen );
+				if ( sym == -EAGAIN )
+					return 0;
+				if ( sym < 0 ) {
+					rc = sym;
+					goto err;
+				}
+				if ( sym >= DEFLATE_END_OF_BLOCK )
+					break;
+				deflate_output ( deflate, out, sym );
+			}
+			if ( sym == DEFLATE_END_OF_BLOCK ) {
+				deflate->index = 0;
+				deflate->state =
+					( deflate->final ? DEFLATE_TRAILER :
+					  DEFLATE_BLOCK_HEADER );
+				break;
+			}
+			sym -= DEFLATE_FIRST_LENGTH;
+			if ( sym >= DEFLATE_LENGTH_CODES ) {
+				DBGC ( deflate, "DEFLATE %p invalid length "
+				       "code\n", deflate );
+				rc = -EINVAL;
+				goto err;
+			}
+			deflate->length = deflate_length_base[sym];
+			deflate->symbol = deflate_length_extra[sym];
+			deflate->state = DEFLATE_LENGTH_EXTRA;
+			break;
+
+		case DEFLATE_LENGTH_EXTRA:
+			extra = deflate->symbol;
+			if ( ! deflate_fill ( deflate, in, extra ) )
+				return 0;
+			deflate->length += deflate_extract ( deflate, extra );
+			deflate->state = DEFLATE_DISTANCE;
+			break;
+
+		case DEFLATE_DISTANCE:
+			sym = deflate_decode ( deflate, in, &deflate->dist );
+			if ( sym == -EAGAIN )
+				return 0;
+			if ( sym < 0 ) {
+				rc = sym;
+				goto err;
+			}
+			if ( sym >= DEFLATE_VALID_DISTANCE_CODES ) {
+				DBGC ( deflate, "DEFLATE %p invalid distance "
+				       "code\n", deflate );
+				rc = -EINVAL;
+				goto err;
+			}
+			deflate->distance = deflate_distance_base[sym];
+			deflate->symbol = deflate_distance_extra[sym];
+			deflate->state = DEFLATE_DISTANCE_EXTRA;
+			break;
+
+		case DEFLATE_DISTANCE_EXTRA:
+			extra = deflate->symbol;
+			if ( ! deflate_fill ( deflate, in, extra ) )
+				return 0;
+			deflate->distance += deflate_extract ( deflate, extra );
+			if ( deflate->distance > deflate->window_len ) {
+				DBGC ( deflate, "DEFLATE %p distance %d out of "
+				       "range\n", deflate, deflate->distance );
+				rc = -EINVAL;
+				goto err;
+			}
+			deflate->remaining = deflate->length;
+			deflate->state = DEFLATE_COPY;
+			break;
+
+		case DEFLATE_COPY:
+			/* Copy from sliding window */
+			while ( deflate->remaining ) {
+				if ( out->offset == out->len )
+					return 0;
+				pos = ( ( deflate->total - deflate->distance ) &
+					( DEFLATE_WINDOW_SIZE - 1 ) );
+				deflate_output ( deflate, out,
+						 deflate->window[pos] );
+				deflate->remaining--;
+			}
+			deflate->state = DEFLATE_LITLEN;
+			break;
+
+		case DEFLATE_TRAILER:
+			/* Accumulate trailer */
+			deflate_align ( deflate );
+			len = ( ( deflate->format == DEFLATE_GZIP ) ? 8 :
+				( deflate->format == DEFLATE_ZLIB ) ? 4 : 0 );
+			while ( deflate->index < len ) {
+				if ( ! deflate_fill ( deflate, in, 8 ) )
+					return 0;
+				deflate->header[ deflate->index++ ] =
+					deflate_extract ( deflate, 8 );
+			}
+			if ( ( deflate->format == DEFLATE_GZIP ) &&
+			     ( ( deflate->header[4] |
+				 ( deflate->header[5] << 8 ) |
+				 ( deflate->header[6] << 16 ) |
+				 ( ( ( uint32_t ) deflate->header[7] ) << 24 ) )
+			       != deflate->total ) ) {
+				DBGC ( deflate, "DEFLATE %p incorrect length "
+				       "%#08x\n", deflate, deflate->total );
+				rc = -EINVAL;
+				goto err;
+			}
+			deflate->state = DEFLATE_DONE;
+			break;
+
+		case DEFLATE_DONE:
+			return 0;
+
+		default:
+			return -EINVAL;
+		}
+	}
+
+ err:
+	deflate->state = DEFLATE_ERROR;
+	return rc;
+}
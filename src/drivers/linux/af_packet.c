@@ -0,0 +1,559 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE(GPL2_OR_LATER);
+
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <byteswap.h>
+#include <linux_api.h>
+#include <ipxe/list.h>
+#include <ipxe/io.h>
+#include <ipxe/linux.h>
+#include <ipxe/malloc.h>
+#include <ipxe/device.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/ethernet.h>
+#include <ipxe/settings.h>
+#include <ipxe/socket.h>
+#include <ipxe/in.h>
+#include <ipxe/ip.h>
+#include <ipxe/tcp.h>
+#include <ipxe/udp.h>
+#include <ipxe/tcpip.h>
+
+/* This hack prevents pre-2.6.32 headers from redefining struct sockaddr */
+#define __GLIBC__ 2
+#include <linux/socket.h>
+#undef __GLIBC__
+#include <linux/if.h>
+#include <linux/if_packet.h>
+#include <linux/sockios.h>
+
+/** @file
+ *
+ * The AF_PACKET driver.
+ *
+ * Attaches to an existing host interface (e.g. one end of a veth
+ * pair) through a TPACKET_V3 memory-mapped packet socket.  Received
+ * frames are picked up a whole block at a time straight from the
+ * shared ring, and transmitted frames are queued in the shared ring
+ * and handed to the kernel with a single send() per poll, so there is
+ * no per-packet syscall in either direction.
+ */
+
+/* Socket API constants, which live in libc rather than the kernel headers */
+#define LINUX_AF_PACKET 17
+#define LINUX_SOCK_RAW 3
+#define LINUX_SOL_PACKET 263
+#define LINUX_MSG_DONTWAIT 0x40
+
+/* Kernel constant, defined here to avoid <linux/if_ether.h> clashing
+ * with <ipxe/if_ether.h> */
+#define LINUX_ETH_P_ALL 0x0003
+
+/**
+ * Linux's generic socket address
+ *
+ * The struct sockaddr within struct ifreq may be either iPXE's or the
+ * host's definition, so the hardware address returned by
+ * SIOCGIFHWADDR is read through this layout instead.
+ */
+struct linux_sockaddr {
+	/** Address family */
+	uint16_t sa_family;
+	/** Address data */
+	uint8_t sa_data[14];
+};
+
+/** Receive ring block size */
+#define RX_BLOCK_SIZE (64 * 1024)
+
+/** Number of receive ring blocks */
+#define RX_BLOCK_NR 16
+
+/** Receive ring frame size (used only to size the ring) */
+#define RX_FRAME_SIZE 2048
+
+/** Receive block retire timeout, in milliseconds */
+#define RX_BLOCK_TIMEOUT 1
+
+/** Transmit ring frame size */
+#define TX_FRAME_SIZE 2048
+
+/** Number of transmit ring frames */
+#define TX_FRAME_NR 256
+
+/** Transmit ring block size */
+#define TX_BLOCK_SIZE (64 * 1024)
+
+/** Offset of frame data within a transmit ring frame */
+#define TX_DATA_OFFSET (TPACKET3_HDRLEN - sizeof(struct sockaddr_ll))
+
+struct af_packet_nic {
+	/** Host interface name */
+	char *interface;
+	/** Host interface index */
+	int ifindex;
+	/** Packet socket */
+	int fd;
+	/** Memory-mapped rings (receive ring followed by transmit ring) */
+	void *ring;
+	/** Total size of memory-mapped rings */
+	size_t ring_len;
+	/** Transmit ring */
+	void *tx_ring;
+	/** Next receive ring block */
+	unsigned int rx_block;
+	/** Next transmit ring frame */
+	unsigned int tx_frame;
+	/** Transmit ring frames awaiting a send() */
+	unsigned int tx_pending;
+};
+
+/**
+ * Look up the host interface
+ *
+ * @v nic		AF_PACKET NIC
+ * @v hw_addr		Hardware address to fill in
+ * @ret rc		Return status code
+ */
+static int af_packet_lookup(struct af_packet_nic *nic, void *hw_addr)
+{
+	struct ifreq ifr;
+	struct linux_sockaddr *hwaddr;
+	int fd;
+	int rc;
+
+	fd = linux_socket(LINUX_AF_PACKET, LINUX_SOCK_RAW, 0);
+	if (fd < 0) {
+		DBGC(nic, "af_packet %p socket() = %d (%s)\n", nic, fd, linux_strerror(linux_errno));
+		return -ENODEV;
+	}
+
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, nic->interface, IFNAMSIZ);
+
+	if ((rc = linux_ioctl(fd, SIOCGIFINDEX, &ifr)) != 0) {
+		DBGC(nic, "af_packet %p SIOCGIFINDEX(%s) = %d (%s)\n", nic, nic->interface, rc, linux_strerror(linux_errno));
+		rc = -ENODEV;
+		goto out;
+	}
+	nic->ifindex = ifr.ifr_ifindex;
+
+	if ((rc = linux_ioctl(fd, SIOCGIFHWADDR, &ifr)) != 0) {
+		DBGC(nic, "af_packet %p SIOCGIFHWADDR(%s) = %d (%s)\n", nic, nic->interface, rc, linux_strerror(linux_errno));
+		rc = -ENODEV;
+		goto out;
+	}
+	hwaddr = (void *)&ifr.ifr_hwaddr;
+	memcpy(hw_addr, hwaddr->sa_data, ETH_ALEN);
+
+	DBGC(nic, "af_packet %p interface '%s' index %d\n", nic, nic->interface, nic->ifindex);
+
+out:
+	linux_close(fd);
+	return rc;
+}
+
+/** Set a packet socket option */
+static int af_packet_setsockopt(struct af_packet_nic *nic, int optname,
+				const void *optval, int optlen)
+{
+	int ret;
+
+	ret = linux_setsockopt(nic->fd, LINUX_SOL_PACKET, optname, optval, optlen);
+	if (ret != 0) {
+		DBGC(nic, "af_packet %p setsockopt(%d) = %d (%s)\n", nic, optname, ret, linux_strerror(linux_errno));
+		return -EIO;
+	}
+
+	return 0;
+}
+
+/** Open the AF_PACKET device */
+static int af_packet_open(struct net_device *netdev)
+{
+	struct af_packet_nic *nic = netdev->priv;
+	struct tpacket_req3 rx_req;
+	struct tpacket_req3 tx_req;
+	struct packet_mreq mreq;
+	struct sockaddr_ll sll;
+	int version = TPACKET_V3;
+	size_t rx_len;
+	int rc;
+
+	nic->fd = linux_socket(LINUX_AF_PACKET, LINUX_SOCK_RAW,
+			       htons(LINUX_ETH_P_ALL));
+	if (nic->fd < 0) {
+		DBGC(nic, "af_packet %p socket() = %d (%s)\n", nic, nic->fd, linux_strerror(linux_errno));
+		return -ENODEV;
+	}
+
+	if ((rc = af_packet_setsockopt(nic, PACKET_VERSION, &version, sizeof(version))) != 0)
+		goto err;
+
+	/* Receive ring: blocks are retired to us when full or after a timeout */
+	memset(&rx_req, 0, sizeof(rx_req));
+	rx_req.tp_block_size = RX_BLOCK_SIZE;
+	rx_req.tp_block_nr = RX_BLOCK_NR;
+	rx_req.tp_frame_size = RX_FRAME_SIZE;
+	rx_req.tp_frame_nr = (RX_BLOCK_SIZE / RX_FRAME_SIZE) * RX_BLOCK_NR;
+	rx_req.tp_retire_blk_tov = RX_BLOCK_TIMEOUT;
+	if ((rc = af_packet_setsockopt(nic, PACKET_RX_RING, &rx_req, sizeof(rx_req))) != 0)
+		goto err;
+
+	/* Transmit ring: fixed-size frames */
+	memset(&tx_req, 0, sizeof(tx_req));
+	tx_req.tp_block_size = TX_BLOCK_SIZE;
+	tx_req.tp_frame_size = TX_FRAME_SIZE;
+	tx_req.tp_frame_nr = TX_FRAME_NR;
+	tx_req.tp_block_nr = (TX_FRAME_NR * TX_FRAME_SIZE) / TX_BLOCK_SIZE;
+	if ((rc = af_packet_setsockopt(nic, PACKET_TX_RING, &tx_req, sizeof(tx_req))) != 0)
+		goto err;
+
+	rx_len = RX_BLOCK_SIZE * RX_BLOCK_NR;
+	nic->ring_len = rx_len + (TX_BLOCK_SIZE * tx_req.tp_block_nr);
+	nic->ring = linux_mmap(NULL, nic->ring_len, PROT_READ | PROT_WRITE,
+			       MAP_SHARED, nic->fd, 0);
+	if (nic->ring == MAP_FAILED) {
+		DBGC(nic, "af_packet %p mmap() failed (%s)\n", nic, linux_strerror(linux_errno));
+		rc = -ENOMEM;
+		goto err;
+	}
+	nic->tx_ring = nic->ring + rx_len;
+	nic->rx_block = 0;
+	nic->tx_frame = 0;
+	nic->tx_pending = 0;
+
+	/* Accept frames for whichever MAC address we end up using */
+	memset(&mreq, 0, sizeof(mreq));
+	mreq.mr_ifindex = nic->ifindex;
+	mreq.mr_type = PACKET_MR_PROMISC;
+	if ((rc = af_packet_setsockopt(nic, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq))) != 0)
+		goto err_unmap;
+
+	memset(&sll, 0, sizeof(sll));
+	sll.sll_family = LINUX_AF_PACKET;
+	sll.sll_protocol = htons(LINUX_ETH_P_ALL);
+	sll.sll_ifindex = nic->ifindex;
+	if ((rc = linux_bind(nic->fd, (void *)&sll, sizeof(sll))) != 0) {
+		DBGC(nic, "af_packet %p bind() = %d (%s)\n", nic, rc, linux_strerror(linux_errno));
+		rc = -ENODEV;
+		goto err_unmap;
+	}
+
+	return 0;
+
+err_unmap:
+	linux_munmap(nic->ring, nic->ring_len);
+err:
+	linux_close(nic->fd);
+	return rc;
+}
+
+/** Close the AF_PACKET device */
+static void af_packet_close(struct net_device *netdev)
+{
+	struct af_packet_nic *nic = netdev->priv;
+
+	linux_munmap(nic->ring, nic->ring_len);
+	linux_close(nic->fd);
+}
+
+/** Hand all queued transmit ring frames to the kernel */
+static void af_packet_flush_tx(struct af_packet_nic *nic)
+{
+	if (! nic->tx_pending)
+		return;
+
+	DBGC2(nic, "af_packet %p sending %d frames\n", nic, nic->tx_pending);
+	linux_sendto(nic->fd, NULL, 0, LINUX_MSG_DONTWAIT, NULL, 0);
+	nic->tx_pending = 0;
+}
+
+/**
+ * Transmit an ethernet packet.
+ *
+ * The packet is copied into the transmit ring and marked as complete
+ * immediately.  The kernel is told about it on the next poll, or as
+ * soon as the ring fills up.
+ */
+static int af_packet_transmit(struct net_device *netdev, struct io_buffer *iobuf)
+{
+	struct af_packet_nic *nic = netdev->priv;
+	struct tpacket3_hdr *hdr;
+	size_t len;
+
+	/* Pad and align packet */
+	iob_pad(iobuf, ETH_ZLEN);
+	len = iob_len(iobuf);
+	if (len > (TX_FRAME_SIZE - TX_DATA_OFFSET)) {
+		DBGC(nic, "af_packet %p frame too long (%zd bytes)\n", nic, len);
+		return -ERANGE;
+	}
+
+	hdr = nic->tx_ring + (nic->tx_frame * TX_FRAME_SIZE);
+
+	/*
+	 * The kernel leaves a frame it rejected in TP_STATUS_WRONG_FORMAT
+	 * and never touches it again, so reclaim the slot ourselves.
+	 */
+	if (hdr->tp_status & TP_STATUS_WRONG_FORMAT) {
+		DBGC(nic, "af_packet %p frame %d rejected by kernel\n",
+		     nic, nic->tx_frame);
+		netdev_tx_err(netdev, NULL, -EINVAL);
+		hdr->tp_status = TP_STATUS_AVAILABLE;
+		nic->tx_frame = (nic->tx_frame + 1) % TX_FRAME_NR;
+		hdr = nic->tx_ring + (nic->tx_frame * TX_FRAME_SIZE);
+	}
+
+	if (hdr->tp_status != TP_STATUS_AVAILABLE) {
+		af_packet_flush_tx(nic);
+		DBGC(nic, "af_packet %p transmit ring full\n", nic);
+		return -ENOBUFS;
+	}
+
+	memcpy((void *)hdr + TX_DATA_OFFSET, iobuf->data, len);
+	hdr->tp_len = len;
+	hdr->tp_snaplen = len;
+	wmb();
+	hdr->tp_status = TP_STATUS_SEND_REQUEST;
+
+	nic->tx_frame = (nic->tx_frame + 1) % TX_FRAME_NR;
+	nic->tx_pending++;
+	netdev_tx_complete(netdev, iobuf);
+
+	return 0;
+}
+
+/**
+ * Complete a partial checksum
+ *
+ * Frames sent by the local host stack (e.g. over a veth pair) may
+ * carry only the pseudo-header sum in the checksum field, as with a
+ * virtio-net VIRTIO_NET_HDR_F_NEEDS_CSUM packet.  The ring header does
+ * not say where the checksum lives, so find it for TCP and UDP over
+ * IPv4.
+ */
+static int af_packet_rx_csum(struct af_packet_nic *nic,
+			     struct io_buffer *iobuf)
+{
+	uint16_t *proto = iobuf->data + (2 * ETH_ALEN);
+	struct iphdr *iphdr = iobuf->data + ETH_HLEN;
+	size_t len = iob_len(iobuf);
+	size_t start;
+	size_t end;
+	size_t offset;
+	uint16_t *csum;
+
+	if (len < (ETH_HLEN + sizeof(*iphdr)))
+		return -EINVAL;
+	if (*proto != htons(ETH_P_IP))
+		return -ENOTSUP;
+
+	start = ETH_HLEN + ((iphdr->verhdrlen & IP_MASK_HLEN) * 4);
+	end = ETH_HLEN + ntohs(iphdr->len);
+	switch (iphdr->protocol) {
+	case IP_TCP:
+		offset = offsetof(struct tcp_header, csum);
+		break;
+	case IP_UDP:
+		offset = offsetof(struct udp_header, chksum);
+		break;
+	default:
+		return -ENOTSUP;
+	}
+	if ((end > len) || ((start + offset + sizeof(*csum)) > end)) {
+		DBGC(nic, "af_packet %p invalid partial checksum frame\n",
+		     nic);
+		return -EINVAL;
+	}
+
+	csum = iobuf->data + start + offset;
+	*csum = tcpip_chksum(iobuf->data + start, end - start);
+	return 0;
+}
+
+/** Pass one frame from the receive ring to the network stack */
+static void af_packet_rx_frame(struct net_device *netdev,
+			       struct tpacket3_hdr *hdr)
+{
+	struct af_packet_nic *nic = netdev->priv;
+	struct sockaddr_ll *sll;
+	struct io_buffer *iobuf;
+
+	/* Ignore our own transmitted frames */
+	sll = (void *)hdr + TPACKET_ALIGN(sizeof(*hdr));
+	if (sll->sll_pkttype == PACKET_OUTGOING)
+		return;
+
+	iobuf = alloc_iob(hdr->tp_snaplen);
+	if (! iobuf) {
+		DBGC(nic, "af_packet %p alloc_iob failed\n", nic);
+		netdev_rx_err(netdev, NULL, -ENOMEM);
+		return;
+	}
+	memcpy(iob_put(iobuf, hdr->tp_snaplen), (void *)hdr + hdr->tp_mac,
+	       hdr->tp_snaplen);
+
+	/*
+	 * A frame whose checksum is not yet computed is trusted only
+	 * once we have filled the checksum in; otherwise leave it for
+	 * the protocol to verify (and drop).
+	 */
+	if (hdr->tp_status & TP_STATUS_CSUMNOTREADY) {
+		if (af_packet_rx_csum(nic, iobuf) == 0)
+			iobuf->flags |= IOB_CSUM_VERIFIED;
+	} else if (hdr->tp_status & TP_STATUS_CSUM_VALID) {
+		iobuf->flags |= IOB_CSUM_VERIFIED;
+	}
+
+	netdev_rx(netdev, iobuf);
+}
+
+/**
+ * Poll for new packets
+ *
+ * Each call consumes at most one retired receive block, which may
+ * hold many frames.
+ */
+static void af_packet_poll(struct net_device *netdev)
+{
+	struct af_packet_nic *nic = netdev->priv;
+	struct tpacket_block_desc *block;
+	struct tpacket3_hdr *hdr;
+	unsigned int i;
+
+	af_packet_flush_tx(nic);
+
+	block = nic->ring + (nic->rx_block * RX_BLOCK_SIZE);
+	if (! (block->hdr.bh1.block_status & TP_STATUS_USER))
+		return;
+	rmb();
+
+	DBGC2(nic, "af_packet %p block %d has %d frames\n", nic, nic->rx_block, block->hdr.bh1.num_pkts);
+
+	hdr = (void *)block + block->hdr.bh1.offset_to_first_pkt;
+	for (i = 0; i < block->hdr.bh1.num_pkts; i++) {
+		af_packet_rx_frame(netdev, hdr);
+		hdr = (void *)hdr + hdr->tp_next_offset;
+	}
+
+	/* Return block to the kernel */
+	mb();
+	block->hdr.bh1.block_status = TP_STATUS_KERNEL;
+	nic->rx_block = (nic->rx_block + 1) % RX_BLOCK_NR;
+}
+
+/**
+ * Set irq.
+ *
+ * Not used on linux, provide a dummy implementation.
+ */
+static void af_packet_irq(struct net_device *netdev, int enable)
+{
+	struct af_packet_nic *nic = netdev->priv;
+
+	DBGC(nic, "af_packet %p irq enable = %d\n", nic, enable);
+}
+
+/** AF_PACKET operations */
+static struct net_device_operations af_packet_operations = {
+	.open		= af_packet_open,
+	.close		= af_packet_close,
+	.transmit	= af_packet_transmit,
+	.poll		= af_packet_poll,
+	.irq		= af_packet_irq,
+};
+
+/** Handle a device request for the AF_PACKET driver */
+static int af_packet_probe(struct linux_device *device, struct linux_device_request *request)
+{
+	struct linux_setting *if_setting;
+	struct net_device *netdev;
+	struct af_packet_nic *nic;
+	int rc;
+
+	netdev = alloc_etherdev(sizeof(*nic));
+	if (! netdev)
+		return -ENOMEM;
+
+	netdev_init(netdev, &af_packet_operations);
+	nic = netdev->priv;
+	linux_set_drvdata(device, netdev);
+	netdev->dev = &device->dev;
+	memset(nic, 0, sizeof(*nic));
+
+	/* Look for the mandatory if setting */
+	if_setting = linux_find_setting("if", &request->settings);
+
+	/* No if setting */
+	if (! if_setting) {
+		printf("af_packet missing a mandatory if setting\n");
+		rc = -EINVAL;
+		goto err_settings;
+	}
+
+	nic->interface = if_setting->value;
+	if_setting->applied = 1;
+
+	/* Use the host interface's own MAC address by default */
+	if ((rc = af_packet_lookup(nic, netdev->hw_addr)) != 0) {
+		printf("af_packet cannot find interface '%s'\n", nic->interface);
+		goto err_settings;
+	}
+
+	/* The host supplies checksum state for locally-generated frames */
+	netdev->offloads |= NETDEV_OFFLOAD_RX_CSUM;
+
+	if ((rc = register_netdev(netdev)) != 0)
+		goto err_register;
+
+	netdev_link_up(netdev);
+
+	/* Apply rest of the settings */
+	linux_apply_settings(&request->settings, &netdev->settings.settings);
+
+	return 0;
+
+err_register:
+err_settings:
+	netdev_nullify(netdev);
+	netdev_put(netdev);
+	return rc;
+}
+
+/** Remove the device */
+static void af_packet_remove(struct linux_device *device)
+{
+	struct net_device *netdev = linux_get_drvdata(device);
+	unregister_netdev(netdev);
+	netdev_nullify(netdev);
+	netdev_put(netdev);
+}
+
+/** AF_PACKET linux_driver */
+struct linux_driver af_packet_driver __linux_driver = {
+	.name = "af_packet",
+	.probe = af_packet_probe,
+	.remove = af_packet_remove,
+	.can_probe = 1,
+};
@@ -29,6 +29,8 @@
 #include <ipxe/ethernet.h>
 #include <ipxe/settings.h>
 #include <ipxe/socket.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/tcp.h>
 
 /* This hack prevents pre-2.6.32 headers from redefining struct sockaddr */
 #define __GLIBC__ 2
@@ -37,9 +39,16 @@
 #include <linux/if.h>
 #include <linux/if_ether.h>
 #include <linux/if_tun.h>
+#include <linux/virtio_net.h>
 
 #define RX_BUF_SIZE 1536
 
+/** Number of pre-allocated receive buffers
+ *
+ * This is also the maximum number of packets read in one tap_poll().
+ */
+#define RX_BATCH 32
+
 /** @file
  *
  * The TAP driver.
@@ -52,8 +61,43 @@ struct tap_nic {
 	char * interface;
 	/** File descriptor of the opened tap device */
 	int fd;
+	/** Packets carry a struct virtio_net_hdr */
+	int vnet_hdr;
+	/** Pre-allocated receive buffers */
+	struct io_buffer *rx_iobuf[RX_BATCH];
 };
 
+/** Offloads available when using a vnet header */
+#define TAP_VNET_OFFLOADS (NETDEV_OFFLOAD_RX_CSUM | NETDEV_OFFLOAD_TX_CSUM | \
+			   NETDEV_OFFLOAD_TSO)
+
+/** Refill the receive buffer pool */
+static void tap_refill_rx(struct tap_nic *nic)
+{
+	unsigned int i;
+
+	for (i = 0; i < RX_BATCH; i++) {
+		if (nic->rx_iobuf[i])
+			continue;
+		nic->rx_iobuf[i] = alloc_iob(RX_BUF_SIZE);
+		if (! nic->rx_iobuf[i]) {
+			DBGC(nic, "tap %p alloc_iob failed\n", nic);
+			return;
+		}
+	}
+}
+
+/** Empty the receive buffer pool */
+static void tap_empty_rx(struct tap_nic *nic)
+{
+	unsigned int i;
+
+	for (i = 0; i < RX_BATCH; i++) {
+		free_iob(nic->rx_iobuf[i]);
+		nic->rx_iobuf[i] = NULL;
+	}
+}
+
 /** Open the TAP device */
 static int tap_open(struct net_device * netdev)
 {
@@ -70,6 +114,8 @@ static int tap_open(struct net_device * netdev)
 	memset(&ifr, 0, sizeof(ifr));
 	/* IFF_NO_PI for no extra packet information */
 	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+	if (nic->vnet_hdr)
+		ifr.ifr_flags |= IFF_VNET_HDR;
 	strncpy(ifr.ifr_name, nic->interface, IFNAMSIZ);
 	DBGC(nic, "tap %p interface = '%s'\n", nic, nic->interface);
 
@@ -81,6 +127,19 @@ static int tap_open(struct net_device * netdev)
 		return ret;
 	}
 
+	/*
+	 * Accept packets with partial checksums.  GSO packets are not
+	 * accepted, so that received packets always fit in RX_BUF_SIZE.
+	 */
+	if (nic->vnet_hdr) {
+		ret = linux_ioctl(nic->fd, TUNSETOFFLOAD, TUN_F_CSUM);
+		if (ret != 0) {
+			DBGC(nic, "tap %p ioctl(%d, TUNSETOFFLOAD) = %d (%s)\n", nic, nic->fd, ret, linux_strerror(linux_errno));
+			linux_close(nic->fd);
+			return ret;
+		}
+	}
+
 	/* Set nonblocking mode to make tap_poll easier */
 	ret = linux_fcntl(nic->fd, F_SETFL, O_NONBLOCK);
 
@@ -90,6 +149,8 @@ static int tap_open(struct net_device * netdev)
 		return ret;
 	}
 
+	tap_refill_rx(nic);
+
 	return 0;
 }
 
@@ -98,67 +159,146 @@ static void tap_close(struct net_device *netdev)
 {
 	struct tap_nic * nic = netdev->priv;
 	linux_close(nic->fd);
+	tap_empty_rx(nic);
+}
+
+/** Fill in the vnet header for a packet to be transmitted */
+static void tap_tx_vnet_hdr(struct io_buffer *iobuf,
+			    struct virtio_net_hdr *hdr)
+{
+	struct tcp_header *tcphdr;
+
+	memset(hdr, 0, sizeof(*hdr));
+	if (iobuf->flags & IOB_CSUM_PARTIAL) {
+		hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+		hdr->csum_start = iobuf->csum_start - iob_headroom(iobuf);
+		hdr->csum_offset = iobuf->csum_offset;
+	}
+	if (iobuf->flags & IOB_TSO) {
+		tcphdr = iobuf->data + hdr->csum_start;
+		hdr->gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+		hdr->gso_size = iobuf->mss;
+		hdr->hdr_len = hdr->csum_start +
+			       (tcphdr->hlen & TCP_MASK_HLEN) / 4;
+	}
 }
 
 /**
  * Transmit an ethernet packet.
  *
  * The packet can be written to the TAP device and marked as complete immediately.
+ * With a vnet header, a TSO packet is written with a single syscall and
+ * segmented by the host kernel.
  */
 static int tap_transmit(struct net_device *netdev, struct io_buffer *iobuf)
 {
 	struct tap_nic * nic = netdev->priv;
+	struct virtio_net_hdr hdr;
+	struct linux_iovec iov[2];
 	int rc;
 
 	/* Pad and align packet */
 	iob_pad(iobuf, ETH_ZLEN);
 
-	rc = linux_write(nic->fd, iobuf->data, iobuf->tail - iobuf->data);
+	if (nic->vnet_hdr) {
+		tap_tx_vnet_hdr(iobuf, &hdr);
+		iov[0].iov_base = &hdr;
+		iov[0].iov_len = sizeof(hdr);
+		iov[1].iov_base = iobuf->data;
+		iov[1].iov_len = iob_len(iobuf);
+		rc = linux_writev(nic->fd, iov, 2);
+	} else {
+		rc = linux_write(nic->fd, iobuf->data, iob_len(iobuf));
+	}
 	DBGC2(nic, "tap %p wrote %d bytes\n", nic, rc);
 	netdev_tx_complete(netdev, iobuf);
 
 	return 0;
 }
 
-/** Poll for new packets */
-static void tap_poll(struct net_device *netdev)
+/** Apply a received vnet header to a packet */
+static int tap_rx_vnet_hdr(struct tap_nic *nic, struct io_buffer *iobuf,
+			   struct virtio_net_hdr *hdr)
 {
-	struct tap_nic * nic = netdev->priv;
-	struct pollfd pfd;
-	struct io_buffer * iobuf;
-	int r;
+	size_t len = iob_len(iobuf);
+	uint16_t *csum;
 
-	pfd.fd = nic->fd;
-	pfd.events = POLLIN;
-	if (linux_poll(&pfd, 1, 0) == -1) {
-		DBGC(nic, "tap %p poll failed (%s)\n", nic, linux_strerror(linux_errno));
-		return;
+	if (hdr->gso_type != VIRTIO_NET_HDR_GSO_NONE) {
+		DBGC(nic, "tap %p unexpected gso type %d\n", nic, hdr->gso_type);
+		return -EINVAL;
 	}
-	if ((pfd.revents & POLLIN) == 0)
-		return;
 
-	/* At this point we know there is at least one new packet to be read */
+	/* Complete a partial checksum (e.g. from a local sender) */
+	if (hdr->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) {
+		if ((hdr->csum_start > len) ||
+		    ((hdr->csum_offset + sizeof(*csum)) > (len - hdr->csum_start))) {
+			DBGC(nic, "tap %p invalid partial checksum %d+%d (len %zd)\n", nic, hdr->csum_start, hdr->csum_offset, len);
+			return -EINVAL;
+		}
+		csum = iobuf->data + hdr->csum_start + hdr->csum_offset;
+		*csum = tcpip_chksum(iobuf->data + hdr->csum_start,
+				     len - hdr->csum_start);
+	}
 
-	iobuf = alloc_iob(RX_BUF_SIZE);
-	if (! iobuf)
-		goto allocfail;
+	if (hdr->flags & (VIRTIO_NET_HDR_F_NEEDS_CSUM | VIRTIO_NET_HDR_F_DATA_VALID))
+		iobuf->flags |= IOB_CSUM_VERIFIED;
 
-	while ((r = linux_read(nic->fd, iobuf->data, RX_BUF_SIZE)) > 0) {
-		DBGC2(nic, "tap %p read %d bytes\n", nic, r);
+	return 0;
+}
 
-		iob_put(iobuf, r);
-		netdev_rx(netdev, iobuf);
+/**
+ * Poll for new packets
+ *
+ * The device is nonblocking, so packets are read straight into the
+ * pre-allocated receive buffers until the device runs dry or the
+ * batch is used up; no separate poll() syscall is needed.
+ */
+static void tap_poll(struct net_device *netdev)
+{
+	struct tap_nic * nic = netdev->priv;
+	struct virtio_net_hdr hdr;
+	struct linux_iovec iov[2];
+	struct io_buffer * iobuf;
+	unsigned int i;
+	ssize_t r;
+	int rc;
 
-		iobuf = alloc_iob(RX_BUF_SIZE);
+	for (i = 0; i < RX_BATCH; i++) {
+		iobuf = nic->rx_iobuf[i];
 		if (! iobuf)
-			goto allocfail;
+			break;
+
+		if (nic->vnet_hdr) {
+			iov[0].iov_base = &hdr;
+			iov[0].iov_len = sizeof(hdr);
+			iov[1].iov_base = iobuf->data;
+			iov[1].iov_len = RX_BUF_SIZE;
+			r = linux_readv(nic->fd, iov, 2);
+			if (r < 0)
+				break;
+			if (r < (ssize_t)sizeof(hdr)) {
+				DBGC(nic, "tap %p short read (%zd bytes)\n",
+				     nic, r);
+				break;
+			}
+			r -= sizeof(hdr);
+		} else {
+			r = linux_read(nic->fd, iobuf->data, RX_BUF_SIZE);
+		}
+		if (r <= 0)
+			break;
+		DBGC2(nic, "tap %p read %zd bytes\n", nic, r);
+
+		nic->rx_iobuf[i] = NULL;
+		iob_put(iobuf, r);
+		if (nic->vnet_hdr && (rc = tap_rx_vnet_hdr(nic, iobuf, &hdr)) != 0) {
+			netdev_rx_err(netdev, iobuf, rc);
+			continue;
+		}
+		netdev_rx(netdev, iobuf);
 	}
 
-	free_iob(iobuf);
-	return;
-
-allocfail:
-	DBGC(nic, "tap %p alloc_iob failed\n", nic);
+	tap_refill_rx(nic);
 }
 
 /**
@@ -186,6 +326,7 @@ static struct net_device_operations tap_operations = {
 static int tap_probe(struct linux_device *device, struct linux_device_request *request)
 {
 	struct linux_setting *if_setting;
+	struct linux_setting *vnet_setting;
 	struct net_device *netdev;
 	struct tap_nic *nic;
 	int rc;
@@ -218,6 +359,15 @@ static int tap_probe(struct linux_device *device, struct linux_device_request *r
 	nic->interface = if_setting->value;
 	if_setting->applied = 1;
 
+	/* Look for the optional vnet_hdr setting */
+	vnet_setting = linux_find_setting("vnet_hdr", &request->settings);
+	if (vnet_setting) {
+		nic->vnet_hdr = (strcmp(vnet_setting->value, "0") != 0);
+		vnet_setting->applied = 1;
+	}
+	if (nic->vnet_hdr)
+		netdev->offloads |= TAP_VNET_OFFLOADS;
+
 	/* Apply rest of the settings */
 	linux_apply_settings(&request->settings, &netdev->settings.settings);
 
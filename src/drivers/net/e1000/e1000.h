@@ -93,6 +93,9 @@ struct e1000_adapter;
 /* How many Rx Buffers do we bundle into one write to the hardware ? */
 #define E1000_RX_BUFFER_WRITE	16	/* Must be power of 2 */
 
+/* Maximum checksum offset within a legacy transmit descriptor */
+#define E1000_TX_CSUM_MAX_OFFSET 0xff
+
 #define AUTO_ALL_MODES            0
 #define E1000_EEPROM_82544_APM    0x0004
 #define E1000_EEPROM_APME         0x0400
@@ -274,11 +277,17 @@ struct e1000_adapter {
 	/* upper limit parameter for tx desc size */
 	u32 tx_desc_pwr;
 
-#define NUM_TX_DESC	8
-#define NUM_RX_DESC	8
+/* Minimum and maximum descriptor ring sizes.  Ring lengths must be a
+ * multiple of 128 bytes, and rings must not cross a 64K boundary.
+ */
+#define MIN_NUM_DESC	8
+#define MAX_NUM_DESC	4096
+
+	unsigned int num_tx_desc;
+	unsigned int num_rx_desc;
 
-	struct io_buffer *tx_iobuf[NUM_TX_DESC];
-	struct io_buffer *rx_iobuf[NUM_RX_DESC];
+	struct io_buffer **tx_iobuf;
+	struct io_buffer **rx_iobuf;
 
 	struct e1000_tx_desc *tx_base;
 	struct e1000_rx_desc *rx_base;
@@ -291,6 +300,7 @@ struct e1000_adapter {
 	uint32_t tx_fill_ctr;
 
 	uint32_t rx_curr;
+	uint32_t rx_fill;
 
 	uint32_t ioaddr;
 	uint32_t irqno;
@@ -184,10 +184,16 @@ static int e1000_setup_tx_resources ( struct e1000_adapter *adapter )
 	   cross 64K bytes.
 	 */
 
+	adapter->tx_iobuf = zalloc ( adapter->num_tx_desc *
+				     sizeof ( adapter->tx_iobuf[0] ) );
+	if ( ! adapter->tx_iobuf )
+		return -ENOMEM;
+
         adapter->tx_base =
 		malloc_dma ( adapter->tx_ring_size, adapter->tx_ring_size );
 
 	if ( ! adapter->tx_base ) {
+		free ( adapter->tx_iobuf );
 		return -ENOMEM;
 	}
 
@@ -242,7 +248,8 @@ static void e1000_process_tx_packets ( struct net_device *netdev )
 		adapter->tx_fill_ctr--;
 		memset ( tx_curr_desc, 0, sizeof ( *tx_curr_desc ) );
 
-		adapter->tx_head = ( adapter->tx_head + 1 ) % NUM_TX_DESC;
+		adapter->tx_head = ( adapter->tx_head + 1 ) %
+				   adapter->num_tx_desc;
 	}
 }
 
@@ -251,6 +258,7 @@ static void e1000_free_tx_resources ( struct e1000_adapter *adapter )
 	DBG ( "e1000_free_tx_resources\n" );
 
         free_dma ( adapter->tx_base, adapter->tx_ring_size );
+	free ( adapter->tx_iobuf );
 }
 
 /**
@@ -294,15 +302,16 @@ static void e1000_configure_tx ( struct e1000_adapter *adapter )
 
 static void e1000_free_rx_resources ( struct e1000_adapter *adapter )
 {
-	int i;
+	unsigned int i;
 
 	DBG ( "e1000_free_rx_resources\n" );
 
 	free_dma ( adapter->rx_base, adapter->rx_ring_size );
 
-	for ( i = 0; i < NUM_RX_DESC; i++ ) {
+	for ( i = 0; i < adapter->num_rx_desc; i++ ) {
 		free_iob ( adapter->rx_iobuf[i] );
 	}
+	free ( adapter->rx_iobuf );
 }
 
 /**
@@ -311,42 +320,46 @@ static void e1000_free_rx_resources ( struct e1000_adapter *adapter )
  * @v adapter	e1000 private structure
  *
  * @ret rc       Returns 0 on success, negative on failure
+ *
+ * Empty descriptors are refilled in ring order, starting from the
+ * oldest, and the tail register is updated once for the whole batch.
  **/
 static int e1000_refill_rx_ring ( struct e1000_adapter *adapter )
 {
-	int i, rx_curr;
+	int rx_fill;
+	int rx_last = -1;
 	int rc = 0;
-	struct e1000_rx_desc *rx_curr_desc;
+	struct e1000_rx_desc *rx_fill_desc;
 	struct e1000_hw *hw = &adapter->hw;
 	struct io_buffer *iob;
 
 	DBG ("e1000_refill_rx_ring\n");
 
-	for ( i = 0; i < NUM_RX_DESC; i++ ) {
-		rx_curr = ( ( adapter->rx_curr + i ) % NUM_RX_DESC );
-		rx_curr_desc = adapter->rx_base + rx_curr;
-
-		if ( rx_curr_desc->status & E1000_RXD_STAT_DD )
-			continue;
+	while ( adapter->rx_iobuf[ rx_fill = adapter->rx_fill ] == NULL ) {
 
-		if ( adapter->rx_iobuf[rx_curr] != NULL )
-			continue;
+		rx_fill_desc = adapter->rx_base + rx_fill;
 
-		DBG ( "Refilling rx desc %d\n", rx_curr );
+		DBG ( "Refilling rx desc %d\n", rx_fill );
 
 		iob = alloc_iob ( MAXIMUM_ETHERNET_VLAN_SIZE );
-		adapter->rx_iobuf[rx_curr] = iob;
-
 		if ( ! iob ) {
 			DBG ( "alloc_iob failed\n" );
 			rc = -ENOMEM;
 			break;
-		} else {
-			rx_curr_desc->buffer_addr = virt_to_bus ( iob->data );
-
-			E1000_WRITE_REG ( hw, E1000_RDT(0), rx_curr );
 		}
+
+		adapter->rx_iobuf[rx_fill] = iob;
+		rx_fill_desc->buffer_addr = virt_to_bus ( iob->data );
+		rx_last = rx_fill;
+		adapter->rx_fill = ( rx_fill + 1 ) % adapter->num_rx_desc;
 	}
+
+	/* Hand refilled descriptors to the NIC */
+	if ( rx_last >= 0 ) {
+		wmb();
+		E1000_WRITE_REG ( hw, E1000_RDT(0), rx_last );
+	}
+
 	return rc;
 }
 
@@ -359,7 +372,7 @@ static int e1000_refill_rx_ring ( struct e1000_adapter *adapter )
  **/
 static int e1000_setup_rx_resources ( struct e1000_adapter *adapter )
 {
-	int i, rc = 0;
+	int rc = 0;
 
 	DBG ( "e1000_setup_rx_resources\n" );
 
@@ -367,25 +380,32 @@ static int e1000_setup_rx_resources ( struct e1000_adapter *adapter )
 	   It must not cross a 64K boundary because of hardware errata
 	 */
 
+	/* let e1000_refill_rx_ring() io_buffer allocations */
+	adapter->rx_iobuf = zalloc ( adapter->num_rx_desc *
+				     sizeof ( adapter->rx_iobuf[0] ) );
+	if ( ! adapter->rx_iobuf )
+		return -ENOMEM;
+
         adapter->rx_base =
 		malloc_dma ( adapter->rx_ring_size, adapter->rx_ring_size );
 
 	if ( ! adapter->rx_base ) {
+		free ( adapter->rx_iobuf );
 		return -ENOMEM;
 	}
 	memset ( adapter->rx_base, 0, adapter->rx_ring_size );
+	adapter->rx_fill = 0;
 
-	for ( i = 0; i < NUM_RX_DESC; i++ ) {
-		/* let e1000_refill_rx_ring() io_buffer allocations */
-		adapter->rx_iobuf[i] = NULL;
-	}
-
-	/* allocate io_buffers */
+	/* allocate io_buffers.  Running out of memory is fatal only
+	 * if no receive buffers at all could be allocated.
+	 */
 	rc = e1000_refill_rx_ring ( adapter );
-	if ( rc < 0 )
+	if ( adapter->rx_iobuf[0] == NULL ) {
 		e1000_free_rx_resources ( adapter );
+		return rc;
+	}
 
-	return rc;
+	return 0;
 }
 
 /**
@@ -417,7 +437,16 @@ static void e1000_configure_rx ( struct e1000_adapter *adapter )
 	E1000_WRITE_REG ( hw, E1000_RDLEN(0), adapter->rx_ring_size );
 
 	E1000_WRITE_REG ( hw, E1000_RDH(0), 0 );
-	E1000_WRITE_REG ( hw, E1000_RDT(0), NUM_RX_DESC - 1 );
+	E1000_WRITE_REG ( hw, E1000_RDT(0),
+			  ( ( adapter->rx_fill + adapter->num_rx_desc - 1 ) %
+			    adapter->num_rx_desc ) );
+
+	/* Enable receive checksum offload, if supported */
+	if ( adapter->netdev->offloads & NETDEV_OFFLOAD_RX_CSUM ) {
+		E1000_WRITE_REG ( hw, E1000_RXCSUM,
+				  ( E1000_READ_REG ( hw, E1000_RXCSUM ) |
+				    E1000_RXCSUM_IPOFL | E1000_RXCSUM_TUOFL ) );
+	}
 
 	/* Enable Receives */
 	rctl |=  E1000_RCTL_EN | E1000_RCTL_BAM | E1000_RCTL_SZ_2048 |
@@ -430,6 +459,34 @@ static void e1000_configure_rx ( struct e1000_adapter *adapter )
         DBG ( "E1000_RCTL:  %#08x\n",  E1000_READ_REG ( hw, E1000_RCTL ) );
 }
 
+/**
+ * e1000_rx_checksum - record receive checksum offload status
+ *
+ * @v adapter	e1000 private structure
+ * @v iobuf	I/O buffer
+ * @v rx_status	Receive descriptor status
+ * @v rx_err	Receive descriptor errors
+ *
+ * Checksums found to be incorrect by the NIC are left for the
+ * network stack to verify (and reject) in software.
+ **/
+static void e1000_rx_checksum ( struct e1000_adapter *adapter,
+				struct io_buffer *iobuf, uint32_t rx_status,
+				uint32_t rx_err )
+{
+	if ( ! ( adapter->netdev->offloads & NETDEV_OFFLOAD_RX_CSUM ) )
+		return;
+	if ( rx_status & E1000_RXD_STAT_IXSM )
+		return;
+
+	if ( ( rx_status & E1000_RXD_STAT_IPCS ) &&
+	     ! ( rx_err & E1000_RXD_ERR_IPE ) )
+		iobuf->flags |= IOB_IP_CSUM_VERIFIED;
+	if ( ( rx_status & ( E1000_RXD_STAT_TCPCS | E1000_RXD_STAT_UDPCS ) ) &&
+	     ! ( rx_err & E1000_RXD_ERR_TCPE ) )
+		iobuf->flags |= IOB_CSUM_VERIFIED;
+}
+
 /**
  * e1000_process_rx_packets - process received packets
  *
@@ -479,6 +536,10 @@ static void e1000_process_rx_packets ( struct net_device *netdev )
 			DBG ( "e1000_poll: Corrupted packet received!"
 			      " rx_err: %#08x\n", rx_err );
 		} else {
+			/* Record any checksums verified by the NIC */
+			e1000_rx_checksum ( adapter, adapter->rx_iobuf[i],
+					    rx_status, rx_err );
+
 			/* Add this packet to the receive queue. */
 			netdev_rx ( netdev, adapter->rx_iobuf[i] );
 		}
@@ -486,7 +547,8 @@ static void e1000_process_rx_packets ( struct net_device *netdev )
 
 		memset ( rx_curr_desc, 0, sizeof ( *rx_curr_desc ) );
 
-		adapter->rx_curr = ( adapter->rx_curr + 1 ) % NUM_RX_DESC;
+		adapter->rx_curr = ( adapter->rx_curr + 1 ) %
+				   adapter->num_rx_desc;
 	}
 }
 
@@ -591,10 +653,13 @@ static int e1000_transmit ( struct net_device *netdev, struct io_buffer *iobuf )
 	struct e1000_hw *hw = &adapter->hw;
 	uint32_t tx_curr = adapter->tx_tail;
 	struct e1000_tx_desc *tx_curr_desc;
+	unsigned int css;
+	unsigned int cso;
+	uint16_t *csum;
 
 	DBG ("e1000_transmit\n");
 
-	if ( adapter->tx_fill_ctr == NUM_TX_DESC ) {
+	if ( adapter->tx_fill_ctr == adapter->num_tx_desc ) {
 		DBG ("TX overflow\n");
 		return -ENOBUFS;
 	}
@@ -620,11 +685,29 @@ static int e1000_transmit ( struct net_device *netdev, struct io_buffer *iobuf )
 		E1000_TXD_CMD_IFCS | iob_len ( iobuf );
 	tx_curr_desc->upper.data = 0;
 
+	/* Request checksum insertion, if applicable.  The legacy
+	 * descriptor format allows for a single checksum, starting
+	 * at most 255 bytes into the packet.
+	 */
+	if ( iobuf->flags & IOB_CSUM_PARTIAL ) {
+		css = ( iobuf->csum_start - iob_headroom ( iobuf ) );
+		cso = ( css + iobuf->csum_offset );
+		if ( cso <= E1000_TX_CSUM_MAX_OFFSET ) {
+			tx_curr_desc->lower.data |= E1000_TXD_CMD_IC;
+			tx_curr_desc->lower.flags.cso = cso;
+			tx_curr_desc->upper.fields.css = css;
+		} else {
+			csum = ( iobuf->data + cso );
+			*csum = tcpip_chksum ( ( iobuf->data + css ),
+					       ( iob_len ( iobuf ) - css ) );
+		}
+	}
+
 	DBG ( "TX fill: %d tx_curr: %d addr: %#08lx len: %zd\n", adapter->tx_fill_ctr,
 	      tx_curr, virt_to_bus ( iobuf->data ), iob_len ( iobuf ) );
 
 	/* Point to next free descriptor */
-	adapter->tx_tail = ( adapter->tx_tail + 1 ) % NUM_TX_DESC;
+	adapter->tx_tail = ( adapter->tx_tail + 1 ) % adapter->num_tx_desc;
 	adapter->tx_fill_ctr++;
 
 	/* Write new tail to NIC, making packet available for transmit
@@ -656,6 +739,10 @@ static void e1000_poll ( struct net_device *netdev )
 	if ( ! icr )
 		return;
 
+	/* Record any packets dropped due to receive overrun */
+	if ( icr & E1000_ICR_RXO )
+		netdev_rx_dropped ( netdev, E1000_READ_REG ( hw, E1000_MPC ) );
+
         DBG ( "e1000_poll: intr_status = %#08x\n", icr );
 
 	e1000_process_tx_packets ( netdev );
@@ -732,9 +819,6 @@ int e1000_probe ( struct pci_device *pdev )
 	adapter->netdev     = netdev;
 	adapter->hw.back    = adapter;
 
-	adapter->tx_ring_size = sizeof ( *adapter->tx_base ) * NUM_TX_DESC;
-	adapter->rx_ring_size = sizeof ( *adapter->rx_base ) * NUM_RX_DESC;
-
 	mmio_start = pci_bar_start ( pdev, PCI_BASE_ADDRESS_0 );
 	mmio_len   = pci_bar_size  ( pdev, PCI_BASE_ADDRESS_0 );
 
@@ -782,6 +866,12 @@ int e1000_probe ( struct pci_device *pdev )
 
 	DBG ( "adapter->hw.mac.type: %#08x\n", adapter->hw.mac.type );
 
+	/* Checksum offload is supported from the 82543 onwards */
+	if ( adapter->hw.mac.type >= e1000_82543 ) {
+		netdev->offloads |= ( NETDEV_OFFLOAD_RX_CSUM |
+				      NETDEV_OFFLOAD_TX_CSUM );
+	}
+
 	/* before reading the EEPROM, reset the controller to
 	 * put the device in a known good starting state
 	 */
@@ -876,6 +966,18 @@ static int e1000_open ( struct net_device *netdev )
 
 	DBG ( "e1000_open\n" );
 
+	/* determine descriptor ring sizes */
+	adapter->num_tx_desc =
+		netdev_tx_ring_size ( netdev, MIN_NUM_DESC, MAX_NUM_DESC );
+	adapter->num_rx_desc =
+		netdev_rx_ring_size ( netdev, MIN_NUM_DESC, MAX_NUM_DESC );
+	adapter->tx_ring_size =
+		sizeof ( *adapter->tx_base ) * adapter->num_tx_desc;
+	adapter->rx_ring_size =
+		sizeof ( *adapter->rx_base ) * adapter->num_rx_desc;
+	DBG ( "Using %d TX and %d RX descriptors\n",
+	      adapter->num_tx_desc, adapter->num_rx_desc );
+
 	/* allocate transmit descriptors */
 	err = e1000_setup_tx_resources ( adapter );
 	if ( err ) {
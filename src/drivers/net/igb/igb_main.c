@@ -510,9 +510,11 @@ static void igb_configure_rx ( struct igb_adapter *adapter )
 	E1000_WRITE_REG ( hw, E1000_RXDCTL(0), rxdctl );
 	E1000_WRITE_FLUSH ( hw );
 
+	/* Enable IPv4 header and TCP/UDP receive checksum offload */
 	rxcsum = E1000_READ_REG(hw, E1000_RXCSUM);
-	rxcsum &= ~( E1000_RXCSUM_TUOFL | E1000_RXCSUM_IPPCSE );
-	E1000_WRITE_REG ( hw, E1000_RXCSUM, 0 );
+	rxcsum &= ~E1000_RXCSUM_IPPCSE;
+	rxcsum |= ( E1000_RXCSUM_IPOFL | E1000_RXCSUM_TUOFL );
+	E1000_WRITE_REG ( hw, E1000_RXCSUM, rxcsum );
 
 	/* The initial value for MRQC disables multiple receive
 	 * queues, however this setting is not recommended.
@@ -564,6 +566,30 @@ static void igb_configure_rx ( struct igb_adapter *adapter )
 	DBG ( "RCTL:  %#08x\n",	 E1000_READ_REG ( hw, E1000_RCTL ) );
 }
 
+/**
+ * igb_rx_checksum - record receive checksum offload status
+ *
+ * @v iobuf	I/O buffer
+ * @v rx_status	Receive descriptor status
+ * @v rx_err	Receive descriptor errors
+ *
+ * Checksums found to be incorrect by the NIC are left for the
+ * network stack to verify (and reject) in software.
+ **/
+static void igb_rx_checksum ( struct io_buffer *iobuf, uint32_t rx_status,
+			      uint32_t rx_err )
+{
+	if ( rx_status & E1000_RXD_STAT_IXSM )
+		return;
+
+	if ( ( rx_status & E1000_RXD_STAT_IPCS ) &&
+	     ! ( rx_err & E1000_RXD_ERR_IPE ) )
+		iobuf->flags |= IOB_IP_CSUM_VERIFIED;
+	if ( ( rx_status & ( E1000_RXD_STAT_TCPCS | E1000_RXD_STAT_UDPCS ) ) &&
+	     ! ( rx_err & E1000_RXD_ERR_TCPE ) )
+		iobuf->flags |= IOB_CSUM_VERIFIED;
+}
+
 /**
  * igb_process_rx_packets - process received packets
  *
@@ -615,6 +641,10 @@ static void igb_process_rx_packets ( struct net_device *netdev )
 			DBG ( "igb_process_rx_packets: Corrupted packet received!"
 			      " rx_err: %#08x\n", rx_err );
 		} else	{
+			/* Record any checksums verified by the NIC */
+			igb_rx_checksum ( adapter->rx_iobuf[i], rx_status,
+					  rx_err );
+
 			/* Add this packet to the receive queue. */
 			netdev_rx ( netdev, adapter->rx_iobuf[i] );
 		}
@@ -793,6 +823,9 @@ int igb_probe ( struct pci_device *pdev )
 	 * generic network device layer */
 	netdev_init ( netdev, &igb_operations );
 
+	/* Receive checksums are verified by the NIC */
+	netdev->offloads |= NETDEV_OFFLOAD_RX_CSUM;
+
 	/* Associate this network device with given PCI device */
 	pci_set_drvdata ( pdev, netdev );
 	netdev->dev = &pdev->dev;
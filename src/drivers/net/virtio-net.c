@@ -24,6 +24,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ipxe/list.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/netdevice.h>
@@ -32,6 +33,8 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/ethernet.h>
 #include <ipxe/virtio-ring.h>
 #include <ipxe/virtio-pci.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/tcp.h>
 #include "virtio-net.h"
 
 /*
@@ -77,17 +80,28 @@ enum {
 };
 
 enum {
-	/** Max number of pending rx packets */
-	NUM_RX_BUF = 8,
-
 	/** Max Ethernet frame length, including FCS and VLAN tag */
 	RX_BUF_SIZE = 1522,
 };
 
+/** Features supported by this driver */
+#define VIRTNET_FEATURES ( ( 1 << VIRTIO_NET_F_CSUM ) |			\
+			   ( 1 << VIRTIO_NET_F_GUEST_CSUM ) |		\
+			   ( 1 << VIRTIO_NET_F_MAC ) |			\
+			   ( 1 << VIRTIO_NET_F_GUEST_TSO4 ) |		\
+			   ( 1 << VIRTIO_NET_F_HOST_TSO4 ) |		\
+			   ( 1 << VIRTIO_NET_F_MRG_RXBUF ) )
+
 struct virtnet_nic {
 	/** Base pio register address */
 	unsigned long ioaddr;
 
+	/** Negotiated features */
+	u32 features;
+
+	/** Length of virtio net packet header */
+	size_t hdr_len;
+
 	/** RX/TX virtqueues */
 	struct vring_virtqueue *virtqueue;
 
@@ -97,59 +111,60 @@ struct virtnet_nic {
 	/** Pending rx packet count */
 	unsigned int rx_num_iobufs;
 
-	/** Virtio net packet header, we only need one */
-	struct virtio_net_hdr empty_header;
+	/** Max number of pending rx packets */
+	unsigned int rx_max_iobufs;
+
+	/** Partially received merged rx packet, if any */
+	struct io_buffer *rx_merge;
+
+	/** Virtio net packet header for partially received rx packet */
+	struct virtio_net_hdr rx_merge_hdr;
+
+	/** Number of rx buffers remaining in partially received packet */
+	unsigned int rx_merge_remaining;
+
+	/** Pending tx packet count */
+	unsigned int tx_num_iobufs;
+
+	/** Virtio net packet headers for tx packets
+	 *
+	 * Each in-flight tx packet uses the header corresponding to
+	 * the first of its descriptors.
+	 */
+	struct virtio_net_hdr_mrg_rxbuf tx_hdr[MAX_QUEUE_NUM];
 };
 
-/** Add an iobuf to a virtqueue
- *
- * @v netdev		Network device
- * @v vq_idx		Virtqueue index (RX_INDEX or TX_INDEX)
- * @v iobuf		I/O buffer
+/**
+ * Check if feature has been negotiated
  *
- * The virtqueue is kicked after the iobuf has been added.
+ * @v virtnet		Virtio-net NIC
+ * @v feature		Feature bit
+ * @ret negotiated	Feature has been negotiated
  */
-static void virtnet_enqueue_iob ( struct net_device *netdev,
-				  int vq_idx, struct io_buffer *iobuf ) {
-	struct virtnet_nic *virtnet = netdev->priv;
-	struct vring_virtqueue *vq = &virtnet->virtqueue[vq_idx];
-	unsigned int out = ( vq_idx == TX_INDEX ) ? 2 : 0;
-	unsigned int in = ( vq_idx == TX_INDEX ) ? 0 : 2;
-	struct vring_list list[] = {
-		{
-			/* Share a single zeroed virtio net header between all
-			 * rx and tx packets.  This works because this driver
-			 * does not use any advanced features so none of the
-			 * header fields get used.
-			 */
-			.addr = ( char* ) &virtnet->empty_header,
-			.length = sizeof ( virtnet->empty_header ),
-		},
-		{
-			.addr = ( char* ) iobuf->data,
-			.length = iob_len ( iobuf ),
-		},
-	};
-
-	DBGC ( virtnet, "VIRTIO-NET %p enqueuing iobuf %p on vq %d\n",
-	       virtnet, iobuf, vq_idx );
-
-	vring_add_buf ( vq, list, out, in, iobuf, 0 );
-	vring_kick ( virtnet->ioaddr, vq, 1 );
+static inline int virtnet_has ( struct virtnet_nic *virtnet,
+				unsigned int feature ) {
+	return ( virtnet->features & ( 1 << feature ) );
 }
 
 /** Try to keep rx virtqueue filled with iobufs
  *
  * @v netdev		Network device
+ *
+ * The virtqueue is kicked once for the whole batch of refilled iobufs.
  */
 static void virtnet_refill_rx_virtqueue ( struct net_device *netdev ) {
 	struct virtnet_nic *virtnet = netdev->priv;
+	struct vring_virtqueue *rx_vq = &virtnet->virtqueue[RX_INDEX];
+	size_t hdr_len = virtnet->hdr_len;
+	unsigned int num_added = 0;
 
-	while ( virtnet->rx_num_iobufs < NUM_RX_BUF ) {
+	while ( virtnet->rx_num_iobufs < virtnet->rx_max_iobufs ) {
 		struct io_buffer *iobuf;
+		struct vring_list list[2];
+		unsigned int in;
 
 		/* Try to allocate a buffer, stop for now if out of memory */
-		iobuf = alloc_iob ( RX_BUF_SIZE );
+		iobuf = alloc_iob ( hdr_len + RX_BUF_SIZE );
 		if ( ! iobuf )
 			break;
 
@@ -157,11 +172,31 @@ static void virtnet_refill_rx_virtqueue ( struct net_device *netdev ) {
 		list_add ( &iobuf->list, &virtnet->rx_iobufs );
 
 		/* Mark packet length until we know the actual size */
-		iob_put ( iobuf, RX_BUF_SIZE );
+		iob_put ( iobuf, ( hdr_len + RX_BUF_SIZE ) );
+
+		/* The packet header is received into the start of the
+		 * buffer.  Without mergeable rx buffers, the header
+		 * must be given its own descriptor.
+		 */
+		list[0].addr = iobuf->data;
+		if ( virtnet_has ( virtnet, VIRTIO_NET_F_MRG_RXBUF ) ) {
+			list[0].length = iob_len ( iobuf );
+			in = 1;
+		} else {
+			list[0].length = hdr_len;
+			list[1].addr = ( iobuf->data + hdr_len );
+			list[1].length = RX_BUF_SIZE;
+			in = 2;
+		}
 
-		virtnet_enqueue_iob ( netdev, RX_INDEX, iobuf );
+		DBGC2 ( virtnet, "VIRTIO-NET %p enqueuing rx iobuf %p\n",
+			virtnet, iobuf );
+		vring_add_buf ( rx_vq, list, 0, in, iobuf, num_added++ );
 		virtnet->rx_num_iobufs++;
 	}
+
+	if ( num_added )
+		vring_kick ( virtnet->ioaddr, rx_vq, num_added );
 }
 
 /** Open network device
@@ -172,12 +207,15 @@ static void virtnet_refill_rx_virtqueue ( struct net_device *netdev ) {
 static int virtnet_open ( struct net_device *netdev ) {
 	struct virtnet_nic *virtnet = netdev->priv;
 	unsigned long ioaddr = virtnet->ioaddr;
-	u32 features;
+	unsigned int descs;
 	int i;
 
 	/* Reset for sanity */
 	vp_reset ( ioaddr );
 
+	/* Negotiate features */
+	vp_set_features ( ioaddr, virtnet->features );
+
 	/* Allocate virtqueues */
 	virtnet->virtqueue = zalloc ( QUEUE_NB *
 				      sizeof ( *virtnet->virtqueue ) );
@@ -195,17 +233,25 @@ static int virtnet_open ( struct net_device *netdev ) {
 		}
 	}
 
-	/* Initialize rx packets */
+	/* Initialize rx packets.  Each rx packet uses two descriptors
+	 * (the header and the packet data), unless mergeable rx
+	 * buffers are in use.
+	 */
 	INIT_LIST_HEAD ( &virtnet->rx_iobufs );
 	virtnet->rx_num_iobufs = 0;
+	descs = ( virtnet_has ( virtnet, VIRTIO_NET_F_MRG_RXBUF ) ? 1 : 2 );
+	virtnet->rx_max_iobufs =
+		netdev_rx_ring_size ( netdev, 1,
+				      ( virtnet->virtqueue[RX_INDEX].vring.num
+					/ descs ) );
+	DBGC ( virtnet, "VIRTIO-NET %p using %d rx buffers\n",
+	       virtnet, virtnet->rx_max_iobufs );
 	virtnet_refill_rx_virtqueue ( netdev );
 
 	/* Disable interrupts before starting */
 	netdev_irq ( netdev, 0 );
 
 	/* Driver is ready */
-	features = vp_get_features ( ioaddr );
-	vp_set_features ( ioaddr, features & ( 1 << VIRTIO_NET_F_MAC ) );
 	vp_set_status ( ioaddr, VIRTIO_CONFIG_S_DRIVER | VIRTIO_CONFIG_S_DRIVER_OK );
 	return 0;
 }
@@ -231,6 +277,12 @@ static void virtnet_close ( struct net_device *netdev ) {
 	}
 	INIT_LIST_HEAD ( &virtnet->rx_iobufs );
 	virtnet->rx_num_iobufs = 0;
+	virtnet->tx_num_iobufs = 0;
+
+	/* Discard any partially received packet */
+	free_iob ( virtnet->rx_merge );
+	virtnet->rx_merge = NULL;
+	virtnet->rx_merge_remaining = 0;
 }
 
 /** Transmit packet
@@ -241,7 +293,51 @@ static void virtnet_close ( struct net_device *netdev ) {
  */
 static int virtnet_transmit ( struct net_device *netdev,
 			      struct io_buffer *iobuf ) {
-	virtnet_enqueue_iob ( netdev, TX_INDEX, iobuf );
+	struct virtnet_nic *virtnet = netdev->priv;
+	struct vring_virtqueue *tx_vq = &virtnet->virtqueue[TX_INDEX];
+	struct virtio_net_hdr_mrg_rxbuf *mrg;
+	struct virtio_net_hdr *hdr;
+	struct tcp_header *tcphdr;
+	struct vring_list list[2];
+
+	/* Check for space in tx virtqueue.  Each packet uses two
+	 * descriptors, and the packet header belongs to the first of
+	 * these, so must not be touched until the descriptors are
+	 * known to be free.
+	 */
+	if ( virtnet->tx_num_iobufs >= ( tx_vq->vring.num / 2 ) ) {
+		DBGC ( virtnet, "VIRTIO-NET %p tx overflow\n", virtnet );
+		return -ENOBUFS;
+	}
+	mrg = &virtnet->tx_hdr[tx_vq->free_head];
+	hdr = &mrg->hdr;
+	list[0].addr = ( char * ) mrg;
+	list[0].length = virtnet->hdr_len;
+	list[1].addr = ( char * ) iobuf->data;
+	list[1].length = iob_len ( iobuf );
+
+	/* Construct packet header */
+	memset ( mrg, 0, sizeof ( *mrg ) );
+	if ( iobuf->flags & IOB_CSUM_PARTIAL ) {
+		hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+		hdr->csum_start = ( iobuf->csum_start - iob_headroom ( iobuf ) );
+		hdr->csum_offset = iobuf->csum_offset;
+	}
+	if ( iobuf->flags & IOB_TSO ) {
+		tcphdr = ( iobuf->data + hdr->csum_start );
+		hdr->gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+		hdr->gso_size = iobuf->mss;
+		hdr->hdr_len = ( hdr->csum_start +
+				 ( ( tcphdr->hlen & TCP_MASK_HLEN ) / 4 ) );
+	}
+
+	DBGC2 ( virtnet, "VIRTIO-NET %p enqueuing tx iobuf %p flags %#02x "
+		"gso %d/%d\n", virtnet, iobuf, hdr->flags, hdr->gso_type,
+		hdr->gso_size );
+
+	vring_add_buf ( tx_vq, list, 2, 0, iobuf, 0 );
+	vring_kick ( virtnet->ioaddr, tx_vq, 1 );
+	virtnet->tx_num_iobufs++;
 	return 0;
 }
 
@@ -256,13 +352,134 @@ static void virtnet_process_tx_packets ( struct net_device *netdev ) {
 	while ( vring_more_used ( tx_vq ) ) {
 		struct io_buffer *iobuf = vring_get_buf ( tx_vq, NULL );
 
-		DBGC ( virtnet, "VIRTIO-NET %p tx complete iobuf %p\n",
-		       virtnet, iobuf );
+		DBGC2 ( virtnet, "VIRTIO-NET %p tx complete iobuf %p\n",
+			virtnet, iobuf );
+		virtnet->tx_num_iobufs--;
 
 		netdev_tx_complete ( netdev, iobuf );
 	}
 }
 
+/** Pass received packet to the network stack
+ *
+ * @v netdev	Network device
+ * @v iobuf	I/O buffer
+ * @v hdr	Virtio net packet header
+ */
+static void virtnet_rx_complete ( struct net_device *netdev,
+				  struct io_buffer *iobuf,
+				  struct virtio_net_hdr *hdr ) {
+	struct virtnet_nic *virtnet = netdev->priv;
+	size_t len = iob_len ( iobuf );
+	uint16_t *csum;
+
+	DBGC2 ( virtnet, "VIRTIO-NET %p rx complete iobuf %p len %zd flags "
+		"%#02x gso %d/%d\n", virtnet, iobuf, len, hdr->flags,
+		hdr->gso_type, hdr->gso_size );
+
+	/* A packet with a partial checksum (e.g. one sent by another
+	 * guest on the same host) has valid contents.  Complete the
+	 * checksum anyway, in case the packet is inspected by a
+	 * protocol that insists on verifying it.
+	 */
+	if ( hdr->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM ) {
+		if ( ( hdr->csum_start > len ) ||
+		     ( ( hdr->csum_offset + sizeof ( *csum ) ) >
+		       ( len - hdr->csum_start ) ) ) {
+			DBGC ( virtnet, "VIRTIO-NET %p invalid partial "
+			       "checksum %d+%d (len %zd)\n", virtnet,
+			       hdr->csum_start, hdr->csum_offset, len );
+			netdev_rx_err ( netdev, iobuf, -EINVAL );
+			return;
+		}
+		csum = ( iobuf->data + hdr->csum_start + hdr->csum_offset );
+		*csum = tcpip_chksum ( ( iobuf->data + hdr->csum_start ),
+				       ( len - hdr->csum_start ) );
+	}
+
+	/* Record checksum verification */
+	if ( hdr->flags & ( VIRTIO_NET_HDR_F_NEEDS_CSUM |
+			    VIRTIO_NET_HDR_F_DATA_VALID ) ) {
+		iobuf->flags |= IOB_CSUM_VERIFIED;
+	}
+
+	/* Pass completed packet to the network stack */
+	netdev_rx ( netdev, iobuf );
+}
+
+/** Process received buffer
+ *
+ * @v netdev	Network device
+ * @v iobuf	I/O buffer
+ *
+ * With mergeable rx buffers, a large packet (e.g. one coalesced by
+ * the host from several TCP segments) may be spread across several
+ * rx buffers.  These are gathered into a single I/O buffer before
+ * the packet is passed to the network stack.
+ */
+static void virtnet_rx_buf ( struct net_device *netdev,
+			     struct io_buffer *iobuf ) {
+	struct virtnet_nic *virtnet = netdev->priv;
+	struct virtio_net_hdr_mrg_rxbuf mrg;
+	struct io_buffer *merge;
+	size_t len = iob_len ( iobuf );
+
+	/* Add buffer to partially received packet, if applicable */
+	if ( virtnet->rx_merge_remaining ) {
+		merge = virtnet->rx_merge;
+		if ( merge && ( len <= iob_tailroom ( merge ) ) ) {
+			memcpy ( iob_put ( merge, len ), iobuf->data, len );
+		} else if ( merge ) {
+			DBGC ( virtnet, "VIRTIO-NET %p merged rx packet too "
+			       "long\n", virtnet );
+			netdev_rx_err ( netdev, merge, -ERANGE );
+			virtnet->rx_merge = merge = NULL;
+		}
+		free_iob ( iobuf );
+		if ( ( --virtnet->rx_merge_remaining == 0 ) && merge ) {
+			virtnet->rx_merge = NULL;
+			virtnet_rx_complete ( netdev, merge,
+					      &virtnet->rx_merge_hdr );
+		}
+		return;
+	}
+
+	/* Strip packet header */
+	if ( len < virtnet->hdr_len ) {
+		DBGC ( virtnet, "VIRTIO-NET %p rx buffer too short (%zd "
+		       "bytes)\n", virtnet, len );
+		netdev_rx_err ( netdev, iobuf, -EINVAL );
+		return;
+	}
+	memset ( &mrg, 0, sizeof ( mrg ) );
+	memcpy ( &mrg, iobuf->data, virtnet->hdr_len );
+	iob_pull ( iobuf, virtnet->hdr_len );
+
+	/* Pass single-buffer packets straight to the network stack */
+	if ( mrg.num_buffers <= 1 ) {
+		virtnet_rx_complete ( netdev, iobuf, &mrg.hdr );
+		return;
+	}
+
+	/* Start gathering a packet spread across several buffers.  If
+	 * we cannot allocate space for the packet, then the remaining
+	 * buffers will be discarded.
+	 */
+	virtnet->rx_merge_remaining = ( mrg.num_buffers - 1 );
+	memcpy ( &virtnet->rx_merge_hdr, &mrg.hdr,
+		 sizeof ( virtnet->rx_merge_hdr ) );
+	merge = alloc_iob ( mrg.num_buffers *
+			    ( virtnet->hdr_len + RX_BUF_SIZE ) );
+	if ( merge ) {
+		memcpy ( iob_put ( merge, iob_len ( iobuf ) ), iobuf->data,
+			 iob_len ( iobuf ) );
+		free_iob ( iobuf );
+	} else {
+		netdev_rx_err ( netdev, iobuf, -ENOMEM );
+	}
+	virtnet->rx_merge = merge;
+}
+
 /** Complete packet reception
  *
  * @v netdev	Network device
@@ -280,14 +497,11 @@ static void virtnet_process_rx_packets ( struct net_device *netdev ) {
 		virtnet->rx_num_iobufs--;
 
 		/* Update iobuf length */
-		iob_unput ( iobuf, RX_BUF_SIZE );
-		iob_put ( iobuf, len - sizeof ( struct virtio_net_hdr ) );
-
-		DBGC ( virtnet, "VIRTIO-NET %p rx complete iobuf %p len %zd\n",
-		       virtnet, iobuf, iob_len ( iobuf ) );
+		iob_empty ( iobuf );
+		iob_put ( iobuf, len );
 
-		/* Pass completed packet to the network stack */
-		netdev_rx ( netdev, iobuf );
+		/* Process received buffer */
+		virtnet_rx_buf ( netdev, iobuf );
 	}
 
 	virtnet_refill_rx_virtqueue ( netdev );
@@ -370,6 +584,7 @@ static int virtnet_probe ( struct pci_device *pci ) {
 
 	/* Load MAC address */
 	features = vp_get_features ( ioaddr );
+	virtnet->features = ( features & VIRTNET_FEATURES );
 	if ( features & ( 1 << VIRTIO_NET_F_MAC ) ) {
 		vp_get ( ioaddr, offsetof ( struct virtio_net_config, mac ),
 			 netdev->hw_addr, ETH_ALEN );
@@ -377,6 +592,28 @@ static int virtnet_probe ( struct pci_device *pci ) {
 		       eth_ntoa ( netdev->hw_addr ) );
 	}
 
+	/* Select features.  Segmentation offload depends upon
+	 * checksum offload in the same direction.  We do not provide
+	 * rx buffers large enough for coalesced TCP segments, and so
+	 * can accept them only via mergeable rx buffers.
+	 */
+	if ( ! virtnet_has ( virtnet, VIRTIO_NET_F_CSUM ) )
+		virtnet->features &= ~( 1 << VIRTIO_NET_F_HOST_TSO4 );
+	if ( ! ( virtnet_has ( virtnet, VIRTIO_NET_F_GUEST_CSUM ) &&
+		 virtnet_has ( virtnet, VIRTIO_NET_F_MRG_RXBUF ) ) )
+		virtnet->features &= ~( 1 << VIRTIO_NET_F_GUEST_TSO4 );
+	virtnet->hdr_len = ( virtnet_has ( virtnet, VIRTIO_NET_F_MRG_RXBUF ) ?
+			     sizeof ( struct virtio_net_hdr_mrg_rxbuf ) :
+			     sizeof ( struct virtio_net_hdr ) );
+	if ( virtnet_has ( virtnet, VIRTIO_NET_F_GUEST_CSUM ) )
+		netdev->offloads |= NETDEV_OFFLOAD_RX_CSUM;
+	if ( virtnet_has ( virtnet, VIRTIO_NET_F_CSUM ) )
+		netdev->offloads |= NETDEV_OFFLOAD_TX_CSUM;
+	if ( virtnet_has ( virtnet, VIRTIO_NET_F_HOST_TSO4 ) )
+		netdev->offloads |= NETDEV_OFFLOAD_TSO;
+	DBGC ( virtnet, "VIRTIO-NET %p features %#08x (host %#08x)\n",
+	       virtnet, virtnet->features, features );
+
 	/* Register network device */
 	if ( ( rc = register_netdev ( netdev ) ) != 0 )
 		goto err_register_netdev;
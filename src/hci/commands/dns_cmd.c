@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdio.h>
+#include <getopt.h>
+#include <ipxe/dns.h>
+#include <ipxe/command.h>
+#include <ipxe/parseopt.h>
+
+/** @file
+ *
+ * DNS cache commands
+ *
+ */
+
+/** "dnscache" options */
+struct dnscache_options {
+	/** Flush cache */
+	int flush;
+};
+
+/** "dnscache" option list */
+static struct option_descriptor dnscache_opts[] = {
+	OPTION_DESC ( "flush", 'f', no_argument,
+		      struct dnscache_options, flush, parse_flag ),
+};
+
+/** "dnscache" command descriptor */
+static struct command_descriptor dnscache_cmd =
+	COMMAND_DESC ( struct dnscache_options, dnscache_opts, 0, 0,
+		       "[--flush]" );
+
+/**
+ * The "dnscache" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int dnscache_exec ( int argc, char **argv ) {
+	struct dnscache_options opts;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &dnscache_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Flush or show DNS cache */
+	if ( opts.flush ) {
+		dns_cache_flush();
+	} else {
+		dns_cache_show();
+	}
+
+	return 0;
+}
+
+/** DNS cache commands */
+struct command dns_commands[] __command = {
+	{
+		.name = "dnscache",
+		.exec = dnscache_exec,
+	},
+};
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdio.h>
+#include <ipxe/malloc.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/command.h>
+#include <ipxe/parseopt.h>
+
+/** @file
+ *
+ * Memory statistics commands
+ *
+ */
+
+/** "memstat" options */
+struct memstat_options {};
+
+/** "memstat" option list */
+static struct option_descriptor memstat_opts[] = {};
+
+/** "memstat" command descriptor */
+static struct command_descriptor memstat_cmd =
+	COMMAND_DESC ( struct memstat_options, memstat_opts, 0, 0, "" );
+
+/**
+ * "memstat" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int memstat_exec ( int argc, char **argv ) {
+	struct memstat_options opts;
+	struct io_buffer_pool *pool;
+	unsigned int i;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &memstat_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Show heap usage */
+	printf ( "Heap: %zd bytes, %zd used (peak %zd), %zd free "
+		 "(largest block %zd)\n", heapmem, ( heapmem - freemem ),
+		 maxusedmem, freemem, mlargest() );
+
+	/* Show I/O buffer pools */
+	for ( i = 0 ; i < IOB_NUM_POOLS ; i++ ) {
+		pool = &iob_pools[i];
+		printf ( "I/O buffer pool %zd: %u free, %lu hits, %lu misses\n",
+			 pool->len, pool->count, pool->hits, pool->misses );
+	}
+
+	return 0;
+}
+
+/** Memory statistics commands */
+struct command memstat_commands[] __command = {
+	{
+		.name = "memstat",
+		.exec = memstat_exec,
+	},
+};
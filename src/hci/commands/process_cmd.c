@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdio.h>
+#include <ipxe/process.h>
+#include <ipxe/command.h>
+#include <ipxe/parseopt.h>
+
+/** @file
+ *
+ * Process management commands
+ *
+ */
+
+/** Scheduling class names */
+static const char *ps_class_names[PROC_NUM_CLASSES] = {
+	[PROC_CLASS_BACKGROUND] = "bg",
+	[PROC_CLASS_TX] = "tx",
+	[PROC_CLASS_RX] = "rx",
+};
+
+/**
+ * Print process statistics
+ *
+ * @v process		Process
+ */
+static void ps_process ( struct process *process ) {
+	struct process_descriptor *desc = process->desc;
+
+	printf ( PROC_FMT " %s %s step %p: %lu runs, %llu cycles\n",
+		 PROC_DBG ( process ), ps_class_names[desc->class],
+		 ( process_running ( process ) ? "running" : "sleeping" ),
+		 desc->step, process->runs, process->cycles );
+}
+
+/** "ps" options */
+struct ps_options {};
+
+/** "ps" option list */
+static struct option_descriptor ps_opts[] = {};
+
+/** "ps" command descriptor */
+static struct command_descriptor ps_cmd =
+	COMMAND_DESC ( struct ps_options, ps_opts, 0, 0, "" );
+
+/**
+ * "ps" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int ps_exec ( int argc, char **argv ) {
+	struct ps_options opts;
+	struct process *process;
+	unsigned int class;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &ps_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Show running processes, in scheduling order */
+	for ( class = PROC_NUM_CLASSES ; class-- ; ) {
+		list_for_each_entry ( process, &run_queues[class], list )
+			ps_process ( process );
+	}
+
+	/* Show sleeping permanent processes */
+	for_each_table_entry ( process, PERMANENT_PROCESSES ) {
+		if ( ! process_running ( process ) )
+			ps_process ( process );
+	}
+
+	return 0;
+}
+
+/** Process management commands */
+struct command process_commands[] __command = {
+	{
+		.name = "ps",
+		.exec = ps_exec,
+	},
+};
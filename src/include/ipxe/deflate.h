@@ -0,0 +1,152 @@
+#ifndef _IPXE_DEFLATE_H
+#define _IPXE_DEFLATE_H
+
+/** @file
+ *
+ * DEFLATE decompression algorithm
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** Compression formats */
+enum deflate_format {
+	/** Raw DEFLATE data (no header or footer) */
+	DEFLATE_RAW,
+	/** ZLIB header and footer */
+	DEFLATE_ZLIB,
+	/** GZIP header and footer */
+	DEFLATE_GZIP,
+};
+
+/** Maximum length of a Huffman code */
+#define DEFLATE_HUFFMAN_BITS 15
+
+/** Number of bits used for Huffman code quick-lookup table */
+#define DEFLATE_HUFFMAN_QL_BITS 8
+
+/** Number of literal/length codes */
+#define DEFLATE_LITLEN_CODES 288
+
+/** Number of distance codes */
+#define DEFLATE_DISTANCE_CODES 32
+
+/** Number of code length codes */
+#define DEFLATE_CODELEN_CODES 19
+
+/** Size of sliding window */
+#define DEFLATE_WINDOW_SIZE 32768
+
+/** A Huffman-coded alphabet */
+struct deflate_huffman {
+	/** Limit of codes (left-aligned) for each code length
+	 *
+	 * All codes of a given length, when left-aligned to
+	 * DEFLATE_HUFFMAN_BITS bits, are strictly less than the limit
+	 * for that length and greater than or equal to the limit for
+	 * any shorter length.
+	 */
+	uint32_t limit[ DEFLATE_HUFFMAN_BITS + 1 ];
+	/** Symbol table index offset for each code length
+	 *
+	 * The symbol table index of a code is obtained by adding the
+	 * code (right-aligned) to the offset for its length.
+	 */
+	int offset[ DEFLATE_HUFFMAN_BITS + 1 ];
+	/** Minimum code length for each quick-lookup prefix */
+	uint8_t lookup[ 1 << DEFLATE_HUFFMAN_QL_BITS ];
+	/** Symbols, sorted by code */
+	uint16_t symbols[DEFLATE_LITLEN_CODES];
+};
+
+/** A DEFLATE decompressor */
+struct deflate {
+	/** Current state */
+	unsigned int state;
+	/** Format */
+	enum deflate_format format;
+
+	/** Accumulator */
+	uint32_t accumulator;
+	/** Number of bits within the accumulator */
+	unsigned int bits;
+
+	/** Header flags (GZIP only) */
+	unsigned int flags;
+	/** Current block is the final block */
+	int final;
+	/** Number of header or trailer bytes received */
+	unsigned int index;
+	/** Header or trailer bytes */
+	uint8_t header[10];
+	/** Remaining length of current data copy or header field */
+	size_t remaining;
+
+	/** Number of literal/length codes in dynamic Huffman block */
+	unsigned int litlen_count;
+	/** Number of distance codes in dynamic Huffman block */
+	unsigned int distance_count;
+	/** Number of code length codes in dynamic Huffman block */
+	unsigned int codelen_count;
+	/** Code lengths for dynamic Huffman block */
+	uint8_t lengths[ DEFLATE_LITLEN_CODES + DEFLATE_DISTANCE_CODES ];
+	/** Current symbol (or extra bit count) */
+	unsigned int symbol;
+	/** Current match length */
+	unsigned int length;
+	/** Current match distance */
+	unsigned int distance;
+
+	/** Literal/length alphabet */
+	struct deflate_huffman litlen;
+	/** Distance alphabet */
+	struct deflate_huffman dist;
+	/** Code length alphabet */
+	struct deflate_huffman codelen;
+
+	/** Total length of output */
+	uint32_t total;
+	/** Number of valid bytes within sliding window */
+	size_t window_len;
+	/** Sliding window */
+	uint8_t window[DEFLATE_WINDOW_SIZE];
+};
+
+/** A chunk of data */
+struct deflate_chunk {
+	/** Data */
+	void *data;
+	/** Current offset */
+	size_t offset;
+	/** Length of data */
+	size_t len;
+};
+
+/**
+ * Initialise chunk of data
+ *
+ * @v chunk		Chunk of data to initialise
+ * @v data		Data
+ * @v offset		Starting offset
+ * @v len		Length
+ */
+static inline __attribute__ (( always_inline )) void
+deflate_chunk_init ( struct deflate_chunk *chunk, void *data,
+		     size_t offset, size_t len ) {
+
+	chunk->data = data;
+	chunk->offset = offset;
+	chunk->len = len;
+}
+
+extern void deflate_init ( struct deflate *deflate,
+			   enum deflate_format format );
+extern int deflate_inflate ( struct deflate *deflate,
+			     struct deflate_chunk *in,
+			     struct deflate_chunk *out );
+extern int deflate_finished ( struct deflate *deflate );
+
+#endif /* _IPXE_DEFLATE_H */
@@ -351,6 +351,27 @@ struct dhcp_client_uuid {
  */
 #define DHCP_EB_SCRIPTLET DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0x51 )
 
+/** Receive descriptor ring size
+ *
+ * Number of receive descriptors to be used by network devices that
+ * support a configurable ring size.
+ */
+#define DHCP_EB_RX_RING DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0x60 )
+
+/** Transmit descriptor ring size
+ *
+ * Number of transmit descriptors to be used by network devices that
+ * support a configurable ring size.
+ */
+#define DHCP_EB_TX_RING DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0x61 )
+
+/** Number of parallel HTTP streams
+ *
+ * If greater than one, HTTP downloads will be fetched using this many
+ * concurrent range requests.
+ */
+#define DHCP_EB_HTTP_STREAMS DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0x62 )
+
 /** Skip PXE DHCP protocol extensions such as ProxyDHCP
  *
  * If set to a non-zero value, iPXE will not wait for ProxyDHCP offers
@@ -19,6 +19,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #define DNS_TYPE_A		1
 #define DNS_TYPE_CNAME		5
+#define DNS_TYPE_SOA		6
 #define DNS_TYPE_ANY		255
 
 #define DNS_CLASS_IN		1
@@ -89,4 +90,7 @@ union dns_rr_info {
 	struct dns_rr_info_cname cname;
 };
 
+extern void dns_cache_show ( void );
+extern void dns_cache_flush ( void );
+
 #endif /* _IPXE_DNS_H */
@@ -9,12 +9,45 @@
 
 FILE_LICENCE ( GPL2_OR_LATER );
 
+#include <stddef.h>
+#include <ipxe/tables.h>
+
+struct interface;
+struct uri;
+
 /** HTTP default port */
 #define HTTP_PORT 80
 
 /** HTTPS default port */
 #define HTTPS_PORT 443
 
+/** Minimum length of each stripe of a parallel HTTP download */
+#define HTTP_MIN_STRIPE_LEN ( 256 * 1024 )
+
+/** An HTTP content encoding */
+struct http_content_encoding {
+	/** Name (as used in Accept-Encoding and Content-Encoding) */
+	const char *name;
+	/**
+	 * Insert content decoder
+	 *
+	 * @v xfer		HTTP data transfer interface
+	 * @ret rc		Return status code
+	 *
+	 * The decoder must insert itself between the data transfer
+	 * interface and that interface's current destination.
+	 */
+	int ( * decode ) ( struct interface *xfer );
+};
+
+/** HTTP content encoding table */
+#define HTTP_CONTENT_ENCODINGS \
+	__table ( struct http_content_encoding, "http_content_encodings" )
+
+/** Declare an HTTP content encoding */
+#define __http_content_encoding __table_entry ( HTTP_CONTENT_ENCODINGS, 01 )
+
+extern unsigned int http_stripes ( size_t len, unsigned int max );
 extern int http_open_filter ( struct interface *xfer, struct uri *uri,
 			      unsigned int default_port,
 			      int ( * filter ) ( struct interface *,
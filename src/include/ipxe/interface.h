@@ -127,6 +127,8 @@ struct interface {
 
 extern void intf_plug ( struct interface *intf, struct interface *dest );
 extern void intf_plug_plug ( struct interface *a, struct interface *b );
+extern void intf_insert ( struct interface *intf, struct interface *upper,
+			  struct interface *lower );
 extern void intf_unplug ( struct interface *intf );
 extern void intf_nullify ( struct interface *intf );
 extern struct interface * intf_get ( struct interface *intf );
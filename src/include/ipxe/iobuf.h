@@ -33,6 +33,32 @@ FILE_LICENCE ( GPL2_OR_LATER );
  */
 #define IOB_ZLEN 64
 
+/**
+ * An I/O buffer pool
+ *
+ * Freed I/O buffers of certain common sizes are retained in a pool,
+ * from which subsequent allocations of a similar size can be
+ * satisfied without going through the heap allocator.  Pooled
+ * buffers are returned to the heap under memory pressure.
+ */
+struct io_buffer_pool {
+	/** Buffer length (excluding descriptor) */
+	size_t len;
+	/** List of free buffers */
+	struct list_head free;
+	/** Number of free buffers */
+	unsigned int count;
+	/** Number of allocations satisfied from the pool */
+	unsigned long hits;
+	/** Number of allocations not satisfied from the pool */
+	unsigned long misses;
+};
+
+/** Number of I/O buffer pools */
+#define IOB_NUM_POOLS 3
+
+extern struct io_buffer_pool iob_pools[IOB_NUM_POOLS];
+
 /**
  * A persistent I/O buffer
  *
@@ -57,8 +83,52 @@ struct io_buffer {
 	void *tail;
 	/** End of the buffer */
         void *end;
+
+	/** Offload flags
+	 *
+	 * This is the bitwise-OR of zero or more IOB_XXX constants.
+	 */
+	unsigned int flags;
+	/** Start of checksummed region (if IOB_CSUM_PARTIAL)
+	 *
+	 * This is the offset from the start of the buffer (not the
+	 * start of data), and so remains valid as headers are added.
+	 */
+	uint16_t csum_start;
+	/** Offset of checksum field within checksummed region (if
+	 * IOB_CSUM_PARTIAL)
+	 */
+	uint16_t csum_offset;
+	/** Maximum segment size (if IOB_TSO) */
+	uint16_t mss;
 };
 
+/** Transport-layer checksum has been verified by hardware
+ *
+ * Set by a network device driver on a received packet.
+ */
+#define IOB_CSUM_VERIFIED 0x0001
+
+/** Transport-layer checksum must be completed by hardware
+ *
+ * The checksum field (identified by @c csum_start and @c
+ * csum_offset) holds the uncomplemented pseudo-header checksum.  The
+ * hardware must calculate the checksum from @c csum_start to the end
+ * of the packet and store it in the checksum field.
+ */
+#define IOB_CSUM_PARTIAL 0x0002
+
+/** TCP/IPv4 segment must be split into @c mss sized segments by
+ * hardware
+ */
+#define IOB_TSO 0x0004
+
+/** IPv4 header checksum has been verified by hardware
+ *
+ * Set by a network device driver on a received packet.
+ */
+#define IOB_IP_CSUM_VERIFIED 0x0008
+
 /**
  * Reserve space at start of I/O buffer
  *
@@ -199,6 +269,7 @@ static inline void iob_populate ( struct io_buffer *iobuf,
 	iobuf->head = iobuf->data = data;
 	iobuf->tail = ( data + len );
 	iobuf->end = ( data + max_len );
+	iobuf->flags = 0;
 }
 
 /**
@@ -22,10 +22,13 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <valgrind/memcheck.h>
 
 extern size_t freemem;
+extern size_t heapmem;
+extern size_t maxusedmem;
 
 extern void * __malloc alloc_memblock ( size_t size, size_t align );
 extern void free_memblock ( void *ptr, size_t size );
 extern void mpopulate ( void *start, size_t len );
+extern size_t mlargest ( void );
 extern void mdumpfree ( void );
 
 /**
@@ -270,6 +270,8 @@ struct net_device_stats {
 	unsigned int good;
 	/** Count of error completions */
 	unsigned int bad;
+	/** Count of packets dropped by the hardware */
+	unsigned int dropped;
 	/** Error breakdowns */
 	struct net_device_error errors[NETDEV_MAX_UNIQUE_ERRORS];
 };
@@ -335,10 +337,24 @@ struct net_device {
 	 * This length includes any link-layer headers.
 	 */
 	size_t max_pkt_len;
+	/** Offload capabilities
+	 *
+	 * This is the bitwise-OR of zero or more NETDEV_OFFLOAD_XXX
+	 * constants.
+	 */
+	unsigned int offloads;
 	/** TX packet queue */
 	struct list_head tx_queue;
+	/** Number of packets in TX queue */
+	unsigned int tx_depth;
+	/** Maximum number of packets ever in TX queue */
+	unsigned int tx_max_depth;
 	/** RX packet queue */
 	struct list_head rx_queue;
+	/** Number of packets in RX queue */
+	unsigned int rx_depth;
+	/** Maximum number of packets ever in RX queue */
+	unsigned int rx_max_depth;
 	/** TX statistics */
 	struct net_device_stats tx_stats;
 	/** RX statistics */
@@ -360,6 +376,17 @@ struct net_device {
 /** Network device receive queue processing is frozen */
 #define NETDEV_RX_FROZEN 0x0004
 
+/** Network device may verify received IPv4 header and transport-layer
+ * checksums
+ */
+#define NETDEV_OFFLOAD_RX_CSUM 0x0001
+
+/** Network device can complete transmitted transport-layer checksums */
+#define NETDEV_OFFLOAD_TX_CSUM 0x0002
+
+/** Network device can segment transmitted TCP/IPv4 packets */
+#define NETDEV_OFFLOAD_TSO 0x0004
+
 /** Link-layer protocol table */
 #define LL_PROTOCOLS __table ( struct ll_protocol, "ll_protocols" )
 
@@ -376,7 +403,7 @@ struct net_device {
 struct net_driver {
 	/** Name */
 	const char *name;
-	/** Probe device
+	/** Probe device (optional)
 	 *
 	 * @v netdev		Network device
 	 * @ret rc		Return status code
@@ -605,6 +632,10 @@ extern void netdev_rx ( struct net_device *netdev, struct io_buffer *iobuf );
 extern void netdev_rx_err ( struct net_device *netdev,
 			    struct io_buffer *iobuf, int rc );
 extern void netdev_poll ( struct net_device *netdev );
+extern unsigned int netdev_rx_ring_size ( struct net_device *netdev,
+					  unsigned int min, unsigned int max );
+extern unsigned int netdev_tx_ring_size ( struct net_device *netdev,
+					  unsigned int min, unsigned int max );
 extern struct io_buffer * netdev_rx_dequeue ( struct net_device *netdev );
 extern struct net_device * alloc_netdev ( size_t priv_size );
 extern int register_netdev ( struct net_device *netdev );
@@ -624,6 +655,17 @@ extern int net_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 		    const void *ll_source, unsigned int flags );
 extern void net_poll ( void );
 
+/**
+ * Record packets dropped by the hardware
+ *
+ * @v netdev		Network device
+ * @v count		Number of packets dropped
+ */
+static inline __attribute__ (( always_inline )) void
+netdev_rx_dropped ( struct net_device *netdev, unsigned int count ) {
+	netdev->rx_stats.dropped += count;
+}
+
 /**
  * Complete network transmission
  *
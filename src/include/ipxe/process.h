@@ -25,6 +25,28 @@ struct process {
 	 * this field may be NULL.
 	 */
 	struct refcnt *refcnt;
+	/** Number of times this process has been stepped */
+	unsigned long runs;
+	/** Total time spent in this process' step() method (in
+	 * CPU-specific "ticks")
+	 */
+	unsigned long long cycles;
+};
+
+/** Scheduling classes
+ *
+ * Processes in a higher-numbered class are stepped first.  Each call
+ * to step() will step at most one process from each class.
+ */
+enum process_class {
+	/** Background processes */
+	PROC_CLASS_BACKGROUND = 0,
+	/** Protocol transmission processes */
+	PROC_CLASS_TX,
+	/** Network receive processes */
+	PROC_CLASS_RX,
+	/** Number of scheduling classes */
+	PROC_NUM_CLASSES
 };
 
 /** A process descriptor */
@@ -41,6 +63,8 @@ struct process_descriptor {
 	void ( * step ) ( void *object );
 	/** Automatically reschedule the process */
 	int reschedule;
+	/** Scheduling class */
+	enum process_class class;
 };
 
 /**
@@ -70,19 +94,33 @@ struct process_descriptor {
 	  : offsetof ( object_type, name ) )
 
 /**
- * Define a process descriptor
+ * Define a process descriptor with a specified scheduling class
  *
  * @v object_type	Containing object data type
  * @v process		Process name (i.e. field within object data type)
  * @v step		Process' step() method
+ * @v class		Scheduling class
  * @ret desc		Object interface descriptor
  */
-#define PROC_DESC( object_type, process, _step ) {			      \
+#define PROC_DESC_CLASS( object_type, process, _step, _class ) {	      \
 		.offset = process_offset ( object_type, process ),	      \
 		.step = PROC_STEP ( object_type, _step ),		      \
 		.reschedule = 1,					      \
+		.class = _class,					      \
 	}
 
+/**
+ * Define a process descriptor
+ *
+ * @v object_type	Containing object data type
+ * @v process		Process name (i.e. field within object data type)
+ * @v step		Process' step() method
+ * @ret desc		Object interface descriptor
+ */
+#define PROC_DESC( object_type, process, _step )			      \
+	PROC_DESC_CLASS ( object_type, process, _step,			      \
+			  PROC_CLASS_BACKGROUND )
+
 /**
  * Define a process descriptor for a process that runs only once
  *
@@ -98,25 +136,41 @@ struct process_descriptor {
 	}
 
 /**
- * Define a process descriptor for a pure process
+ * Define a process descriptor for a pure process with a specified
+ * scheduling class
  *
  * A pure process is a process that does not have a containing object.
  *
  * @v step		Process' step() method
+ * @v class		Scheduling class
  * @ret desc		Object interface descriptor
  */
-#define PROC_DESC_PURE( _step ) {					      \
+#define PROC_DESC_PURE_CLASS( _step, _class ) {				      \
 		.offset = 0,						      \
 		.step = PROC_STEP ( struct process, _step ),		      \
 		.reschedule = 1,					      \
+		.class = _class,					      \
 	}
 
+/**
+ * Define a process descriptor for a pure process
+ *
+ * A pure process is a process that does not have a containing object.
+ *
+ * @v step		Process' step() method
+ * @ret desc		Object interface descriptor
+ */
+#define PROC_DESC_PURE( _step )						      \
+	PROC_DESC_PURE_CLASS ( _step, PROC_CLASS_BACKGROUND )
+
 extern void * __attribute__ (( pure ))
 process_object ( struct process *process );
 extern void process_add ( struct process *process );
 extern void process_del ( struct process *process );
 extern void step ( void );
 
+extern struct list_head run_queues[PROC_NUM_CLASSES];
+
 /**
  * Initialise process without adding to process list
  *
@@ -131,6 +185,8 @@ process_init_stopped ( struct process *process,
 	INIT_LIST_HEAD ( &process->list );
 	process->desc = desc;
 	process->refcnt = refcnt;
+	process->runs = 0;
+	process->cycles = 0;
 }
 
 /**
@@ -170,17 +226,24 @@ process_running ( struct process *process ) {
  */
 #define __permanent_process __table_entry ( PERMANENT_PROCESSES, 01 )
 
-/** Define a permanent process
+/** Define a permanent process with a specified scheduling class
  *
  */
-#define PERMANENT_PROCESS( name, step )					      \
-struct process_descriptor name ## _desc = PROC_DESC_PURE ( step );	      \
+#define PERMANENT_PROCESS_CLASS( name, step, class )			      \
+struct process_descriptor name ## _desc =				      \
+	PROC_DESC_PURE_CLASS ( step, class );				      \
 struct process name __permanent_process = {				      \
 	.list = LIST_HEAD_INIT ( name.list ),				      \
 	.desc = & name ## _desc,					      \
 	.refcnt = NULL,							      \
 };
 
+/** Define a permanent process
+ *
+ */
+#define PERMANENT_PROCESS( name, step )					      \
+	PERMANENT_PROCESS_CLASS ( name, step, PROC_CLASS_BACKGROUND )
+
 /**
  * Find debugging colourisation for a process
  *
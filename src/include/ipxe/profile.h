@@ -10,71 +10,75 @@
 FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <stdint.h>
+#include <bits/profile.h>
+#include <ipxe/tables.h>
+#include <config/general.h>
+
+#ifdef PROFILE_STATS
+#define PROFILING 1
+#else
+#define PROFILING 0
+#endif
 
 /**
  * A data structure for storing profiling information
+ *
+ * Profilers record the cost (in CPU-specific "ticks") of each pass
+ * through an instrumented code path, and accumulate the number of
+ * samples along with their mean and variance.
+ *
+ * Profilers are compiled in only when PROFILE_STATS is defined in
+ * config/general.h.  In all other builds profile_start() and
+ * profile_stop() are no-ops.
  */
-union profiler {
-	/** Timestamp (in CPU-specific "ticks") */
-	uint64_t timestamp;
-	/** Registers returned by rdtsc.
-	 *
-	 * This part should really be architecture-specific code.
-	 */
-	struct {
-		uint32_t eax;
-		uint32_t edx;
-	} rdtsc;
+struct profiler {
+	/** Name */
+	const char *name;
+	/** Start timestamp */
+	unsigned long started;
+	/** Number of samples */
+	unsigned long count;
+	/** Mean sample value */
+	unsigned long mean;
+	/** Accumulated variance (i.e. sum of squared differences) */
+	unsigned long long accvar;
 };
 
-/**
- * Static per-object profiler, for use with simple_profile()
- */
-static union profiler simple_profiler;
+/** Profiler table */
+#define PROFILERS __table ( struct profiler, "profilers" )
+
+/** Declare a profiler */
+#define __profiler __table_entry ( PROFILERS, 01 )
+
+extern void profile_update ( struct profiler *profiler, unsigned long sample );
+extern unsigned long profile_variance ( struct profiler *profiler );
+extern unsigned long profile_stddev ( struct profiler *profiler );
+extern void profstat ( void );
 
 /**
- * Perform profiling
+ * Start profiling
  *
- * @v profiler		Profiler data structure
- * @ret delta		Elapsed ticks since last call to profile().
- *
- * Call profile() both before and after the code you wish to measure.
- * The "after" call will return the measurement.  For example:
- *
- * @code
- *
- *     profile ( &profiler );
- *     ... do something here ...
- *     printf ( "It took %ld ticks to execute\n", profile ( &profiler ) );
- *
- * @endcode
+ * @v profiler		Profiler
  */
-static inline __attribute__ (( always_inline )) unsigned long
-profile ( union profiler *profiler ) {
-	uint64_t last_timestamp = profiler->timestamp;
+static inline __attribute__ (( always_inline )) void
+profile_start ( struct profiler *profiler ) {
 
-	__asm__ __volatile__ ( "rdtsc" :
-			       "=a" ( profiler->rdtsc.eax ),
-			       "=d" ( profiler->rdtsc.edx ) );
-	return ( profiler->timestamp - last_timestamp );
+	if ( PROFILING )
+		profiler->started = profile_timestamp();
 }
 
 /**
- * Perform profiling
+ * Stop profiling
  *
- * @ret delta		Elapsed ticks since last call to profile().
- *
- * When you only need one profiler, you can avoid the hassle of
- * creating your own @c profiler data structure by using
- * simple_profile() instead.
- *
- * simple_profile() is equivalent to profile(&simple_profiler), where
- * @c simple_profiler is a @c profiler data structure that is static
- * to each object which includes @c profile.h.
+ * @v profiler		Profiler
  */
-static inline __attribute__ (( always_inline )) unsigned long
-simple_profile ( void ) {
-	return profile ( &simple_profiler );
+static inline __attribute__ (( always_inline )) void
+profile_stop ( struct profiler *profiler ) {
+
+	if ( PROFILING ) {
+		profile_update ( profiler,
+				 ( profile_timestamp() - profiler->started ) );
+	}
 }
 
 #endif /* _IPXE_PROFILE_H */
@@ -307,6 +307,8 @@ extern struct setting uuid_setting __setting ( SETTING_HOST );
 extern struct setting next_server_setting __setting ( SETTING_BOOT );
 extern struct setting mac_setting __setting ( SETTING_NETDEV );
 extern struct setting busid_setting __setting ( SETTING_NETDEV );
+extern struct setting rx_ring_setting __setting ( SETTING_NETDEV );
+extern struct setting tx_ring_setting __setting ( SETTING_NETDEV );
 
 /**
  * Initialise a settings block
@@ -54,6 +54,70 @@ struct tcp_mss_option {
 /** Code for the TCP MSS option */
 #define TCP_OPTION_MSS 2
 
+/** TCP window scale option */
+struct tcp_window_scale_option {
+	uint8_t kind;
+	uint8_t length;
+	uint8_t scale;
+} __attribute__ (( packed ));
+
+/** Padded TCP window scale option (used for sending) */
+struct tcp_window_scale_padded_option {
+	uint8_t nop[1];
+	struct tcp_window_scale_option wsopt;
+} __attribute__ (( packed ));
+
+/** Code for the TCP window scale option */
+#define TCP_OPTION_WS 3
+
+/** Maximum permitted TCP window scale (as per RFC 7323) */
+#define TCP_MAX_WINDOW_SCALE 14
+
+/** TCP selective acknowledgement permitted option */
+struct tcp_sack_permitted_option {
+	uint8_t kind;
+	uint8_t length;
+} __attribute__ (( packed ));
+
+/** Padded TCP selective acknowledgement permitted option (used for sending) */
+struct tcp_sack_permitted_padded_option {
+	uint8_t nop[2];
+	struct tcp_sack_permitted_option spopt;
+} __attribute__ (( packed ));
+
+/** Code for the TCP selective acknowledgement permitted option */
+#define TCP_OPTION_SACK_PERMITTED 4
+
+/** TCP selective acknowledgement option */
+struct tcp_sack_option {
+	uint8_t kind;
+	uint8_t length;
+} __attribute__ (( packed ));
+
+/** TCP selective acknowledgement block */
+struct tcp_sack_block {
+	/** Left edge (first sequence number of block) */
+	uint32_t left;
+	/** Right edge (sequence number immediately following block) */
+	uint32_t right;
+} __attribute__ (( packed ));
+
+/** Maximum number of selective acknowledgement blocks
+ *
+ * This allows for the presence of the TCP timestamp option within
+ * the 40 bytes of available option space.
+ */
+#define TCP_SACK_MAX 3
+
+/** Padded TCP selective acknowledgement option (used for sending) */
+struct tcp_sack_padded_option {
+	uint8_t nop[2];
+	struct tcp_sack_option sackopt;
+} __attribute__ (( packed ));
+
+/** Code for the TCP selective acknowledgement option */
+#define TCP_OPTION_SACK 5
+
 /** TCP timestamp option */
 struct tcp_timestamp_option {
 	uint8_t kind;
@@ -75,6 +139,10 @@ struct tcp_timestamp_padded_option {
 struct tcp_options {
 	/** MSS option, if present */
 	const struct tcp_mss_option *mssopt;
+	/** Window scale option, if present */
+	const struct tcp_window_scale_option *wsopt;
+	/** SACK permitted option, if present */
+	const struct tcp_sack_permitted_option *spopt;
 	/** Timestampe option, if present */
 	const struct tcp_timestamp_option *tsopt;
 };
@@ -264,25 +332,32 @@ struct tcp_options {
  * have.  This is not strictly accurate (since it ignores any space
  * already allocated as RX buffers), but it will do for now.
  *
- * Since we don't store out-of-order received packets, the
- * retransmission penalty is that the whole window contents must be
- * resent.  This suggests keeping the window size small, but bear in
+ * Out-of-order received packets are held on the receive queue, from
+ * which they can be reclaimed via the cache discarder mechanism if
+ * memory runs short, so the penalty for advertising a window larger
+ * than we can actually buffer is merely a retransmission.  Bear in
  * mind that the maximum bandwidth on any link is limited to
  *
  *    max_bandwidth = ( tcp_window / round_trip_time )
  *
- * With a 48kB window, which probably accurately reflects our amount
- * of free memory, and a WAN RTT of say 200ms, this gives a maximum
- * bandwidth of 240kB/s.  This is sufficiently close to realistic that
- * we will need to be careful that our advertised window doesn't end
- * up limiting WAN download speeds.
+ * A 4MB window allows us to fill a 10Gbps link with a 3ms round-trip
+ * time, or a 100Mbps link with a 300ms (WAN) round-trip time.
+ *
+ * Windows larger than 64kB require the use of TCP window scaling (RFC
+ * 7323); if the peer does not support window scaling, then the
+ * advertised window will be limited to (65536-4) to ensure that
+ * payloads remain dword-aligned.
+ */
+#define TCP_MAX_WINDOW_SIZE ( 4 * 1024 * 1024 )
+
+/**
+ * TCP receive window scale
  *
- * Finally, since the window goes into a 16-bit field and we cannot
- * actually use 65536, we use a window size of (65536-4) to ensure
- * that payloads remain dword-aligned.
+ * This is the window scale factor that we advertise in our SYN.  It
+ * is chosen to allow TCP_MAX_WINDOW_SIZE to fit within the 16-bit
+ * window field.
  */
-//#define TCP_MAX_WINDOW_SIZE	( 65536 - 4 )
-#define TCP_MAX_WINDOW_SIZE	8192
+#define TCP_RX_WINDOW_SCALE 7
 
 /**
  * Path MTU
@@ -292,6 +367,15 @@ struct tcp_options {
  */
 #define TCP_PATH_MTU 1460
 
+/**
+ * Maximum length of data in a segment handed to segmentation offload
+ *
+ * A network device capable of segmentation offload will split
+ * longer segments into segments that fit within the path MTU.  This
+ * is limited to avoid allocating excessively large I/O buffers.
+ */
+#define TCP_TSO_MAX_LEN ( 16 * TCP_PATH_MTU )
+
 /**
  * Advertised TCP MSS
  *
@@ -302,6 +386,16 @@ struct tcp_options {
  */
 #define TCP_MSS 1460
 
+/**
+ * Initial TCP congestion window
+ *
+ * As per RFC 5681, this is three segments for our path MTU.
+ */
+#define TCP_INITIAL_CWND ( 3 * TCP_PATH_MTU )
+
+/** Number of duplicate ACKs that trigger a fast retransmission */
+#define TCP_DUP_ACK_THRESHOLD 3
+
 /** TCP maximum segment lifetime
  *
  * Currently set to 2 minutes, as per RFC 793.
@@ -316,7 +410,11 @@ struct tcp_options {
 	( MAX_LL_NET_HEADER_LEN +				\
 	  sizeof ( struct tcp_header ) +			\
 	  sizeof ( struct tcp_mss_option ) +			\
-	  sizeof ( struct tcp_timestamp_padded_option ) )
+	  sizeof ( struct tcp_window_scale_padded_option ) +	\
+	  sizeof ( struct tcp_sack_permitted_padded_option ) +	\
+	  sizeof ( struct tcp_timestamp_padded_option ) +	\
+	  sizeof ( struct tcp_sack_padded_option ) +		\
+	  ( TCP_SACK_MAX * sizeof ( struct tcp_sack_block ) ) )
 
 /**
  * Compare TCP sequence numbers
@@ -347,6 +445,74 @@ static inline int tcp_in_window ( uint32_t seq, uint32_t start,
 	return ( ( seq - start ) < len );
 }
 
+/** TCP congestion control state */
+struct tcp_congestion {
+	/** Congestion window (in bytes)
+	 *
+	 * Equivalent to cwnd in RFC 5681 terminology.
+	 */
+	uint32_t cwnd;
+	/** Slow start threshold (in bytes)
+	 *
+	 * Equivalent to ssthresh in RFC 5681 terminology.
+	 */
+	uint32_t ssthresh;
+	/** Congestion window prior to most recent reduction (in bytes)
+	 *
+	 * This is algorithm-specific state, and may be ignored by
+	 * algorithms that do not require it.
+	 */
+	uint32_t w_max;
+	/** Start of current congestion avoidance epoch (in ticks)
+	 *
+	 * This is algorithm-specific state, and may be ignored by
+	 * algorithms that do not require it.
+	 */
+	unsigned long epoch;
+	/** Time taken to regrow to @c w_max (in ticks)
+	 *
+	 * This is algorithm-specific state, and may be ignored by
+	 * algorithms that do not require it.
+	 */
+	unsigned long k;
+};
+
+/** A TCP congestion control algorithm */
+struct tcp_congestion_algorithm {
+	/** Name */
+	const char *name;
+	/**
+	 * Handle acknowledgement of new data
+	 *
+	 * @v cong		Congestion control state
+	 * @v acked		Length of newly acknowledged data
+	 *
+	 * This is called only while not recovering from a loss.  The
+	 * algorithm should grow the congestion window as appropriate.
+	 */
+	void ( * ack ) ( struct tcp_congestion *cong, uint32_t acked );
+	/**
+	 * Handle detection of a loss
+	 *
+	 * @v cong		Congestion control state
+	 * @v flight		Length of data in flight
+	 *
+	 * The algorithm should update the slow start threshold.  The
+	 * congestion window will subsequently be set by the caller,
+	 * as required by the type of loss detected (fast
+	 * retransmission or retransmission timeout).
+	 */
+	void ( * loss ) ( struct tcp_congestion *cong, uint32_t flight );
+};
+
+/** TCP congestion control algorithm table */
+#define TCP_CONGESTION_ALGORITHMS \
+	__table ( struct tcp_congestion_algorithm, "tcp_congestion_algorithms" )
+
+/** Declare a TCP congestion control algorithm */
+#define __tcp_congestion_algorithm \
+	__table_entry ( TCP_CONGESTION_ALGORITHMS, 01 )
+
 extern struct tcpip_protocol tcp_protocol __tcpip_protocol;
 
 #endif /* _IPXE_TCP_H */
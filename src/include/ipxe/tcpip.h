@@ -13,6 +13,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/socket.h>
 #include <ipxe/in.h>
 #include <ipxe/tables.h>
+#include <bits/tcpip.h>
 
 struct io_buffer;
 struct net_device;
@@ -87,10 +88,13 @@ struct tcpip_net_protocol {
 	 * @v st_src		Source address, or NULL to use default
 	 * @v st_dest		Destination address
 	 * @v netdev		Network device (or NULL to route automatically)
-	 * @v trans_csum	Transport-layer checksum to complete, or NULL
+	 * @v trans_csum	Transport-layer checksum to fill in, or NULL
 	 * @ret rc		Return status code
 	 *
-	 * This function takes ownership of the I/O buffer.
+	 * This function takes ownership of the I/O buffer.  The
+	 * transport-layer checksum field must be zero, and will be
+	 * filled in (or left to the network device to complete) by
+	 * calling tcpip_tx_chksum().
 	 */
 	int ( * tx ) ( struct io_buffer *iobuf,
 		       struct tcpip_protocol *tcpip_protocol,
@@ -98,6 +102,13 @@ struct tcpip_net_protocol {
 		       struct sockaddr_tcpip *st_dest,
 		       struct net_device *netdev,
 		       uint16_t *trans_csum );
+	/**
+	 * Determine transmitting network device
+	 *
+	 * @v st_dest		Destination address
+	 * @ret netdev		Network device, or NULL
+	 */
+	struct net_device * ( * netdev ) ( struct sockaddr_tcpip *st_dest );
 };
 
 /** TCP/IP transport-layer protocol table */
@@ -121,8 +132,14 @@ extern int tcpip_tx ( struct io_buffer *iobuf, struct tcpip_protocol *tcpip,
 		      struct sockaddr_tcpip *st_dest,
 		      struct net_device *netdev,
 		      uint16_t *trans_csum );
-extern uint16_t tcpip_continue_chksum ( uint16_t partial,
-					const void *data, size_t len );
+extern struct net_device * tcpip_netdev ( struct sockaddr_tcpip *st_dest );
+extern void tcpip_tx_chksum ( struct io_buffer *iobuf,
+			      struct net_device *netdev, size_t hdrlen,
+			      uint16_t *trans_csum, uint16_t pshdr_csum );
+extern uint16_t generic_tcpip_continue_chksum ( uint16_t partial,
+						const void *data, size_t len );
+extern uint16_t tcpip_copy_chksum ( uint16_t partial, void *dest,
+				    const void *src, size_t len );
 extern uint16_t tcpip_chksum ( const void *data, size_t len );
 
 #endif /* _IPXE_TCPIP_H */
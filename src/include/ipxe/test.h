@@ -37,9 +37,18 @@ extern void test_ok ( int success, const char *file, unsigned int line );
  * Report test result
  *
  * @v success		Test succeeded
+ * @v file		Test code file
+ * @v line		Test code line
  */
-#define ok( success ) do {				\
-	test_ok ( (success), __FILE__, __LINE__ );	\
+#define okx( success, file, line ) do {			\
+	test_ok ( (success), (file), (line) );		\
 	} while ( 0 )
 
+/**
+ * Report test result
+ *
+ * @v success		Test succeeded
+ */
+#define ok( success ) okx ( (success), __FILE__, __LINE__ )
+
 #endif /* _IPXE_TEST_H */
@@ -89,6 +89,12 @@ extern int xfer_deliver ( struct interface *intf,
 	typeof ( int ( object_type, struct io_buffer *iobuf,	\
 		       struct xfer_metadata *meta ) )
 
+extern int xfer_deliver_chksum ( struct interface *intf, const void *data,
+				 size_t len, uint16_t partial );
+#define xfer_deliver_chksum_TYPE( object_type )			\
+	typeof ( int ( object_type, const void *data, size_t len,	\
+		       uint16_t partial ) )
+
 /* Data transfer interface helper functions */
 
 extern int xfer_redirect ( struct interface *xfer, int type, ... );
@@ -49,6 +49,20 @@ typedef unsigned long nfds_t;
 typedef uint32_t useconds_t;
 #define MAP_FAILED ( ( void * ) -1 )
 
+struct sockaddr;
+
+/** A scatter/gather I/O vector, as used by readv() and writev()
+ *
+ * This is defined here rather than taken from <linux/uio.h>, since
+ * the host's C library headers may also define struct iovec.
+ */
+struct linux_iovec {
+	/** Start of buffer */
+	void *iov_base;
+	/** Length of buffer */
+	__kernel_size_t iov_len;
+};
+
 extern long linux_syscall ( int number, ... );
 
 extern int linux_open ( const char *pathname, int flags );
@@ -56,6 +70,10 @@ extern int linux_close ( int fd );
 extern __kernel_ssize_t linux_read ( int fd, void *buf, __kernel_size_t count );
 extern __kernel_ssize_t linux_write ( int fd, const void *buf,
 				      __kernel_size_t count );
+extern __kernel_ssize_t linux_readv ( int fd, const struct linux_iovec *iov,
+				      int iovcnt );
+extern __kernel_ssize_t linux_writev ( int fd, const struct linux_iovec *iov,
+				       int iovcnt );
 extern int linux_fcntl ( int fd, int cmd, ... );
 extern int linux_ioctl ( int fd, int request, ... );
 extern int linux_poll ( struct pollfd *fds, nfds_t nfds, int timeout );
@@ -67,6 +85,14 @@ extern void * linux_mmap ( void *addr, __kernel_size_t length, int prot,
 extern void * linux_mremap ( void *old_address, __kernel_size_t old_size,
 			     __kernel_size_t new_size, int flags );
 extern int linux_munmap ( void *addr, __kernel_size_t length );
+extern int linux_socket ( int domain, int type, int protocol );
+extern int linux_bind ( int fd, const struct sockaddr *addr, int addrlen );
+extern int linux_setsockopt ( int fd, int level, int optname,
+			      const void *optval, int optlen );
+extern __kernel_ssize_t linux_sendto ( int fd, const void *buf,
+				       __kernel_size_t len, int flags,
+				       const struct sockaddr *addr,
+				       int addrlen );
 
 extern const char * linux_strerror ( int errnum );
 
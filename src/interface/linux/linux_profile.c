@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE(GPL2_OR_LATER);
+
+#include <ipxe/init.h>
+#include <ipxe/profile.h>
+
+/** @file
+ *
+ * Profiling statistics on exit for linux
+ *
+ */
+
+/**
+ * Show profiling statistics on exit
+ *
+ * @v booting		System is shutting down for OS boot
+ */
+static void linux_profile_shutdown(int booting __unused)
+{
+	profstat();
+}
+
+/** Profiling statistics shutdown function */
+struct startup_fn linux_profile_startup_fn __startup_fn(STARTUP_LATE) = {
+	.shutdown = linux_profile_shutdown,
+};
@@ -21,11 +21,18 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <stdint.h>
 #include <string.h>
 #include <byteswap.h>
+#include <stdlib.h>
+#include <stdio.h>
 #include <errno.h>
+#include <ipxe/list.h>
+#include <ipxe/timer.h>
+#include <ipxe/retry.h>
 #include <ipxe/if_ether.h>
 #include <ipxe/if_arp.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/netdevice.h>
+#include <ipxe/malloc.h>
+#include <ipxe/init.h>
 #include <ipxe/arp.h>
 
 /** @file
@@ -40,96 +47,228 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 /** An ARP cache entry */
 struct arp_entry {
+	/** List of entries in the same hash bucket */
+	struct list_head hash;
+	/** List of all entries, most recently used first */
+	struct list_head lru;
+	/** Network device */
+	struct net_device *netdev;
 	/** Network-layer protocol */
 	struct net_protocol *net_protocol;
-	/** Link-layer protocol */
-	struct ll_protocol *ll_protocol;
 	/** Network-layer address */
 	uint8_t net_addr[MAX_NET_ADDR_LEN];
+	/** Network-layer source address for ARP requests */
+	uint8_t net_source[MAX_NET_ADDR_LEN];
 	/** Link-layer address */
 	uint8_t ll_addr[MAX_LL_ADDR_LEN];
+	/** Flags */
+	unsigned int flags;
+	/** Request retransmission, refresh and expiry timer */
+	struct retry_timer timer;
+	/** Packets awaiting resolution */
+	struct list_head tx_queue;
+	/** Number of packets awaiting resolution */
+	unsigned int tx_pending;
 };
 
-/** Number of entries in the ARP cache
+/** Link-layer address is valid */
+#define ARP_FL_VALID 0x0001
+
+/** Entry has been used since it was last confirmed */
+#define ARP_FL_USED 0x0002
+
+/** A refresh request is outstanding */
+#define ARP_FL_REFRESHING 0x0004
+
+/** Number of ARP cache hash buckets (must be a power of two) */
+#define ARP_NUM_BUCKETS 32
+
+/** Maximum number of entries in the ARP cache
+ *
+ * This is a global limit, covering all network interfaces and
+ * network-layer protocols.
+ */
+#define ARP_MAX_ENTRIES 64
+
+/** Maximum number of packets queued awaiting resolution, per entry */
+#define ARP_MAX_PENDING 16
+
+/** Minimum ARP request retransmission timeout */
+#define ARP_MIN_TIMEOUT ( TICKS_PER_SEC / 8 )
+
+/** Maximum ARP request retransmission timeout
  *
- * This is a global cache, covering all network interfaces,
- * network-layer protocols and link-layer protocols.
+ * Resolution fails once the retransmission timeout would exceed this
+ * value.
  */
-#define NUM_ARP_ENTRIES 4
+#define ARP_MAX_TIMEOUT ( 3 * TICKS_PER_SEC )
 
-/** The ARP cache */
-static struct arp_entry arp_table[NUM_ARP_ENTRIES];
-#define arp_table_end &arp_table[NUM_ARP_ENTRIES]
+/** Interval after which a valid entry is refreshed (if in use) */
+#define ARP_REFRESH_INTERVAL ( 60 * TICKS_PER_SEC )
 
-static unsigned int next_new_arp_entry = 0;
+/** Time allowed for a refresh request to be answered */
+#define ARP_REFRESH_TIMEOUT ( 3 * TICKS_PER_SEC )
+
+/** ARP cache hash buckets */
+static struct list_head arp_buckets[ARP_NUM_BUCKETS];
+
+/** ARP cache entries, most recently used first */
+static LIST_HEAD ( arp_entries );
+
+/** Number of ARP cache entries */
+static unsigned int arp_count;
 
 struct net_protocol arp_protocol __net_protocol;
 
+static void arp_expired ( struct retry_timer *timer, int over );
+
+/**
+ * Calculate ARP cache hash bucket
+ *
+ * @v net_protocol	Network-layer protocol
+ * @v net_addr		Network-layer address
+ * @ret bucket		Hash bucket
+ */
+static struct list_head * arp_bucket ( struct net_protocol *net_protocol,
+				       const void *net_addr ) {
+	const uint8_t *bytes = net_addr;
+	unsigned int hash = 0;
+	unsigned int i;
+
+	for ( i = 0 ; i < net_protocol->net_addr_len ; i++ )
+		hash = ( ( hash * 31 ) + bytes[i] );
+	hash ^= ( hash >> 16 );
+	hash ^= ( hash >> 8 );
+	return &arp_buckets[ hash & ( ARP_NUM_BUCKETS - 1 ) ];
+}
+
 /**
  * Find entry in the ARP cache
  *
- * @v ll_protocol	Link-layer protocol
+ * @v netdev		Network device
  * @v net_protocol	Network-layer protocol
  * @v net_addr		Network-layer address
  * @ret arp		ARP cache entry, or NULL if not found
  *
  */
-static struct arp_entry *
-arp_find_entry ( struct ll_protocol *ll_protocol,
-		 struct net_protocol *net_protocol,
-		 const void *net_addr ) {
+static struct arp_entry * arp_find_entry ( struct net_device *netdev,
+					   struct net_protocol *net_protocol,
+					   const void *net_addr ) {
+	struct list_head *bucket;
 	struct arp_entry *arp;
 
-	for ( arp = arp_table ; arp < arp_table_end ; arp++ ) {
-		if ( ( arp->ll_protocol == ll_protocol ) &&
+	bucket = arp_bucket ( net_protocol, net_addr );
+	list_for_each_entry ( arp, bucket, hash ) {
+		if ( ( arp->netdev == netdev ) &&
 		     ( arp->net_protocol == net_protocol ) &&
 		     ( memcmp ( arp->net_addr, net_addr,
-				net_protocol->net_addr_len ) == 0 ) )
+				net_protocol->net_addr_len ) == 0 ) ) {
+			/* Move to front of LRU list */
+			list_del ( &arp->lru );
+			list_add ( &arp->lru, &arp_entries );
 			return arp;
+		}
 	}
 	return NULL;
 }
 
 /**
- * Look up media-specific link-layer address in the ARP cache
+ * Discard packets awaiting resolution
+ *
+ * @v arp		ARP cache entry
+ * @v rc		Reason for discarding
+ */
+static void arp_discard_pending ( struct arp_entry *arp, int rc ) {
+	struct io_buffer *iobuf;
+	struct io_buffer *tmp;
+
+	list_for_each_entry_safe ( iobuf, tmp, &arp->tx_queue, list ) {
+		list_del ( &iobuf->list );
+		netdev_tx_err ( arp->netdev, iobuf, rc );
+	}
+	arp->tx_pending = 0;
+}
+
+/**
+ * Destroy ARP cache entry
+ *
+ * @v arp		ARP cache entry
+ * @v rc		Reason for destruction
+ */
+static void arp_destroy ( struct arp_entry *arp, int rc ) {
+	struct net_protocol *net_protocol = arp->net_protocol;
+
+	DBGC ( arp, "ARP %p destroyed: %s %s: %s\n", arp, net_protocol->name,
+	       net_protocol->ntoa ( arp->net_addr ), strerror ( rc ) );
+
+	stop_timer ( &arp->timer );
+	arp_discard_pending ( arp, rc );
+	list_del ( &arp->hash );
+	list_del ( &arp->lru );
+	arp_count--;
+	netdev_put ( arp->netdev );
+	free ( arp );
+}
+
+/**
+ * Create ARP cache entry
  *
  * @v netdev		Network device
  * @v net_protocol	Network-layer protocol
- * @v dest_net_addr	Destination network-layer address
- * @v source_net_addr	Source network-layer address
- * @ret dest_ll_addr	Destination link layer address
- * @ret rc		Return status code
+ * @v net_addr		Network-layer address
+ * @ret arp		ARP cache entry, or NULL on allocation failure
  *
- * This function will use the ARP cache to look up the link-layer
- * address for the link-layer protocol associated with the network
- * device and the given network-layer protocol and addresses.  If
- * found, the destination link-layer address will be filled in in @c
- * dest_ll_addr.
+ * The least recently used entry is evicted if the cache is full.
+ */
+static struct arp_entry * arp_create ( struct net_device *netdev,
+				       struct net_protocol *net_protocol,
+				       const void *net_addr ) {
+	struct list_head *bucket;
+	struct arp_entry *arp;
+
+	/* Evict least recently used entry, if necessary */
+	if ( arp_count >= ARP_MAX_ENTRIES ) {
+		arp = list_last_entry ( &arp_entries, struct arp_entry, lru );
+		arp_destroy ( arp, -ENOBUFS );
+	}
+
+	/* Allocate and initialise entry */
+	arp = zalloc ( sizeof ( *arp ) );
+	if ( ! arp )
+		return NULL;
+	arp->netdev = netdev_get ( netdev );
+	arp->net_protocol = net_protocol;
+	memcpy ( arp->net_addr, net_addr, net_protocol->net_addr_len );
+	timer_init ( &arp->timer, arp_expired, NULL );
+	arp->timer.min_timeout = ARP_MIN_TIMEOUT;
+	arp->timer.max_timeout = ARP_MAX_TIMEOUT;
+	INIT_LIST_HEAD ( &arp->tx_queue );
+
+	/* Add to cache */
+	bucket = arp_bucket ( net_protocol, net_addr );
+	list_add ( &arp->hash, bucket );
+	list_add ( &arp->lru, &arp_entries );
+	arp_count++;
+
+	return arp;
+}
+
+/**
+ * Transmit ARP request
  *
- * If no address is found in the ARP cache, an ARP request will be
- * transmitted on the specified network device and -ENOENT will be
- * returned.
+ * @v arp		ARP cache entry
+ * @v ll_dest		Destination link-layer address
+ * @ret rc		Return status code
  */
-int arp_resolve ( struct net_device *netdev, struct net_protocol *net_protocol,
-		  const void *dest_net_addr, const void *source_net_addr,
-		  void *dest_ll_addr ) {
+static int arp_tx_request ( struct arp_entry *arp, const void *ll_dest ) {
+	struct net_device *netdev = arp->netdev;
+	struct net_protocol *net_protocol = arp->net_protocol;
 	struct ll_protocol *ll_protocol = netdev->ll_protocol;
-	const struct arp_entry *arp;
 	struct io_buffer *iobuf;
 	struct arphdr *arphdr;
-	int rc;
 
-	/* Look for existing entry in ARP table */
-	arp = arp_find_entry ( ll_protocol, net_protocol, dest_net_addr );
-	if ( arp ) {
-		DBG ( "ARP cache hit: %s %s => %s %s\n",
-		      net_protocol->name, net_protocol->ntoa ( arp->net_addr ),
-		      ll_protocol->name, ll_protocol->ntoa ( arp->ll_addr ) );
-		memcpy ( dest_ll_addr, arp->ll_addr, ll_protocol->ll_addr_len);
-		return 0;
-	}
-	DBG ( "ARP cache miss: %s %s\n", net_protocol->name,
-	      net_protocol->ntoa ( dest_net_addr ) );
+	DBGC2 ( arp, "ARP %p requesting %s %s\n", arp, net_protocol->name,
+		net_protocol->ntoa ( arp->net_addr ) );
 
 	/* Allocate ARP packet */
 	iobuf = alloc_iob ( MAX_LL_HEADER_LEN + sizeof ( *arphdr ) +
@@ -148,18 +287,166 @@ int arp_resolve ( struct net_device *netdev, struct net_protocol *net_protocol,
 	memcpy ( iob_put ( iobuf, ll_protocol->ll_addr_len ),
 		 netdev->ll_addr, ll_protocol->ll_addr_len );
 	memcpy ( iob_put ( iobuf, net_protocol->net_addr_len ),
-		 source_net_addr, net_protocol->net_addr_len );
+		 arp->net_source, net_protocol->net_addr_len );
 	memset ( iob_put ( iobuf, ll_protocol->ll_addr_len ),
 		 0, ll_protocol->ll_addr_len );
 	memcpy ( iob_put ( iobuf, net_protocol->net_addr_len ),
-		 dest_net_addr, net_protocol->net_addr_len );
+		 arp->net_addr, net_protocol->net_addr_len );
 
 	/* Transmit ARP request */
-	if ( ( rc = net_tx ( iobuf, netdev, &arp_protocol,
-			     netdev->ll_broadcast, netdev->ll_addr ) ) != 0 )
-		return rc;
+	return net_tx ( iobuf, netdev, &arp_protocol, ll_dest,
+			netdev->ll_addr );
+}
+
+/**
+ * Handle ARP cache entry timer expiry
+ *
+ * @v timer		Retry timer
+ * @v over		Failure indicator
+ */
+static void arp_expired ( struct retry_timer *timer, int over ) {
+	struct arp_entry *arp =
+		container_of ( timer, struct arp_entry, timer );
+
+	if ( ! ( arp->flags & ARP_FL_VALID ) ) {
+
+		/* Resolution in progress: fail, or retransmit request */
+		if ( over ) {
+			arp_destroy ( arp, -ETIMEDOUT );
+			return;
+		}
+		start_timer ( &arp->timer );
+		arp_tx_request ( arp, arp->netdev->ll_broadcast );
+
+	} else if ( arp->flags & ARP_FL_REFRESHING ) {
+
+		/* Refresh request went unanswered: entry is stale */
+		arp_destroy ( arp, -ETIMEDOUT );
+
+	} else if ( arp->flags & ARP_FL_USED ) {
+
+		/* Entry is in use: refresh it before it goes stale,
+		 * by asking the current owner directly (RFC1122
+		 * section 2.3.2.1).  The cached address continues to
+		 * be used in the meantime.
+		 */
+		arp->flags |= ARP_FL_REFRESHING;
+		start_timer_fixed ( &arp->timer, ARP_REFRESH_TIMEOUT );
+		arp_tx_request ( arp, arp->ll_addr );
+
+	} else {
+
+		/* Entry is unused: let it go */
+		arp_destroy ( arp, -ETIMEDOUT );
+	}
+}
+
+/**
+ * Record link-layer address for ARP cache entry
+ *
+ * @v arp		ARP cache entry
+ * @v ll_addr		Link-layer address
+ */
+static void arp_update ( struct arp_entry *arp, const void *ll_addr ) {
+	struct net_device *netdev = arp->netdev;
+	struct net_protocol *net_protocol = arp->net_protocol;
+	struct ll_protocol *ll_protocol = netdev->ll_protocol;
+	struct io_buffer *iobuf;
+	struct io_buffer *tmp;
+
+	/* Record address and (re)start refresh timer */
+	memcpy ( arp->ll_addr, ll_addr, ll_protocol->ll_addr_len );
+	arp->flags = ARP_FL_VALID;
+	stop_timer ( &arp->timer );
+	start_timer_fixed ( &arp->timer, ARP_REFRESH_INTERVAL );
+	DBGC ( arp, "ARP %p cache update: %s %s => %s %s\n", arp,
+	       net_protocol->name, net_protocol->ntoa ( arp->net_addr ),
+	       ll_protocol->name, ll_protocol->ntoa ( arp->ll_addr ) );
+
+	/* Transmit any packets awaiting resolution */
+	list_for_each_entry_safe ( iobuf, tmp, &arp->tx_queue, list ) {
+		DBGC2 ( arp, "ARP %p transmitting deferred packet %p\n",
+			arp, iobuf );
+		list_del ( &iobuf->list );
+		arp->tx_pending--;
+		net_tx ( iobuf, netdev, net_protocol, arp->ll_addr,
+			 netdev->ll_addr );
+	}
+}
+
+/**
+ * Transmit packet, resolving link-layer address via ARP
+ *
+ * @v iobuf		I/O buffer
+ * @v netdev		Network device
+ * @v net_protocol	Network-layer protocol
+ * @v net_dest		Destination network-layer address
+ * @v net_source	Source network-layer address
+ * @ret rc		Return status code
+ *
+ * If the destination link-layer address is found in the ARP cache,
+ * the packet is transmitted immediately.  Otherwise, an ARP request
+ * is transmitted and the packet is queued until the address is
+ * resolved (or resolution fails).  This function takes ownership of
+ * the I/O buffer.
+ */
+int arp_tx ( struct io_buffer *iobuf, struct net_device *netdev,
+	     struct net_protocol *net_protocol, const void *net_dest,
+	     const void *net_source ) {
+	struct ll_protocol *ll_protocol = netdev->ll_protocol;
+	struct arp_entry *arp;
+	int rc;
+
+	/* Look for existing entry in ARP table */
+	arp = arp_find_entry ( netdev, net_protocol, net_dest );
+	if ( arp ) {
+		memcpy ( arp->net_source, net_source,
+			 net_protocol->net_addr_len );
+	}
+	if ( arp && ( arp->flags & ARP_FL_VALID ) ) {
+		DBGC2 ( arp, "ARP %p cache hit: %s %s => %s %s\n", arp,
+			net_protocol->name, net_protocol->ntoa ( arp->net_addr ),
+			ll_protocol->name, ll_protocol->ntoa ( arp->ll_addr ) );
+		arp->flags |= ARP_FL_USED;
+		return net_tx ( iobuf, netdev, net_protocol, arp->ll_addr,
+				netdev->ll_addr );
+	}
+
+	/* Create new entry and start resolution, if necessary */
+	if ( ! arp ) {
+		arp = arp_create ( netdev, net_protocol, net_dest );
+		if ( ! arp ) {
+			rc = -ENOMEM;
+			goto err;
+		}
+		DBGC ( arp, "ARP %p cache miss: %s %s\n", arp,
+		       net_protocol->name, net_protocol->ntoa ( net_dest ) );
+		memcpy ( arp->net_source, net_source,
+			 net_protocol->net_addr_len );
+		start_timer ( &arp->timer );
+		if ( ( rc = arp_tx_request ( arp, netdev->ll_broadcast ) ) != 0 ){
+			/* Leave entry in place; the request will be
+			 * retransmitted when the timer expires.
+			 */
+			DBGC ( arp, "ARP %p could not transmit request: %s\n",
+			       arp, strerror ( rc ) );
+		}
+	}
+
+	/* Queue packet until resolution completes */
+	if ( arp->tx_pending >= ARP_MAX_PENDING ) {
+		DBGC ( arp, "ARP %p too many deferred packets\n", arp );
+		rc = -ENOBUFS;
+		goto err;
+	}
+	list_add_tail ( &iobuf->list, &arp->tx_queue );
+	arp->tx_pending++;
 
-	return -ENOENT;
+	return 0;
+
+ err:
+	netdev_tx_err ( netdev, iobuf, rc );
+	return rc;
 }
 
 /**
@@ -204,7 +491,11 @@ static int arp_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 	struct net_protocol *net_protocol;
 	struct ll_protocol *ll_protocol;
 	struct arp_entry *arp;
-	int merge = 0;
+	uint8_t *sender_pa;
+	uint8_t *target_pa;
+	unsigned int i;
+	int probe;
+	int gratuitous;
 
 	/* Identify network-layer and link-layer protocols */
 	arp_net_protocol = arp_find_protocol ( arphdr->ar_pro );
@@ -219,34 +510,46 @@ static int arp_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 	     ( arphdr->ar_pln != net_protocol->net_addr_len ) )
 		goto done;
 
+	/* Identify probes from hosts that have no address yet, and
+	 * gratuitous announcements in which the sender announces its
+	 * own address as the target.
+	 */
+	sender_pa = arp_sender_pa ( arphdr );
+	target_pa = arp_target_pa ( arphdr );
+	for ( i = 0 ; i < arphdr->ar_pln ; i++ ) {
+		if ( sender_pa[i] )
+			break;
+	}
+	probe = ( i == arphdr->ar_pln );
+	gratuitous = ( memcmp ( sender_pa, target_pa,
+				arphdr->ar_pln ) == 0 );
+
 	/* See if we have an entry for this sender, and update it if so */
-	arp = arp_find_entry ( ll_protocol, net_protocol,
-			       arp_sender_pa ( arphdr ) );
-	if ( arp ) {
-		memcpy ( arp->ll_addr, arp_sender_ha ( arphdr ),
-			 arphdr->ar_hln );
-		merge = 1;
-		DBG ( "ARP cache update: %s %s => %s %s\n",
-		      net_protocol->name, net_protocol->ntoa ( arp->net_addr ),
-		      ll_protocol->name, ll_protocol->ntoa ( arp->ll_addr ) );
+	arp = ( probe ? NULL :
+		arp_find_entry ( netdev, net_protocol, sender_pa ) );
+	if ( arp )
+		arp_update ( arp, arp_sender_ha ( arphdr ) );
+
+	/* Learn from gratuitous announcements */
+	if ( gratuitous ) {
+		if ( ( ! probe ) && ( ! arp ) &&
+		     ( ( arp = arp_create ( netdev, net_protocol,
+					    sender_pa ) ) != NULL ) ) {
+			arp_update ( arp, arp_sender_ha ( arphdr ) );
+		}
+		goto done;
 	}
 
 	/* See if we own the target protocol address */
-	if ( arp_net_protocol->check ( netdev, arp_target_pa ( arphdr ) ) != 0)
+	if ( arp_net_protocol->check ( netdev, target_pa ) != 0 )
 		goto done;
-	
+
 	/* Create new ARP table entry if necessary */
-	if ( ! merge ) {
-		arp = &arp_table[next_new_arp_entry++ % NUM_ARP_ENTRIES];
-		arp->ll_protocol = ll_protocol;
-		arp->net_protocol = net_protocol;
-		memcpy ( arp->ll_addr, arp_sender_ha ( arphdr ),
-			 arphdr->ar_hln );
-		memcpy ( arp->net_addr, arp_sender_pa ( arphdr ),
-			 arphdr->ar_pln);
-		DBG ( "ARP cache add: %s %s => %s %s\n",
-		      net_protocol->name, net_protocol->ntoa ( arp->net_addr ),
-		      ll_protocol->name, ll_protocol->ntoa ( arp->ll_addr ) );
+	if ( ( ! probe ) && ( ! arp ) &&
+	     ( ( arp = arp_create ( netdev, net_protocol,
+				    sender_pa ) ) != NULL ) ) {
+		memcpy ( arp->net_source, target_pa, arphdr->ar_pln );
+		arp_update ( arp, arp_sender_ha ( arphdr ) );
 	}
 
 	/* If it's not a request, there's nothing more to do */
@@ -271,6 +574,98 @@ static int arp_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 	return 0;
 }
 
+/**
+ * Discard some cached ARP entries
+ *
+ * @ret discarded	Number of cached items discarded
+ *
+ * Entries that are being resolved or refreshed are never discarded,
+ * since the discarder may be called (via malloc()) while such an
+ * entry is transmitting an ARP request.
+ */
+static unsigned int arp_discard ( void ) {
+	struct arp_entry *arp;
+
+	/* Drop least recently used idle entry */
+	list_for_each_entry_reverse ( arp, &arp_entries, lru ) {
+		if ( ( arp->flags & ( ARP_FL_VALID | ARP_FL_REFRESHING ) ) !=
+		     ARP_FL_VALID )
+			continue;
+		if ( arp->tx_pending )
+			continue;
+		arp_destroy ( arp, -ENOBUFS );
+		return 1;
+	}
+
+	return 0;
+}
+
+/** ARP cache discarder */
+struct cache_discarder arp_cache_discarder __cache_discarder = {
+	.discard = arp_discard,
+};
+
+/**
+ * Destroy all ARP cache entries for a network device
+ *
+ * @v netdev		Network device
+ */
+static void arp_flush ( struct net_device *netdev ) {
+	struct arp_entry *arp;
+	struct arp_entry *tmp;
+
+	list_for_each_entry_safe ( arp, tmp, &arp_entries, lru ) {
+		if ( arp->netdev == netdev )
+			arp_destroy ( arp, -ENODEV );
+	}
+}
+
+/**
+ * Handle network device or link state change
+ *
+ * @v netdev		Network device
+ */
+static void arp_notify ( struct net_device *netdev ) {
+
+	/* Discard all entries (and deferred packets) when the
+	 * device is closed.
+	 */
+	if ( ! netdev_is_open ( netdev ) )
+		arp_flush ( netdev );
+}
+
+/**
+ * Remove ARP cache for a network device
+ *
+ * @v netdev		Network device
+ */
+static void arp_remove ( struct net_device *netdev ) {
+	arp_flush ( netdev );
+}
+
+/** ARP cache network driver */
+struct net_driver arp_driver __net_driver = {
+	.name = "ARP",
+	.notify = arp_notify,
+	.remove = arp_remove,
+};
+
+/**
+ * Initialise ARP cache
+ *
+ */
+static void arp_init ( void ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < ARP_NUM_BUCKETS ; i++ )
+		INIT_LIST_HEAD ( &arp_buckets[i] );
+}
+
+/** ARP cache initialisation function */
+struct init_fn arp_init_fn __init_fn ( INIT_EARLY ) = {
+	.initialise = arp_init,
+};
+
 /**
  * Transcribe ARP address
  *
@@ -723,7 +723,8 @@ static struct interface_descriptor fcpcmd_xchg_desc =
 
 /** FCP command process descriptor */
 static struct process_descriptor fcpcmd_process_desc =
-	PROC_DESC ( struct fcp_command, process, fcpcmd_step );
+	PROC_DESC_CLASS ( struct fcp_command, process, fcpcmd_step,
+			  PROC_CLASS_TX );
 
 /**
  * Issue FCP SCSI command
@@ -42,9 +42,8 @@ int icmp6_send_solicit ( struct net_device *netdev, struct in6_addr *src __unuse
 	nsolicit->opt_len = ( 2 + ll_protocol->ll_addr_len ) / 8;
 	memcpy ( nsolicit->opt_ll_addr, netdev->ll_addr,
 				netdev->ll_protocol->ll_addr_len );
-	/* Partial checksum */
+	/* Checksum is filled in by the network layer */
 	nsolicit->csum = 0;
-	nsolicit->csum = tcpip_chksum ( nsolicit, sizeof ( *nsolicit ) );
 
 	/* Solicited multicast address */
 	st_dest.sin6.sin_family = AF_INET6;
@@ -867,7 +867,7 @@ static void ib_step ( struct process *process __unused ) {
 }
 
 /** Infiniband event queue process */
-PERMANENT_PROCESS ( ib_process, ib_step );
+PERMANENT_PROCESS_CLASS ( ib_process, ib_step, PROC_CLASS_RX );
 
 /***************************************************************************
  *
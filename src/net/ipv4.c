@@ -15,6 +15,7 @@
 #include <ipxe/dhcp.h>
 #include <ipxe/settings.h>
 #include <ipxe/timer.h>
+#include <ipxe/profile.h>
 
 /** @file
  *
@@ -33,6 +34,12 @@ struct list_head ipv4_miniroutes = LIST_HEAD_INIT ( ipv4_miniroutes );
 /** List of fragment reassembly buffers */
 static LIST_HEAD ( ipv4_fragments );
 
+/** IPv4 receive profiler
+ *
+ * This excludes the time spent in the transport layer.
+ */
+static struct profiler ipv4_rx_profiler __profiler = { .name = "ipv4.rx" };
+
 /** Fragment reassembly timeout */
 #define IP_FRAG_TIMEOUT ( TICKS_PER_SEC / 2 )
 
@@ -285,17 +292,18 @@ static uint16_t ipv4_pshdr_chksum ( struct io_buffer *iobuf, uint16_t csum ) {
  * Determine link-layer address
  *
  * @v dest		IPv4 destination address
- * @v src		IPv4 source address
  * @v netmask		IPv4 subnet mask
  * @v netdev		Network device
  * @v ll_dest		Link-layer destination address buffer
+ * @ret unicast		Destination is unicast (and must be resolved via ARP)
  * @ret rc		Return status code
  */
-static int ipv4_ll_addr ( struct in_addr dest, struct in_addr src,
-			  struct in_addr netmask, struct net_device *netdev,
-			  uint8_t *ll_dest ) {
+static int ipv4_ll_addr ( struct in_addr dest, struct in_addr netmask,
+			  struct net_device *netdev, uint8_t *ll_dest,
+			  int *unicast ) {
 	struct ll_protocol *ll_protocol = netdev->ll_protocol;
 
+	*unicast = 0;
 	if ( ( ( dest.s_addr ^ INADDR_BROADCAST ) & ~netmask.s_addr ) == 0 ) {
 		/* Broadcast address */
 		memcpy ( ll_dest, netdev->ll_broadcast,
@@ -304,9 +312,9 @@ static int ipv4_ll_addr ( struct in_addr dest, struct in_addr src,
 	} else if ( IN_MULTICAST ( ntohl ( dest.s_addr ) ) ) {
 		return ll_protocol->mc_hash ( AF_INET, &dest, ll_dest );
 	} else {
-		/* Unicast address: resolve via ARP */
-		return arp_resolve ( netdev, &ipv4_protocol, &dest,
-				     &src, ll_dest );
+		/* Unicast address: resolved via ARP on transmission */
+		*unicast = 1;
+		return 0;
 	}
 }
 
@@ -318,7 +326,7 @@ static int ipv4_ll_addr ( struct in_addr dest, struct in_addr src,
  * @v st_src		Source network-layer address
  * @v st_dest		Destination network-layer address
  * @v netdev		Network device to use if no route found, or NULL
- * @v trans_csum	Transport-layer checksum to complete, or NULL
+ * @v trans_csum	Transport-layer checksum to fill in, or NULL
  * @ret rc		Status
  *
  * This function expects a transport-layer segment and prepends the IP header
@@ -336,6 +344,7 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 	struct in_addr next_hop;
 	struct in_addr netmask = { .s_addr = 0 };
 	uint8_t ll_dest[MAX_LL_ADDR_LEN];
+	int unicast;
 	int rc;
 
 	/* Fill up the IP header, except source address */
@@ -374,8 +383,8 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 			       ( ( netdev->rx_stats.good & 0xf ) << 0 ) );
 
 	/* Determine link-layer destination address */
-	if ( ( rc = ipv4_ll_addr ( next_hop, iphdr->src, netmask, netdev,
-				   ll_dest ) ) != 0 ) {
+	if ( ( rc = ipv4_ll_addr ( next_hop, netmask, netdev, ll_dest,
+				   &unicast ) ) != 0 ) {
 		DBGC ( sin_dest->sin_addr, "IPv4 has no link-layer address for "
 		       "%s: %s\n", inet_ntoa ( next_hop ), strerror ( rc ) );
 		/* Record error for diagnosis */
@@ -384,8 +393,11 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 	}
 
 	/* Fix up checksums */
-	if ( trans_csum )
-		*trans_csum = ipv4_pshdr_chksum ( iobuf, *trans_csum );
+	if ( trans_csum ) {
+		tcpip_tx_chksum ( iobuf, netdev, sizeof ( *iphdr ), trans_csum,
+				  ipv4_pshdr_chksum ( iobuf,
+						      TCPIP_EMPTY_CSUM ) );
+	}
 	iphdr->chksum = tcpip_chksum ( iphdr, sizeof ( *iphdr ) );
 
 	/* Print IP4 header for debugging */
@@ -395,9 +407,15 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 		iphdr->protocol, ntohs ( iphdr->ident ),
 		ntohs ( iphdr->chksum ) );
 
-	/* Hand off to link layer */
-	if ( ( rc = net_tx ( iobuf, netdev, &ipv4_protocol, ll_dest,
-			     netdev->ll_addr ) ) != 0 ) {
+	/* Hand off to link layer (via ARP, for unicast destinations) */
+	if ( unicast ) {
+		rc = arp_tx ( iobuf, netdev, &ipv4_protocol, &next_hop,
+			      &iphdr->src );
+	} else {
+		rc = net_tx ( iobuf, netdev, &ipv4_protocol, ll_dest,
+			      netdev->ll_addr );
+	}
+	if ( rc != 0 ) {
 		DBGC ( sin_dest->sin_addr, "IPv4 could not transmit packet "
 		       "via %s: %s\n", netdev->name, strerror ( rc ) );
 		return rc;
@@ -410,6 +428,27 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 	return rc;
 }
 
+/**
+ * Determine transmitting network device
+ *
+ * @v st_dest		Destination network-layer address
+ * @ret netdev		Transmitting network device, or NULL
+ */
+static struct net_device * ipv4_netdev ( struct sockaddr_tcpip *st_dest ) {
+	struct sockaddr_in *sin_dest = ( ( struct sockaddr_in * ) st_dest );
+	struct in_addr dest = sin_dest->sin_addr;
+	struct ipv4_miniroute *miniroute;
+
+	/* Broadcast and multicast destinations are not routed */
+	if ( ( dest.s_addr == INADDR_BROADCAST ) ||
+	     IN_MULTICAST ( ntohl ( dest.s_addr ) ) )
+		return NULL;
+
+	/* Use routing table to identify transmitting netdev */
+	miniroute = ipv4_route ( &dest );
+	return ( miniroute ? miniroute->netdev : NULL );
+}
+
 /**
  * Check if network device has any IPv4 address
  *
@@ -475,6 +514,8 @@ static int ipv4_rx ( struct io_buffer *iobuf,
 	uint16_t pshdr_csum;
 	int rc;
 
+	profile_start ( &ipv4_rx_profiler );
+
 	/* Sanity check the IPv4 header */
 	if ( iob_len ( iobuf ) < sizeof ( *iphdr ) ) {
 		DBGC ( iphdr->src, "IPv4 packet too short at %zd bytes (min "
@@ -497,7 +538,8 @@ static int ipv4_rx ( struct io_buffer *iobuf,
 		       "(packet is %zd bytes)\n", hdrlen, iob_len ( iobuf ) );
 		goto err;
 	}
-	if ( ( csum = tcpip_chksum ( iphdr, hdrlen ) ) != 0 ) {
+	if ( ( ! ( iobuf->flags & IOB_IP_CSUM_VERIFIED ) ) &&
+	     ( ( csum = tcpip_chksum ( iphdr, hdrlen ) ) != 0 ) ) {
 		DBGC ( iphdr->src, "IPv4 checksum incorrect (is %04x "
 		       "including checksum field, should be 0000)\n", csum );
 		goto err;
@@ -538,8 +580,10 @@ static int ipv4_rx ( struct io_buffer *iobuf,
 		 * either a fully reassembled I/O buffer or NULL.
 		 */
 		iobuf = ipv4_reassemble ( iobuf );
-		if ( ! iobuf )
+		if ( ! iobuf ) {
+			profile_stop ( &ipv4_rx_profiler );
 			return 0;
+		}
 		iphdr = iobuf->data;
 		hdrlen = ( ( iphdr->verhdrlen & IP_MASK_HLEN ) * 4 );
 	}
@@ -555,6 +599,7 @@ static int ipv4_rx ( struct io_buffer *iobuf,
 	dest.sin.sin_addr = iphdr->dest;
 	pshdr_csum = ipv4_pshdr_chksum ( iobuf, TCPIP_EMPTY_CSUM );
 	iob_pull ( iobuf, hdrlen );
+	profile_stop ( &ipv4_rx_profiler );
 	if ( ( rc = tcpip_rx ( iobuf, iphdr->protocol, &src.st,
 			       &dest.st, pshdr_csum ) ) != 0 ) {
 		DBGC ( src.sin.sin_addr, "IPv4 received packet rejected by "
@@ -566,6 +611,7 @@ static int ipv4_rx ( struct io_buffer *iobuf,
 
  err:
 	free_iob ( iobuf );
+	profile_stop ( &ipv4_rx_profiler );
 	return -EINVAL;
 }
 
@@ -624,6 +670,7 @@ struct tcpip_net_protocol ipv4_tcpip_protocol __tcpip_net_protocol = {
 	.name = "IPv4",
 	.sa_family = AF_INET,
 	.tx = ipv4_tx,
+	.netdev = ipv4_netdev,
 };
 
 /** IPv4 ARP protocol */
@@ -218,8 +218,10 @@ static int ipv6_tx ( struct io_buffer *iobuf,
 	}
 
 	/* Complete the transport layer checksum */
-	if ( trans_csum )
-		*trans_csum = ipv6_tx_csum ( iobuf, *trans_csum );
+	if ( trans_csum ) {
+		tcpip_tx_chksum ( iobuf, netdev, sizeof ( *ip6hdr ), trans_csum,
+				  ipv6_tx_csum ( iobuf, TCPIP_EMPTY_CSUM ) );
+	}
 
 	/* Print IPv6 header */
 	ipv6_dump ( ip6hdr );
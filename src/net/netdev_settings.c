@@ -19,6 +19,7 @@
 FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 #include <byteswap.h>
 #include <ipxe/dhcp.h>
@@ -26,6 +27,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/settings.h>
 #include <ipxe/device.h>
 #include <ipxe/netdevice.h>
+#include <config/general.h>
 
 /** @file
  *
@@ -46,6 +48,18 @@ struct setting busid_setting __setting ( SETTING_NETDEV ) = {
 	.type = &setting_type_hex,
 	.tag = NETDEV_SETTING_TAG_BUS_ID,
 };
+struct setting rx_ring_setting __setting ( SETTING_NETDEV ) = {
+	.name = "rx-ring",
+	.description = "Receive ring size",
+	.type = &setting_type_uint16,
+	.tag = DHCP_EB_RX_RING,
+};
+struct setting tx_ring_setting __setting ( SETTING_NETDEV ) = {
+	.name = "tx-ring",
+	.description = "Transmit ring size",
+	.type = &setting_type_uint16,
+	.tag = DHCP_EB_TX_RING,
+};
 
 /**
  * Check applicability of network device setting
@@ -138,3 +152,65 @@ struct settings_operations netdev_settings_operations = {
 	.fetch = netdev_fetch,
 	.clear = netdev_clear,
 };
+
+/**
+ * Get network device descriptor ring size
+ *
+ * @v netdev		Network device
+ * @v setting		Ring size setting
+ * @v default_size	Default ring size
+ * @v min		Minimum ring size supported by the device
+ * @v max		Maximum ring size supported by the device
+ * @ret size		Ring size
+ *
+ * The ring size is always a power of two.  @c min and @c max must
+ * also be powers of two.
+ */
+static unsigned int netdev_ring_size ( struct net_device *netdev,
+				       struct setting *setting,
+				       unsigned int default_size,
+				       unsigned int min, unsigned int max ) {
+	unsigned long size;
+
+	/* Use configured ring size, if any */
+	if ( fetch_uint_setting ( netdev_settings ( netdev ), setting,
+				  &size ) <= 0 )
+		size = default_size;
+
+	/* Clamp to supported range and round down to a power of two */
+	if ( size < min )
+		size = min;
+	if ( size > max )
+		size = max;
+	size = ( 1UL << ( flsl ( size ) - 1 ) );
+
+	return size;
+}
+
+/**
+ * Get network device receive ring size
+ *
+ * @v netdev		Network device
+ * @v min		Minimum ring size supported by the device
+ * @v max		Maximum ring size supported by the device
+ * @ret size		Ring size
+ */
+unsigned int netdev_rx_ring_size ( struct net_device *netdev,
+				   unsigned int min, unsigned int max ) {
+	return netdev_ring_size ( netdev, &rx_ring_setting, NETDEV_RX_RING,
+				  min, max );
+}
+
+/**
+ * Get network device transmit ring size
+ *
+ * @v netdev		Network device
+ * @v min		Minimum ring size supported by the device
+ * @v max		Maximum ring size supported by the device
+ * @ret size		Ring size
+ */
+unsigned int netdev_tx_ring_size ( struct net_device *netdev,
+				   unsigned int min, unsigned int max ) {
+	return netdev_ring_size ( netdev, &tx_ring_setting, NETDEV_TX_RING,
+				  min, max );
+}
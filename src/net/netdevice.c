@@ -32,6 +32,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/init.h>
 #include <ipxe/device.h>
 #include <ipxe/errortab.h>
+#include <ipxe/profile.h>
 #include <ipxe/netdevice.h>
 
 /** @file
@@ -46,6 +47,17 @@ struct list_head net_devices = LIST_HEAD_INIT ( net_devices );
 /** List of open network devices, in reverse order of opening */
 static struct list_head open_net_devices = LIST_HEAD_INIT ( open_net_devices );
 
+static void net_step ( struct process *process );
+
+/** Networking stack process */
+PERMANENT_PROCESS_CLASS ( net_process, net_step, PROC_CLASS_RX );
+
+/** Network polling profiler */
+static struct profiler net_poll_profiler __profiler = { .name = "net.poll" };
+
+/** Network receive profiler */
+static struct profiler net_rx_profiler __profiler = { .name = "netdev.rx" };
+
 /** Default unknown link status code */
 #define EUNKNOWN_LINK_STATUS __einfo_error ( EINFO_EUNKNOWN_LINK_STATUS )
 #define EINFO_EUNKNOWN_LINK_STATUS \
@@ -180,11 +192,20 @@ static void netdev_record_stat ( struct net_device_stats *stats, int rc ) {
 int netdev_tx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 	int rc;
 
-	DBGC2 ( netdev, "NETDEV %s transmitting %p (%p+%zx)\n",
-		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ) );
+	DBGC2 ( netdev, "NETDEV %s transmitting %p (%p+%zx) flags %#x\n",
+		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ),
+		iobuf->flags );
+
+	/* Offloads may be requested only if supported by the device */
+	assert ( ( ! ( iobuf->flags & IOB_CSUM_PARTIAL ) ) ||
+		 ( netdev->offloads & NETDEV_OFFLOAD_TX_CSUM ) );
+	assert ( ( ! ( iobuf->flags & IOB_TSO ) ) ||
+		 ( netdev->offloads & NETDEV_OFFLOAD_TSO ) );
 
 	/* Enqueue packet */
 	list_add_tail ( &iobuf->list, &netdev->tx_queue );
+	if ( ++netdev->tx_depth > netdev->tx_max_depth )
+		netdev->tx_max_depth = netdev->tx_depth;
 
 	/* Avoid calling transmit() on unopened network devices */
 	if ( ! netdev_is_open ( netdev ) ) {
@@ -254,6 +275,7 @@ void netdev_tx_complete_err ( struct net_device *netdev,
 
 	/* Dequeue and free I/O buffer */
 	list_del ( &iobuf->list );
+	netdev->tx_depth--;
 	netdev_tx_err ( netdev, iobuf, rc );
 }
 
@@ -298,21 +320,34 @@ static void netdev_tx_flush ( struct net_device *netdev ) {
  */
 void netdev_rx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 
-	DBGC2 ( netdev, "NETDEV %s received %p (%p+%zx)\n",
-		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ) );
+	profile_start ( &net_rx_profiler );
+
+	DBGC2 ( netdev, "NETDEV %s received %p (%p+%zx) flags %#x\n",
+		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ),
+		iobuf->flags );
+
+	/* Checksums may be vouched for only if supported by the device */
+	assert ( ( ! ( iobuf->flags & ( IOB_CSUM_VERIFIED |
+					IOB_IP_CSUM_VERIFIED ) ) ) ||
+		 ( netdev->offloads & NETDEV_OFFLOAD_RX_CSUM ) );
 
 	/* Discard packet (for test purposes) if applicable */
 	if ( ( NETDEV_DISCARD_RATE > 0 ) &&
 	     ( ( random() % NETDEV_DISCARD_RATE ) == 0 ) ) {
 		netdev_rx_err ( netdev, iobuf, -EAGAIN );
+		profile_stop ( &net_rx_profiler );
 		return;
 	}
 
 	/* Enqueue packet */
 	list_add_tail ( &iobuf->list, &netdev->rx_queue );
+	if ( ++netdev->rx_depth > netdev->rx_max_depth )
+		netdev->rx_max_depth = netdev->rx_depth;
 
 	/* Update statistics counter */
 	netdev_record_stat ( &netdev->rx_stats, 0 );
+
+	profile_stop ( &net_rx_profiler );
 }
 
 /**
@@ -372,6 +407,7 @@ struct io_buffer * netdev_rx_dequeue ( struct net_device *netdev ) {
 		return NULL;
 
 	list_del ( &iobuf->list );
+	netdev->rx_depth--;
 	return iobuf;
 }
 
@@ -472,7 +508,8 @@ int register_netdev ( struct net_device *netdev ) {
 
 	/* Probe device */
 	for_each_table_entry ( driver, NET_DRIVERS ) {
-		if ( ( rc = driver->probe ( netdev ) ) != 0 ) {
+		if ( driver->probe &&
+		     ( ( rc = driver->probe ( netdev ) ) != 0 ) ) {
 			DBGC ( netdev, "NETDEV %s could not add %s device: "
 			       "%s\n", netdev->name, driver->name,
 			       strerror ( rc ) );
@@ -515,6 +552,10 @@ int netdev_open ( struct net_device *netdev ) {
 	/* Add to head of open devices list */
 	list_add ( &netdev->open_list, &open_net_devices );
 
+	/* Wake up networking stack process */
+	if ( ! process_running ( &net_process ) )
+		process_add ( &net_process );
+
 	/* Notify drivers of device state change */
 	netdev_notify ( netdev );
 
@@ -719,6 +760,41 @@ int net_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 	return -ENOTSUP;
 }
 
+/**
+ * Process received packet
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ *
+ * This function takes ownership of the I/O buffer.
+ */
+static void net_rx_process ( struct net_device *netdev,
+			     struct io_buffer *iobuf ) {
+	struct ll_protocol *ll_protocol = netdev->ll_protocol;
+	const void *ll_dest;
+	const void *ll_source;
+	uint16_t net_proto;
+	unsigned int flags;
+	int rc;
+
+	DBGC2 ( netdev, "NETDEV %s processing %p (%p+%zx)\n",
+		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ) );
+
+	/* Remove link-layer header */
+	if ( ( rc = ll_protocol->pull ( netdev, iobuf, &ll_dest, &ll_source,
+					&net_proto, &flags ) ) != 0 ) {
+		free_iob ( iobuf );
+		return;
+	}
+
+	/* Hand packet to network layer */
+	if ( ( rc = net_rx ( iob_disown ( iobuf ), netdev, net_proto,
+			     ll_dest, ll_source, flags ) ) != 0 ) {
+		/* Record error for diagnosis */
+		netdev_rx_err ( netdev, NULL, rc );
+	}
+}
+
 /**
  * Poll the network stack
  *
@@ -728,12 +804,9 @@ int net_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 void net_poll ( void ) {
 	struct net_device *netdev;
 	struct io_buffer *iobuf;
-	struct ll_protocol *ll_protocol;
-	const void *ll_dest;
-	const void *ll_source;
-	uint16_t net_proto;
-	unsigned int flags;
-	int rc;
+	unsigned int budget;
+
+	profile_start ( &net_poll_profiler );
 
 	/* Poll and process each network device */
 	list_for_each_entry ( netdev, &net_devices, list ) {
@@ -750,37 +823,31 @@ void net_poll ( void ) {
 		if ( netdev_rx_frozen ( netdev ) )
 			continue;
 
-		/* Process at most one received packet.  Give priority
-		 * to getting packets out of the NIC over processing
-		 * the received packets, because we advertise a window
-		 * that assumes that we can receive packets from the
-		 * NIC faster than they arrive.
+		/* Process a batch of received packets.  The batch
+		 * size is normally limited to NETDEV_RX_BUDGET, so
+		 * that other processes are not starved, but is
+		 * allowed to grow to half of the receive queue depth
+		 * so that a backlog cannot grow without bound.
 		 */
-		if ( ( iobuf = netdev_rx_dequeue ( netdev ) ) ) {
-
-			DBGC2 ( netdev, "NETDEV %s processing %p (%p+%zx)\n",
-				netdev->name, iobuf, iobuf->data,
-				iob_len ( iobuf ) );
-
-			/* Remove link-layer header */
-			ll_protocol = netdev->ll_protocol;
-			if ( ( rc = ll_protocol->pull ( netdev, iobuf,
-							&ll_dest, &ll_source,
-							&net_proto,
-							&flags ) ) != 0 ) {
-				free_iob ( iobuf );
-				continue;
-			}
-
-			/* Hand packet to network layer */
-			if ( ( rc = net_rx ( iob_disown ( iobuf ), netdev,
-					     net_proto, ll_dest,
-					     ll_source, flags ) ) != 0 ) {
-				/* Record error for diagnosis */
-				netdev_rx_err ( netdev, NULL, rc );
-			}
+		budget = NETDEV_RX_BUDGET;
+		if ( budget < ( netdev->rx_depth / 2 ) )
+			budget = ( netdev->rx_depth / 2 );
+		while ( budget-- && ( ! netdev_rx_frozen ( netdev ) ) &&
+			( ( iobuf = netdev_rx_dequeue ( netdev ) ) != NULL ) ) {
+			net_rx_process ( netdev, iobuf );
+
+			/* Continue to give priority to getting packets
+			 * out of the NIC over processing the received
+			 * packets, because we advertise a window that
+			 * assumes that we can receive packets from the
+			 * NIC faster than they arrive.
+			 */
+			if ( budget )
+				netdev_poll ( netdev );
 		}
 	}
+
+	profile_stop ( &net_poll_profiler );
 }
 
 /**
@@ -788,9 +855,13 @@ void net_poll ( void ) {
  *
  * @v process		Network stack process
  */
-static void net_step ( struct process *process __unused ) {
+static void net_step ( struct process *process ) {
+
+	/* Sleep until a network device is opened */
+	if ( list_empty ( &open_net_devices ) ) {
+		process_del ( process );
+		return;
+	}
+
 	net_poll();
 }
-
-/** Networking stack process */
-PERMANENT_PROCESS ( net_process, net_step );
@@ -35,7 +35,11 @@ FILE_LICENCE ( GPL2_OR_LATER );
  * This implementation of the timer is designed to satisfy RFC 2988
  * and therefore be usable as a TCP retransmission timer.
  *
- * 
+ * Running timers are held in a hashed timer wheel, indexed by expiry
+ * time.  Starting and stopping a timer are therefore constant-time
+ * operations, and each step of the retry timer process need examine
+ * only the timers hashed to the slots that have elapsed since the
+ * previous step.
  */
 
 /* The theoretical minimum that the algorithm in stop_timer() can
@@ -44,8 +48,44 @@ FILE_LICENCE ( GPL2_OR_LATER );
  */
 #define MIN_TIMEOUT 7
 
-/** List of running timers */
-static LIST_HEAD ( timers );
+/** Number of timer wheel slots
+ *
+ * Must be a power of two.
+ */
+#define RETRY_WHEEL_SIZE 256
+
+/** Timer wheel (lists of running timers, indexed by expiry time) */
+static struct list_head retry_wheel[RETRY_WHEEL_SIZE];
+
+/** Current timer wheel position (in ticks) */
+static unsigned long retry_wheel_tick;
+
+/** Number of running timers */
+static unsigned int retry_running;
+
+static void retry_step ( struct process *process );
+
+/** Retry timer process */
+PERMANENT_PROCESS_CLASS ( retry_process, retry_step, PROC_CLASS_TX );
+
+/**
+ * Add timer to timer wheel
+ *
+ * @v timer		Retry timer
+ */
+static void retry_schedule ( struct retry_timer *timer ) {
+	unsigned long expiry = ( timer->start + timer->timeout );
+
+	/* A timer that expires before the current wheel position is
+	 * placed in the current slot, so that it will be examined on
+	 * the next step.
+	 */
+	if ( ( ( signed long ) ( expiry - retry_wheel_tick ) ) < 0 )
+		expiry = retry_wheel_tick;
+
+	list_add_tail ( &timer->list,
+			&retry_wheel[ expiry % RETRY_WHEEL_SIZE ] );
+}
 
 /**
  * Start timer
@@ -57,9 +97,11 @@ static LIST_HEAD ( timers );
  * be stopped and the timer's callback function will be called.
  */
 void start_timer ( struct retry_timer *timer ) {
-	if ( ! timer->running ) {
-		list_add ( &timer->list, &timers );
+	if ( timer->running ) {
+		list_del ( &timer->list );
+	} else {
 		ref_get ( timer->refcnt );
+		retry_running++;
 	}
 	timer->start = currticks();
 	timer->running = 1;
@@ -74,6 +116,13 @@ void start_timer ( struct retry_timer *timer ) {
 	if ( timer->timeout < timer->min_timeout )
 		timer->timeout = timer->min_timeout;
 
+	/* Add to timer wheel */
+	retry_schedule ( timer );
+
+	/* Wake up retry timer process */
+	if ( ! process_running ( &retry_process ) )
+		process_add ( &retry_process );
+
 	DBG2 ( "Timer %p started at time %ld (expires at %ld)\n",
 	       timer, timer->start, ( timer->start + timer->timeout ) );
 }
@@ -87,6 +136,8 @@ void start_timer ( struct retry_timer *timer ) {
 void start_timer_fixed ( struct retry_timer *timer, unsigned long timeout ) {
 	start_timer ( timer );
 	timer->timeout = timeout;
+	list_del ( &timer->list );
+	retry_schedule ( timer );
 	DBG2 ( "Timer %p expiry time changed to %ld\n",
 	       timer, ( timer->start + timer->timeout ) );
 }
@@ -110,6 +161,7 @@ void stop_timer ( struct retry_timer *timer ) {
 	list_del ( &timer->list );
 	runtime = ( now - timer->start );
 	timer->running = 0;
+	retry_running--;
 	DBG2 ( "Timer %p stopped at time %ld (ran for %ld)\n",
 	       timer, now, runtime );
 
@@ -157,6 +209,7 @@ static void timer_expired ( struct retry_timer *timer ) {
 	assert ( timer->running );
 	list_del ( &timer->list );
 	timer->running = 0;
+	retry_running--;
 	timer->count++;
 
 	/* Back off the timeout value */
@@ -180,24 +233,66 @@ static void timer_expired ( struct retry_timer *timer ) {
  *
  * @v process		Retry timer process
  */
-static void retry_step ( struct process *process __unused ) {
+static void retry_step ( struct process *process ) {
 	struct retry_timer *timer;
+	struct list_head *slot;
+	LIST_HEAD ( pending );
 	unsigned long now = currticks();
+	unsigned long tick;
 	unsigned long used;
+	unsigned int count;
+
+	/* Sleep until a timer is started */
+	if ( ! retry_running ) {
+		process_del ( process );
+		return;
+	}
 
-	/* Process at most one timer expiry.  We cannot process
-	 * multiple expiries in one pass, because one timer expiring
-	 * may end up triggering another timer's deletion from the
-	 * list.
+	/* Examine each slot from the current wheel position up to and
+	 * including the current time (or every slot, if the wheel has
+	 * fallen a whole revolution behind).  The slot for the
+	 * current time is examined again on the next step, to catch
+	 * any zero-length timers started in the meantime.
 	 */
-	list_for_each_entry ( timer, &timers, list ) {
-		used = ( now - timer->start );
-		if ( used >= timer->timeout ) {
-			timer_expired ( timer );
-			break;
+	count = ( ( now - retry_wheel_tick ) + 1 );
+	if ( count > RETRY_WHEEL_SIZE )
+		count = RETRY_WHEEL_SIZE;
+	retry_wheel_tick = now;
+	for ( tick = ( now - count + 1 ) ; count-- ; tick++ ) {
+
+		/* Move this slot's timers to a private list.  Expiry
+		 * callbacks may stop or restart any timer (including
+		 * those on the private list), so timers are removed
+		 * from the private list one at a time.
+		 */
+		slot = &retry_wheel[ tick % RETRY_WHEEL_SIZE ];
+		list_splice_init ( slot, &pending );
+		while ( ( timer = list_first_entry ( &pending,
+						     struct retry_timer,
+						     list ) ) != NULL ) {
+			used = ( now - timer->start );
+			if ( used >= timer->timeout ) {
+				timer_expired ( timer );
+			} else {
+				list_del ( &timer->list );
+				retry_schedule ( timer );
+			}
 		}
 	}
 }
 
-/** Retry timer process */
-PERMANENT_PROCESS ( retry_process, retry_step );
+/**
+ * Initialise retry timers
+ *
+ */
+static void retry_init ( void ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < RETRY_WHEEL_SIZE ; i++ )
+		INIT_LIST_HEAD ( &retry_wheel[i] );
+}
+
+/** Retry timer initialisation function */
+struct init_fn retry_init_fn __init_fn ( INIT_EARLY ) = {
+	.initialise = retry_init,
+};
@@ -15,6 +15,7 @@
 #include <ipxe/netdevice.h>
 #include <ipxe/tcpip.h>
 #include <ipxe/tcp.h>
+#include <ipxe/profile.h>
 
 /** @file
  *
@@ -64,6 +65,16 @@ struct tcp_connection {
 	 * Equivalent to SND.WND in RFC 793 terminology
 	 */
 	uint32_t snd_win;
+	/** Send window scale
+	 *
+	 * Equivalent to Snd.Wind.Scale in RFC 7323 terminology
+	 */
+	uint8_t snd_win_scale;
+	/** Receive window scale
+	 *
+	 * Equivalent to Rcv.Wind.Scale in RFC 7323 terminology
+	 */
+	uint8_t rcv_win_scale;
 	/** Current acknowledgement number
 	 *
 	 * Equivalent to RCV.NXT in RFC 793 terminology.
@@ -85,6 +96,25 @@ struct tcp_connection {
 	 * Equivalent to TS.Recent in RFC 1323 terminology.
 	 */
 	uint32_t ts_recent;
+	/** Most recently received out-of-order sequence number
+	 *
+	 * Used to identify the SACK block that must be reported
+	 * first, as per RFC 2018.
+	 */
+	uint32_t sack_seq;
+
+	/** Congestion control algorithm */
+	struct tcp_congestion_algorithm *congestion;
+	/** Congestion control state */
+	struct tcp_congestion cong;
+	/** Number of consecutive duplicate ACKs received */
+	unsigned int dup_acks;
+	/** Loss recovery point
+	 *
+	 * Equivalent to "recover" in RFC 6582 terminology.  Valid
+	 * only while one of the loss recovery flags is set.
+	 */
+	uint32_t recover;
 
 	/** Transmit queue */
 	struct list_head tx_queue;
@@ -104,6 +134,14 @@ enum tcp_flags {
 	TCP_TS_ENABLED = 0x0002,
 	/** TCP acknowledgement is pending */
 	TCP_ACK_PENDING = 0x0004,
+	/** TCP selective acknowledgement is enabled */
+	TCP_SACK_ENABLED = 0x0008,
+	/** TCP is in fast recovery following a fast retransmission */
+	TCP_FAST_RECOVERY = 0x0010,
+	/** TCP is recovering from a retransmission timeout */
+	TCP_RTO_RECOVERY = 0x0020,
+	/** TCP is recovering from a loss */
+	TCP_RECOVERY = ( TCP_FAST_RECOVERY | TCP_RTO_RECOVERY ),
 };
 
 /** TCP internal header
@@ -134,12 +172,15 @@ struct tcp_rx_queued_header {
  */
 static LIST_HEAD ( tcp_conns );
 
+/** TCP receive profiler */
+static struct profiler tcp_rx_profiler __profiler = { .name = "tcp.rx" };
+
 /* Forward declarations */
 static struct interface_descriptor tcp_xfer_desc;
 static void tcp_expired ( struct retry_timer *timer, int over );
 static void tcp_wait_expired ( struct retry_timer *timer, int over );
 static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
-			uint32_t win );
+			uint32_t win, uint32_t seq_len );
 
 /**
  * Name TCP state
@@ -278,6 +319,9 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 	tcp->tcp_state = TCP_STATE_SENT ( TCP_SYN );
 	tcp_dump_state ( tcp );
 	tcp->snd_seq = random();
+	tcp->congestion = table_start ( TCP_CONGESTION_ALGORITHMS );
+	tcp->cong.cwnd = TCP_INITIAL_CWND;
+	tcp->cong.ssthresh = ~( ( uint32_t ) 0 );
 	INIT_LIST_HEAD ( &tcp->tx_queue );
 	INIT_LIST_HEAD ( &tcp->rx_queue );
 	memcpy ( &tcp->peer, st_peer, sizeof ( tcp->peer ) );
@@ -354,7 +398,7 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 	 * can send a FIN without breaking things.
 	 */
 	if ( ! ( tcp->tcp_state & TCP_STATE_ACKED ( TCP_SYN ) ) )
-		tcp_rx_ack ( tcp, ( tcp->snd_seq + 1 ), 0 );
+		tcp_rx_ack ( tcp, ( tcp->snd_seq + 1 ), 0, 0 );
 
 	/* If we have no data remaining to send, start sending FIN */
 	if ( list_empty ( &tcp->tx_queue ) ) {
@@ -370,74 +414,96 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
  ***************************************************************************
  */
 
+/**
+ * Check if segmentation offload is available
+ *
+ * @v tcp		TCP connection
+ * @ret is_available	Segmentation offload is available
+ */
+static int tcp_tso ( struct tcp_connection *tcp ) {
+	struct net_device *netdev;
+
+	netdev = tcpip_netdev ( &tcp->peer );
+	return ( netdev && ( netdev->offloads & NETDEV_OFFLOAD_TSO ) );
+}
+
 /**
  * Calculate transmission window
  *
  * @v tcp		TCP connection
  * @ret len		Maximum length that can be sent in a single packet
+ *
+ * The amount of data in flight is limited by both the receiver's
+ * window and the congestion window.
  */
 static size_t tcp_xmit_win ( struct tcp_connection *tcp ) {
+	uint32_t win;
+	size_t max_len;
 	size_t len;
 
 	/* Not ready if we're not in a suitable connection state */
 	if ( ! TCP_CAN_SEND_DATA ( tcp->tcp_state ) )
 		return 0;
 
-	/* Length is the minimum of the receiver's window and the path MTU */
-	len = tcp->snd_win;
-	if ( len > TCP_PATH_MTU )
-		len = TCP_PATH_MTU;
-
-	return len;
-}
-
-/**
- * Check data-transfer flow control window
- *
- * @v tcp		TCP connection
- * @ret len		Length of window
- */
-static size_t tcp_xfer_window ( struct tcp_connection *tcp ) {
-
-	/* Not ready if data queue is non-empty.  This imposes a limit
-	 * of only one unACKed packet in the TX queue at any time; we
-	 * do this to conserve memory usage.
+	/* Calculate space remaining within the smaller of the
+	 * receiver's window and the congestion window.
 	 */
-	if ( ! list_empty ( &tcp->tx_queue ) )
+	win = tcp->snd_win;
+	if ( win > tcp->cong.cwnd )
+		win = tcp->cong.cwnd;
+	if ( win <= tcp->snd_sent )
 		return 0;
+	len = ( win - tcp->snd_sent );
+
+	/* Limit to the path MTU, unless the transmitting network
+	 * device is able to split larger segments for us.
+	 */
+	max_len = ( tcp_tso ( tcp ) ? TCP_TSO_MAX_LEN : TCP_PATH_MTU );
+	if ( len > max_len )
+		len = max_len;
 
-	/* Return TCP window length */
-	return tcp_xmit_win ( tcp );
+	return len;
 }
 
 /**
  * Process TCP transmit queue
  *
  * @v tcp		TCP connection
+ * @v offset		Offset within transmit queue
  * @v max_len		Maximum length to process
  * @v dest		I/O buffer to fill with data, or NULL
  * @v remove		Remove data from queue
  * @ret len		Length of data processed
  *
  * This processes at most @c max_len bytes from the TCP connection's
- * transmit queue.  Data will be copied into the @c dest I/O buffer
- * (if provided) and, if @c remove is true, removed from the transmit
- * queue.
+ * transmit queue, starting at @c offset bytes into the queue.  Data
+ * will be copied into the @c dest I/O buffer (if provided) and, if
+ * @c remove is true, removed from the transmit queue.  Data may be
+ * removed only from the start of the queue.
  */
-static size_t tcp_process_tx_queue ( struct tcp_connection *tcp, size_t max_len,
+static size_t tcp_process_tx_queue ( struct tcp_connection *tcp,
+				     size_t offset, size_t max_len,
 				     struct io_buffer *dest, int remove ) {
 	struct io_buffer *iobuf;
 	struct io_buffer *tmp;
 	size_t frag_len;
 	size_t len = 0;
 
+	/* Sanity check */
+	assert ( ( offset == 0 ) || ( ! remove ) );
+
 	list_for_each_entry_safe ( iobuf, tmp, &tcp->tx_queue, list ) {
 		frag_len = iob_len ( iobuf );
+		if ( offset >= frag_len ) {
+			offset -= frag_len;
+			continue;
+		}
+		frag_len -= offset;
 		if ( frag_len > max_len )
 			frag_len = max_len;
 		if ( dest ) {
-			memcpy ( iob_put ( dest, frag_len ), iobuf->data,
-				 frag_len );
+			memcpy ( iob_put ( dest, frag_len ),
+				 ( iobuf->data + offset ), frag_len );
 		}
 		if ( remove ) {
 			iob_pull ( iobuf, frag_len );
@@ -446,6 +512,7 @@ static size_t tcp_process_tx_queue ( struct tcp_connection *tcp, size_t max_len,
 				free_iob ( iobuf );
 			}
 		}
+		offset = 0;
 		len += frag_len;
 		max_len -= frag_len;
 	}
@@ -453,73 +520,213 @@ static size_t tcp_process_tx_queue ( struct tcp_connection *tcp, size_t max_len,
 }
 
 /**
- * Transmit any outstanding data
+ * Check data-transfer flow control window
+ *
+ * @v tcp		TCP connection
+ * @ret len		Length of window
+ */
+static size_t tcp_xfer_window ( struct tcp_connection *tcp ) {
+	size_t win;
+	size_t queued;
+
+	/* Not ready if we're not in a suitable connection state */
+	if ( ! TCP_CAN_SEND_DATA ( tcp->tcp_state ) )
+		return 0;
+
+	/* Allow the application to fill the smaller of the
+	 * receiver's window and the congestion window, limited to
+	 * half of the free memory so that we retain space for
+	 * received packets.
+	 */
+	win = tcp->snd_win;
+	if ( win > tcp->cong.cwnd )
+		win = tcp->cong.cwnd;
+	if ( win > ( freemem / 2 ) )
+		win = ( freemem / 2 );
+	queued = tcp_process_tx_queue ( tcp, 0, ~( ( size_t ) 0 ), NULL, 0 );
+	if ( win <= queued )
+		return 0;
+
+	return ( win - queued );
+}
+
+/**
+ * Add TCP selective acknowledgement block
+ *
+ * @v tcp		TCP connection
+ * @v sack		SACK block list
+ * @v count		Number of SACK blocks (excluding the first)
+ * @v left		Left edge of block (in host-endian order)
+ * @v right		Right edge of block (in host-endian order)
+ * @ret is_recent	Block contains most recently received segment
+ *
+ * The first entry of the SACK block list is reserved for the block
+ * containing the most recently received segment.
+ */
+static int tcp_sack_add ( struct tcp_connection *tcp,
+			  struct tcp_sack_block *sack, unsigned int *count,
+			  uint32_t left, uint32_t right ) {
+	struct tcp_sack_block *block;
+
+	if ( tcp_in_window ( tcp->sack_seq, left, ( right - left ) ) ) {
+		block = &sack[0];
+	} else if ( *count < ( TCP_SACK_MAX - 1 ) ) {
+		block = &sack[ 1 + (*count)++ ];
+	} else {
+		return 0;
+	}
+	block->left = htonl ( left );
+	block->right = htonl ( right );
+	return ( block == &sack[0] );
+}
+
+/**
+ * Construct TCP selective acknowledgement blocks
+ *
+ * @v tcp		TCP connection
+ * @v sack		SACK block list to fill in
+ * @ret count		Number of SACK blocks
+ *
+ * The SACK blocks are constructed from the contents of the receive
+ * queue, which holds only out-of-order data by the time this is
+ * called.  As per RFC 2018, the first block reported is the one
+ * containing the most recently received segment; the remaining
+ * blocks are reported in sequence order.
+ */
+static unsigned int tcp_sack ( struct tcp_connection *tcp,
+			       struct tcp_sack_block *sack ) {
+	struct tcp_rx_queued_header *tcpqhdr;
+	struct io_buffer *iobuf;
+	uint32_t left = 0;
+	uint32_t right = 0;
+	uint32_t seg_left;
+	uint32_t seg_right;
+	unsigned int count = 0;
+	int have_recent = 0;
+	int have_block = 0;
+
+	/* Merge contiguous or overlapping queued segments into blocks */
+	list_for_each_entry ( iobuf, &tcp->rx_queue, list ) {
+		tcpqhdr = iobuf->data;
+		seg_left = tcpqhdr->seq;
+		seg_right = ( seg_left + iob_len ( iobuf ) -
+			      sizeof ( *tcpqhdr ) );
+		if ( seg_right == seg_left )
+			continue;
+		if ( have_block && ( tcp_cmp ( seg_left, right ) <= 0 ) ) {
+			if ( tcp_cmp ( seg_right, right ) > 0 )
+				right = seg_right;
+			continue;
+		}
+		if ( have_block ) {
+			have_recent |= tcp_sack_add ( tcp, sack, &count,
+						      left, right );
+		}
+		left = seg_left;
+		right = seg_right;
+		have_block = 1;
+	}
+	if ( have_block )
+		have_recent |= tcp_sack_add ( tcp, sack, &count, left, right );
+
+	/* Close up the reserved first entry if unused */
+	if ( ! have_recent ) {
+		memmove ( &sack[0], &sack[1], ( count * sizeof ( sack[0] ) ) );
+		return count;
+	}
+	return ( count + 1 );
+}
+
+/**
+ * Transmit a single segment
  *
  * @v tcp		TCP connection
- * 
- * Transmits any outstanding data on the connection.
+ * @v offset		Offset of segment within sequence space
+ * @v max_len		Maximum length of data payload
+ * @ret rc		Return status code
+ *
+ * Transmits the segment starting @c offset bytes into the sequence
+ * space following SND.UNA.  An @c offset less than @c snd_sent
+ * represents a retransmission.  If there is nothing to transmit at
+ * this offset, then a pure ACK will be sent if an acknowledgement is
+ * pending.
  *
  * Note that even if an error is returned, the retransmission timer
  * will have been started if necessary, and so the stack will
  * eventually attempt to retransmit the failed packet.
  */
-static int tcp_xmit ( struct tcp_connection *tcp ) {
+static int tcp_xmit_segment ( struct tcp_connection *tcp, uint32_t offset,
+			      size_t max_len ) {
 	struct io_buffer *iobuf;
 	struct tcp_header *tcphdr;
 	struct tcp_mss_option *mssopt;
+	struct tcp_window_scale_padded_option *wsopt;
+	struct tcp_sack_permitted_padded_option *spopt;
 	struct tcp_timestamp_padded_option *tsopt;
+	struct tcp_sack_padded_option *sackopt;
+	struct tcp_sack_block sack[TCP_SACK_MAX];
 	void *payload;
+	unsigned int sending;
 	unsigned int flags;
+	unsigned int sack_count;
+	size_t sack_len;
 	size_t len = 0;
-	uint32_t seq_len;
+	uint32_t seq = ( tcp->snd_seq + offset );
+	uint32_t seq_len = 0;
 	uint32_t app_win;
 	uint32_t max_rcv_win;
+	uint32_t max_representable_win;
 	int rc;
 
-	/* If retransmission timer is already running, do nothing */
-	if ( timer_running ( &tcp->timer ) )
-		return 0;
-
 	/* Calculate both the actual (payload) and sequence space
-	 * lengths that we wish to transmit.
+	 * lengths that we wish to transmit.  SYN and FIN each
+	 * consume one byte, and we can never send both.  SYN must be
+	 * acknowledged before any data is sent, and FIN is sent only
+	 * once all data has been acknowledged, so neither can ever
+	 * be in flight alongside data.
 	 */
+	sending = TCP_FLAGS_SENDING ( tcp->tcp_state );
+	assert ( ! ( ( sending & TCP_SYN ) && ( sending & TCP_FIN ) ) );
+	flags = ( sending & ~( TCP_SYN | TCP_FIN ) );
 	if ( TCP_CAN_SEND_DATA ( tcp->tcp_state ) ) {
-		len = tcp_process_tx_queue ( tcp, tcp_xmit_win ( tcp ),
-					     NULL, 0 );
+		len = tcp_process_tx_queue ( tcp, offset, max_len, NULL, 0 );
+		seq_len = len;
+	} else if ( ( sending & ( TCP_SYN | TCP_FIN ) ) && ( offset == 0 ) ) {
+		flags |= ( sending & ( TCP_SYN | TCP_FIN ) );
+		seq_len = 1;
 	}
-	seq_len = len;
-	flags = TCP_FLAGS_SENDING ( tcp->tcp_state );
-	if ( flags & ( TCP_SYN | TCP_FIN ) ) {
-		/* SYN or FIN consume one byte, and we can never send both */
-		assert ( ! ( ( flags & TCP_SYN ) && ( flags & TCP_FIN ) ) );
-		seq_len++;
-	}
-	tcp->snd_sent = seq_len;
 
 	/* If we have nothing to transmit, stop now */
 	if ( ( seq_len == 0 ) && ! ( tcp->flags & TCP_ACK_PENDING ) )
 		return 0;
 
+	/* Update unacknowledged sequence count.  Do this before
+	 * attempting to allocate the I/O buffer, so that a failed
+	 * transmission will subsequently be retransmitted.
+	 */
+	if ( ( offset + seq_len ) > tcp->snd_sent )
+		tcp->snd_sent = ( offset + seq_len );
+
 	/* If we are transmitting anything that requires
 	 * acknowledgement (i.e. consumes sequence space), start the
-	 * retransmission timer.  Do this before attempting to
-	 * allocate the I/O buffer, in case allocation itself fails.
+	 * retransmission timer if not already running.  Do this
+	 * before attempting to allocate the I/O buffer, in case
+	 * allocation itself fails.
 	 */
-	if ( seq_len )
+	if ( seq_len && ! timer_running ( &tcp->timer ) )
 		start_timer ( &tcp->timer );
 
 	/* Allocate I/O buffer */
 	iobuf = alloc_iob ( len + TCP_MAX_HEADER_LEN );
 	if ( ! iobuf ) {
 		DBGC ( tcp, "TCP %p could not allocate iobuf for %08x..%08x "
-		       "%08x\n", tcp, tcp->snd_seq, ( tcp->snd_seq + seq_len ),
-		       tcp->rcv_ack );
+		       "%08x\n", tcp, seq, ( seq + seq_len ), tcp->rcv_ack );
 		return -ENOMEM;
 	}
 	iob_reserve ( iobuf, TCP_MAX_HEADER_LEN );
 
 	/* Fill data payload from transmit queue */
-	tcp_process_tx_queue ( tcp, len, iobuf, 0 );
+	tcp_process_tx_queue ( tcp, offset, len, iobuf, 0 );
 
 	/* Expand receive window if possible */
 	max_rcv_win = ( ( freemem * 3 ) / 4 );
@@ -528,6 +735,9 @@ static int tcp_xmit ( struct tcp_connection *tcp ) {
 	app_win = xfer_window ( &tcp->xfer );
 	if ( max_rcv_win > app_win )
 		max_rcv_win = app_win;
+	max_representable_win = ( 0xffff << tcp->rcv_win_scale );
+	if ( max_rcv_win > max_representable_win )
+		max_rcv_win = max_representable_win;
 	max_rcv_win &= ~0x03; /* Keep everything dword-aligned */
 	if ( tcp->rcv_win < max_rcv_win )
 		tcp->rcv_win = max_rcv_win;
@@ -539,6 +749,15 @@ static int tcp_xmit ( struct tcp_connection *tcp ) {
 		mssopt->kind = TCP_OPTION_MSS;
 		mssopt->length = sizeof ( *mssopt );
 		mssopt->mss = htons ( TCP_MSS );
+		wsopt = iob_push ( iobuf, sizeof ( *wsopt ) );
+		memset ( wsopt->nop, TCP_OPTION_NOP, sizeof ( wsopt->nop ) );
+		wsopt->wsopt.kind = TCP_OPTION_WS;
+		wsopt->wsopt.length = sizeof ( wsopt->wsopt );
+		wsopt->wsopt.scale = TCP_RX_WINDOW_SCALE;
+		spopt = iob_push ( iobuf, sizeof ( *spopt ) );
+		memset ( spopt->nop, TCP_OPTION_NOP, sizeof ( spopt->nop ) );
+		spopt->spopt.kind = TCP_OPTION_SACK_PERMITTED;
+		spopt->spopt.length = sizeof ( spopt->spopt );
 	}
 	if ( ( flags & TCP_SYN ) || ( tcp->flags & TCP_TS_ENABLED ) ) {
 		tsopt = iob_push ( iobuf, sizeof ( *tsopt ) );
@@ -548,18 +767,40 @@ static int tcp_xmit ( struct tcp_connection *tcp ) {
 		tsopt->tsopt.tsval = htonl ( currticks() );
 		tsopt->tsopt.tsecr = htonl ( tcp->ts_recent );
 	}
+	if ( ( tcp->flags & TCP_SACK_ENABLED ) &&
+	     ( ! list_empty ( &tcp->rx_queue ) ) &&
+	     ( ( sack_count = tcp_sack ( tcp, sack ) ) != 0 ) ) {
+		sack_len = ( sack_count * sizeof ( sack[0] ) );
+		sackopt = iob_push ( iobuf, ( sizeof ( *sackopt ) + sack_len ));
+		memset ( sackopt->nop, TCP_OPTION_NOP, sizeof ( sackopt->nop ) );
+		sackopt->sackopt.kind = TCP_OPTION_SACK;
+		sackopt->sackopt.length =
+			( sizeof ( sackopt->sackopt ) + sack_len );
+		memcpy ( ( ( ( void * ) sackopt ) + sizeof ( *sackopt ) ),
+			 sack, sack_len );
+	}
 	if ( len != 0 )
 		flags |= TCP_PSH;
 	tcphdr = iob_push ( iobuf, sizeof ( *tcphdr ) );
 	memset ( tcphdr, 0, sizeof ( *tcphdr ) );
 	tcphdr->src = htons ( tcp->local_port );
 	tcphdr->dest = tcp->peer.st_port;
-	tcphdr->seq = htonl ( tcp->snd_seq );
+	tcphdr->seq = htonl ( seq );
 	tcphdr->ack = htonl ( tcp->rcv_ack );
 	tcphdr->hlen = ( ( payload - iobuf->data ) << 2 );
 	tcphdr->flags = flags;
-	tcphdr->win = htons ( tcp->rcv_win );
-	tcphdr->csum = tcpip_chksum ( iobuf->data, iob_len ( iobuf ) );
+	tcphdr->win = htons ( tcp->rcv_win >> tcp->rcv_win_scale );
+
+	/* Request segmentation offload for segments longer than the
+	 * path MTU.  Each resulting segment will carry a copy of our
+	 * TCP options, so reduce the segment size accordingly.
+	 */
+	if ( len > TCP_PATH_MTU ) {
+		iobuf->flags |= IOB_TSO;
+		iobuf->mss = ( TCP_PATH_MTU -
+			       ( ( payload - iobuf->data ) -
+				 sizeof ( *tcphdr ) ) );
+	}
 
 	/* Dump header */
 	DBGC2 ( tcp, "TCP %p TX %d->%d %08x..%08x           %08x %4zd",
@@ -573,8 +814,8 @@ static int tcp_xmit ( struct tcp_connection *tcp ) {
 	if ( ( rc = tcpip_tx ( iobuf, &tcp_protocol, NULL, &tcp->peer, NULL,
 			       &tcphdr->csum ) ) != 0 ) {
 		DBGC ( tcp, "TCP %p could not transmit %08x..%08x %08x: %s\n",
-		       tcp, tcp->snd_seq, ( tcp->snd_seq + tcp->snd_sent ),
-		       tcp->rcv_ack, strerror ( rc ) );
+		       tcp, seq, ( seq + seq_len ), tcp->rcv_ack,
+		       strerror ( rc ) );
 		return rc;
 	}
 
@@ -584,6 +825,69 @@ static int tcp_xmit ( struct tcp_connection *tcp ) {
 	return 0;
 }
 
+/**
+ * Transmit any outstanding data
+ *
+ * @v tcp		TCP connection
+ * @ret rc		Return status code
+ *
+ * Transmits as many new segments as are permitted by the receiver's
+ * window and the congestion window, or a pure ACK if there is no new
+ * data to send and an acknowledgement is pending.
+ */
+static int tcp_xmit ( struct tcp_connection *tcp ) {
+	uint32_t old_sent;
+	int rc;
+
+	do {
+		old_sent = tcp->snd_sent;
+		if ( ( rc = tcp_xmit_segment ( tcp, tcp->snd_sent,
+					       tcp_xmit_win ( tcp ) ) ) != 0 )
+			return rc;
+	} while ( tcp->snd_sent != old_sent );
+
+	return 0;
+}
+
+/**
+ * Retransmit first unacknowledged segment
+ *
+ * @v tcp		TCP connection
+ * @ret rc		Return status code
+ */
+static int tcp_retransmit ( struct tcp_connection *tcp ) {
+	size_t max_len;
+
+	/* Retransmit no more than one segment's worth of the data
+	 * already sent.
+	 */
+	max_len = tcp->snd_sent;
+	if ( max_len > TCP_PATH_MTU )
+		max_len = TCP_PATH_MTU;
+
+	DBGC ( tcp, "TCP %p retransmitting %08x..%08zx %08x cwnd %d "
+	       "ssthresh %d\n", tcp, tcp->snd_seq,
+	       ( tcp->snd_seq + max_len ), tcp->rcv_ack, tcp->cong.cwnd,
+	       tcp->cong.ssthresh );
+	return tcp_xmit_segment ( tcp, 0, max_len );
+}
+
+/**
+ * Enter loss recovery
+ *
+ * @v tcp		TCP connection
+ * @v flag		Loss recovery flag
+ *
+ * Notifies the congestion control algorithm of the loss, and records
+ * the recovery point as per RFC 6582.
+ */
+static void tcp_loss ( struct tcp_connection *tcp, unsigned int flag ) {
+
+	tcp->congestion->loss ( &tcp->cong, tcp->snd_sent );
+	tcp->recover = ( tcp->snd_seq + tcp->snd_sent );
+	tcp->flags = ( ( tcp->flags & ~TCP_RECOVERY ) | flag );
+}
+
 /**
  * Retransmission timer expired
  *
@@ -612,9 +916,21 @@ static void tcp_expired ( struct retry_timer *timer, int over ) {
 		tcp->tcp_state = TCP_CLOSED;
 		tcp_dump_state ( tcp );
 		tcp_close ( tcp, -ETIMEDOUT );
-	} else {
-		/* Otherwise, retransmit the packet */
+	} else if ( tcp->snd_sent == 0 ) {
+		/* Nothing is outstanding, so this is not a loss: the
+		 * timer was started by tcp_open() purely to trigger
+		 * transmission of the initial SYN.  Just transmit.
+		 */
 		tcp_xmit ( tcp );
+	} else {
+		/* Otherwise, collapse the congestion window to a
+		 * single segment and retransmit the first
+		 * unacknowledged segment, as per RFC 5681.
+		 */
+		tcp_loss ( tcp, TCP_RTO_RECOVERY );
+		tcp->cong.cwnd = TCP_PATH_MTU;
+		tcp->dup_acks = 0;
+		tcp_retransmit ( tcp );
 	}
 }
 
@@ -671,8 +987,7 @@ static int tcp_xmit_reset ( struct tcp_connection *tcp,
 	tcphdr->ack = in_tcphdr->seq;
 	tcphdr->hlen = ( ( sizeof ( *tcphdr ) / 4 ) << 4 );
 	tcphdr->flags = ( TCP_RST | TCP_ACK );
-	tcphdr->win = htons ( TCP_MAX_WINDOW_SIZE );
-	tcphdr->csum = tcpip_chksum ( iobuf->data, iob_len ( iobuf ) );
+	tcphdr->win = htons ( 0 );
 
 	/* Dump header */
 	DBGC2 ( tcp, "TCP %p TX %d->%d %08x..%08x           %08x %4d",
@@ -746,6 +1061,21 @@ static void tcp_rx_opts ( struct tcp_connection *tcp, const void *data,
 		case TCP_OPTION_MSS:
 			options->mssopt = data;
 			break;
+		case TCP_OPTION_WS:
+			options->wsopt = data;
+			break;
+		case TCP_OPTION_SACK_PERMITTED:
+			options->spopt = data;
+			break;
+		case TCP_OPTION_SACK:
+			/* Ignore received SACKs.  Several segments may
+			 * be in flight, but losses are recovered using
+			 * NewReno partial acknowledgements (RFC 6582),
+			 * which retransmit one missing segment per
+			 * round trip.  A sender may legitimately take
+			 * no account of SACK information (RFC 2018).
+			 */
+			break;
 		case TCP_OPTION_TS:
 			options->tsopt = data;
 			break;
@@ -802,6 +1132,17 @@ static int tcp_rx_syn ( struct tcp_connection *tcp, uint32_t seq,
 		tcp->rcv_ack = seq;
 		if ( options->tsopt )
 			tcp->flags |= TCP_TS_ENABLED;
+		if ( options->wsopt ) {
+			/* Window scaling is in use only if both ends
+			 * have sent the window scale option.
+			 */
+			tcp->snd_win_scale = options->wsopt->scale;
+			if ( tcp->snd_win_scale > TCP_MAX_WINDOW_SCALE )
+				tcp->snd_win_scale = TCP_MAX_WINDOW_SCALE;
+			tcp->rcv_win_scale = TCP_RX_WINDOW_SCALE;
+		}
+		if ( options->spopt )
+			tcp->flags |= TCP_SACK_ENABLED;
 	}
 
 	/* Ignore duplicate SYN */
@@ -818,16 +1159,48 @@ static int tcp_rx_syn ( struct tcp_connection *tcp, uint32_t seq,
 	return 0;
 }
 
+/**
+ * Handle TCP received duplicate ACK
+ *
+ * @v tcp		TCP connection
+ *
+ * Implements fast retransmission and fast recovery as per RFC 5681
+ * and RFC 6582.
+ */
+static void tcp_rx_dup_ack ( struct tcp_connection *tcp ) {
+
+	tcp->dup_acks++;
+
+	if ( tcp->flags & TCP_FAST_RECOVERY ) {
+		/* Inflate congestion window to reflect the
+		 * additional segment that has left the network.
+		 */
+		tcp->cong.cwnd += TCP_PATH_MTU;
+	} else if ( ( tcp->dup_acks == TCP_DUP_ACK_THRESHOLD ) &&
+		    ! ( tcp->flags & TCP_RECOVERY ) ) {
+		/* Enter fast recovery and retransmit the apparently
+		 * missing segment.
+		 */
+		DBGC ( tcp, "TCP %p received %d duplicate ACKs for %08x\n",
+		       tcp, tcp->dup_acks, tcp->snd_seq );
+		tcp_loss ( tcp, TCP_FAST_RECOVERY );
+		tcp->cong.cwnd = ( tcp->cong.ssthresh +
+				   ( TCP_DUP_ACK_THRESHOLD * TCP_PATH_MTU ) );
+		tcp_retransmit ( tcp );
+	}
+}
+
 /**
  * Handle TCP received ACK
  *
  * @v tcp		TCP connection
  * @v ack		ACK value (in host-endian order)
  * @v win		WIN value (in host-endian order)
+ * @v seq_len		Sequence space length of received packet
  * @ret rc		Return status code
  */
 static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
-			uint32_t win ) {
+			uint32_t win, uint32_t seq_len ) {
 	uint32_t ack_len = ( ack - tcp->snd_seq );
 	size_t len;
 	unsigned int acked_flags;
@@ -851,17 +1224,31 @@ static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
 		}
 	}
 
-	/* Ignore ACKs that don't actually acknowledge any new data.
-	 * (In particular, do not stop the retransmission timer; this
-	 * avoids creating a sorceror's apprentice syndrome when a
-	 * duplicate ACK is received and we still have data in our
-	 * transmit queue.)
+	/* Ignore ACKs that don't actually acknowledge any new data,
+	 * other than to record window updates and to count duplicate
+	 * ACKs as defined in RFC 5681.  (In particular, do not stop
+	 * the retransmission timer; this avoids creating a sorceror's
+	 * apprentice syndrome when a duplicate ACK is received and we
+	 * still have data in our transmit queue.)
 	 */
-	if ( ack_len == 0 )
+	if ( ack_len == 0 ) {
+		if ( win != tcp->snd_win ) {
+			tcp->snd_win = win;
+		} else if ( tcp->snd_sent && ( seq_len == 0 ) ) {
+			tcp_rx_dup_ack ( tcp );
+		}
 		return 0;
+	}
 
-	/* Stop the retransmission timer */
-	stop_timer ( &tcp->timer );
+	/* Stop the retransmission timer if all outstanding data has
+	 * been acknowledged (thereby updating the round-trip time
+	 * estimate), otherwise restart it as per RFC 6298.
+	 */
+	if ( ack_len == tcp->snd_sent ) {
+		stop_timer ( &tcp->timer );
+	} else {
+		start_timer ( &tcp->timer );
+	}
 
 	/* Determine acknowledged flags and data length */
 	len = ack_len;
@@ -872,11 +1259,12 @@ static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
 
 	/* Update SEQ and sent counters, and window size */
 	tcp->snd_seq = ack;
-	tcp->snd_sent = 0;
+	tcp->snd_sent -= ack_len;
 	tcp->snd_win = win;
+	tcp->dup_acks = 0;
 
 	/* Remove any acknowledged data from transmit queue */
-	tcp_process_tx_queue ( tcp, len, NULL, 1 );
+	tcp_process_tx_queue ( tcp, 0, len, NULL, 1 );
 		
 	/* Mark SYN/FIN as acknowledged if applicable. */
 	if ( acked_flags )
@@ -886,6 +1274,33 @@ static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
 	if ( list_empty ( &tcp->tx_queue ) && ( tcp->flags & TCP_XFER_CLOSED ) )
 		tcp->tcp_state |= TCP_STATE_SENT ( TCP_FIN );
 
+	/* Update congestion window */
+	if ( ! ( tcp->flags & TCP_RECOVERY ) ) {
+		/* Not recovering from a loss: grow window */
+		tcp->congestion->ack ( &tcp->cong, len );
+	} else if ( tcp_cmp ( ack, tcp->recover ) >= 0 ) {
+		/* Full acknowledgement: exit loss recovery, deflating
+		 * the window if we were in fast recovery.
+		 */
+		if ( ( tcp->flags & TCP_FAST_RECOVERY ) &&
+		     ( tcp->cong.cwnd > tcp->cong.ssthresh ) ) {
+			tcp->cong.cwnd = tcp->cong.ssthresh;
+		}
+		tcp->flags &= ~TCP_RECOVERY;
+	} else {
+		/* Partial acknowledgement: the next unacknowledged
+		 * segment has also been lost.
+		 */
+		if ( tcp->flags & TCP_FAST_RECOVERY ) {
+			tcp->cong.cwnd -= ( ( tcp->cong.cwnd > len ) ?
+					    len : tcp->cong.cwnd );
+			tcp->cong.cwnd += TCP_PATH_MTU;
+		} else {
+			tcp->congestion->ack ( &tcp->cong, len );
+		}
+		tcp_retransmit ( tcp );
+	}
+
 	return 0;
 }
 
@@ -1026,6 +1441,9 @@ static void tcp_rx_enqueue ( struct tcp_connection *tcp, uint32_t seq,
 	tcpqhdr->seq = seq;
 	tcpqhdr->flags = flags;
 
+	/* Record as most recently received segment for SACK */
+	tcp->sack_seq = seq;
+
 	/* Add to RX queue */
 	list_for_each_entry ( queued, &tcp->rx_queue, list ) {
 		tcpqhdr = queued->data;
@@ -1079,6 +1497,65 @@ static void tcp_process_rx_queue ( struct tcp_connection *tcp ) {
 	}
 }
 
+/**
+ * Attempt fast-path delivery of received data
+ *
+ * @v tcp		TCP connection, or NULL
+ * @v iobuf		I/O buffer
+ * @v hlen		Length of TCP header
+ * @v pshdr_csum	Pseudo-header checksum
+ * @ret len		Length of data delivered
+ *
+ * An in-order segment carrying only data may be handed directly to
+ * the application via xfer_deliver_chksum(), so that the segment's
+ * checksum is verified in the same pass as copying the data to its
+ * final destination.  The header fields used to select the fast path
+ * have not yet been verified at this point; this is safe since the
+ * application will decline the data unless the checksum over the
+ * whole segment is correct.  A declined segment may leave stale bytes
+ * in the application's buffer beyond the data it has accepted, but
+ * these are never reported as received, and will be overwritten when
+ * the segment is retransmitted.
+ *
+ * If the data is delivered, it is stripped from the I/O buffer and
+ * the checksum is known to be correct.  The caller must then
+ * acknowledge the delivered sequence space.
+ */
+static size_t tcp_rx_fast ( struct tcp_connection *tcp,
+			    struct io_buffer *iobuf, size_t hlen,
+			    uint16_t pshdr_csum ) {
+	struct tcp_header *tcphdr = iobuf->data;
+	size_t len = ( iob_len ( iobuf ) - hlen );
+	uint16_t csum;
+
+	/* Use fast path only for in-order data-only segments, with
+	 * nothing already queued.
+	 */
+	if ( ( ! tcp ) ||
+	     ( ( tcp->tcp_state & ( TCP_STATE_RCVD ( TCP_SYN ) |
+				    TCP_STATE_RCVD ( TCP_FIN ) ) ) !=
+	       TCP_STATE_RCVD ( TCP_SYN ) ) ||
+	     ( tcphdr->flags & ~( TCP_ACK | TCP_PSH ) ) ||
+	     ( ntohl ( tcphdr->seq ) != tcp->rcv_ack ) ||
+	     ( len == 0 ) || ( len > tcp->rcv_win ) ||
+	     ( ! list_empty ( &tcp->rx_queue ) ) ) {
+		return 0;
+	}
+
+	/* Calculate checksum over pseudo-header and TCP header */
+	csum = tcpip_continue_chksum ( pshdr_csum, tcphdr, hlen );
+
+	/* Offer data to application */
+	if ( xfer_deliver_chksum ( &tcp->xfer, ( iobuf->data + hlen ), len,
+				   csum ) != 0 )
+		return 0;
+
+	/* Strip delivered data */
+	iob_unput ( iobuf, len );
+
+	return len;
+}
+
 /**
  * Process received packet
  *
@@ -1102,10 +1579,13 @@ static int tcp_rx ( struct io_buffer *iobuf,
 	uint32_t win;
 	unsigned int flags;
 	size_t len;
+	size_t delivered;
 	uint32_t seq_len;
 	size_t old_xfer_window;
 	int rc;
 
+	profile_start ( &tcp_rx_profiler );
+
 	/* Sanity check packet */
 	if ( iob_len ( iobuf ) < sizeof ( *tcphdr ) ) {
 		DBG ( "TCP packet too short at %zd bytes (min %zd bytes)\n",
@@ -1126,17 +1606,29 @@ static int tcp_rx ( struct io_buffer *iobuf,
 		rc = -EINVAL;
 		goto discard;
 	}
-	csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data,
-				       iob_len ( iobuf ) );
-	if ( csum != 0 ) {
-		DBG ( "TCP checksum incorrect (is %04x including checksum "
-		      "field, should be 0000)\n", csum );
-		rc = -EINVAL;
-		goto discard;
+
+	/* Attempt fast-path delivery of data, falling back to
+	 * verifying the checksum here.  There is no need to do either
+	 * if the network device has already verified the checksum.
+	 */
+	tcp = tcp_demux ( ntohs ( tcphdr->dest ) );
+	delivered = 0;
+	if ( ! ( iobuf->flags & IOB_CSUM_VERIFIED ) ) {
+		delivered = tcp_rx_fast ( tcp, iobuf, hlen, pshdr_csum );
+		if ( ! delivered ) {
+			csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data,
+						       iob_len ( iobuf ) );
+			if ( csum != 0 ) {
+				DBG ( "TCP checksum incorrect (is %04x "
+				      "including checksum field, should be "
+				      "0000)\n", csum );
+				rc = -EINVAL;
+				goto discard;
+			}
+		}
 	}
 	
 	/* Parse parameters from header and strip header */
-	tcp = tcp_demux ( ntohs ( tcphdr->dest ) );
 	seq = ntohl ( tcphdr->seq );
 	ack = ntohl ( tcphdr->ack );
 	win = ntohs ( tcphdr->win );
@@ -1146,7 +1638,7 @@ static int tcp_rx ( struct io_buffer *iobuf,
 	if ( options.tsopt )
 		tcp->ts_val = ntohl ( options.tsopt->tsval );
 	iob_pull ( iobuf, hlen );
-	len = iob_len ( iobuf );
+	len = ( delivered + iob_len ( iobuf ) );
 	seq_len = ( len + ( ( flags & TCP_SYN ) ? 1 : 0 ) +
 		    ( ( flags & TCP_FIN ) ? 1 : 0 ) );
 
@@ -1165,12 +1657,24 @@ static int tcp_rx ( struct io_buffer *iobuf,
 		goto discard;
 	}
 
+	/* Apply peer's window scale.  The window field within a SYN
+	 * is never scaled.
+	 */
+	if ( ! ( flags & TCP_SYN ) )
+		win <<= tcp->snd_win_scale;
+
+	/* Acknowledge any data delivered via the fast path */
+	if ( delivered ) {
+		tcp_rx_seq ( tcp, delivered );
+		seq += delivered;
+	}
+
 	/* Record old data-transfer window */
 	old_xfer_window = tcp_xfer_window ( tcp );
 
 	/* Handle ACK, if present */
 	if ( flags & TCP_ACK ) {
-		if ( ( rc = tcp_rx_ack ( tcp, ack, win ) ) != 0 ) {
+		if ( ( rc = tcp_rx_ack ( tcp, ack, win, seq_len ) ) != 0 ) {
 			tcp_xmit_reset ( tcp, st_src, tcphdr );
 			goto discard;
 		}
@@ -1218,11 +1722,13 @@ static int tcp_rx ( struct io_buffer *iobuf,
 	if ( tcp_xfer_window ( tcp ) != old_xfer_window )
 		xfer_window_changed ( &tcp->xfer );
 
+	profile_stop ( &tcp_rx_profiler );
 	return 0;
 
  discard:
 	/* Free received packet */
 	free_iob ( iobuf );
+	profile_stop ( &tcp_rx_profiler );
 	return rc;
 }
 
@@ -35,6 +35,10 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <assert.h>
 #include <ipxe/uri.h>
 #include <ipxe/refcnt.h>
+#include <ipxe/list.h>
+#include <ipxe/malloc.h>
+#include <ipxe/timer.h>
+#include <ipxe/retry.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
@@ -42,14 +46,23 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/tcpip.h>
 #include <ipxe/process.h>
 #include <ipxe/linebuf.h>
+#include <ipxe/vsprintf.h>
 #include <ipxe/base64.h>
 #include <ipxe/blockdev.h>
 #include <ipxe/acpi.h>
+#include <ipxe/settings.h>
+#include <ipxe/dhcp.h>
 #include <ipxe/http.h>
 
 /** Block size used for HTTP block device request */
 #define HTTP_BLKSIZE 512
 
+/** Maximum number of outstanding partial reads per connection
+ *
+ * Partial reads are issued as pipelined HTTP/1.1 range requests.
+ */
+#define HTTP_PIPELINE_DEPTH 4
+
 /** HTTP flags */
 enum http_flags {
 	/** Request is waiting to be transmitted */
@@ -58,6 +71,16 @@ enum http_flags {
 	HTTP_HEAD_ONLY = 0x0002,
 	/** Keep connection alive */
 	HTTP_KEEPALIVE = 0x0004,
+	/** Return connection to pool on completion */
+	HTTP_POOL = 0x0008,
+	/** Connection was taken from pool */
+	HTTP_REUSED = 0x0010,
+	/** Request has been redirected */
+	HTTP_REDIRECTED = 0x0020,
+	/** Server accepts byte range requests */
+	HTTP_RANGES = 0x0040,
+	/** Report length only if server accepts byte range requests */
+	HTTP_RANGE_PROBE = 0x0080,
 };
 
 /** HTTP receive state */
@@ -71,6 +94,20 @@ enum http_rx_state {
 	HTTP_RX_DEAD,
 };
 
+/** An HTTP partial read */
+struct http_read {
+	/** HTTP request */
+	struct http_request *http;
+	/** Partial transfer interface */
+	struct interface partial;
+	/** Starting offset */
+	size_t offset;
+	/** Length (or 0 to fetch header only) */
+	size_t len;
+	/** Data buffer */
+	userptr_t buffer;
+};
+
 /**
  * An HTTP request
  *
@@ -80,11 +117,13 @@ struct http_request {
 	struct refcnt refcnt;
 	/** Data transfer interface */
 	struct interface xfer;
-	/** Partial transfer interface */
-	struct interface partial;
 
 	/** URI being fetched */
 	struct uri *uri;
+	/** Default port number */
+	unsigned int default_port;
+	/** Filter to apply to socket, or NULL */
+	int ( * filter ) ( struct interface *xfer, struct interface **next );
 	/** Transport layer interface */
 	struct interface socket;
 
@@ -95,6 +134,15 @@ struct http_request {
 	/** Length of partial transfer (if applicable) */
 	size_t partial_len;
 
+	/** Partial reads */
+	struct http_read reads[HTTP_PIPELINE_DEPTH];
+	/** Partial read producer counter */
+	unsigned int read_prod;
+	/** Partial read transmit consumer counter */
+	unsigned int read_tx;
+	/** Partial read receive consumer counter */
+	unsigned int read_rx;
+
 	/** TX process */
 	struct process process;
 
@@ -102,8 +150,12 @@ struct http_request {
 	enum http_rx_state rx_state;
 	/** Received length */
 	size_t rx_len;
+	/** Content length (or 0 if unknown) */
+	size_t content_len;
 	/** Length remaining (or 0 if unknown) */
 	size_t remaining;
+	/** Content encoding (if applicable) */
+	struct http_content_encoding *encoding;
 	/** HTTP is using Transfer-Encoding: chunked */
 	int chunked;
 	/** Current chunk length remaining (if applicable) */
@@ -128,6 +180,249 @@ static void http_free ( struct refcnt *refcnt ) {
 	free ( http );
 };
 
+/** Maximum number of idle pooled HTTP connections */
+#define HTTP_POOL_MAX 16
+
+/** Idle timeout for pooled HTTP connections
+ *
+ * This is shorter than the default keep-alive timeout used by common
+ * web servers (e.g. five seconds for Apache), to minimise the chance
+ * of reusing a connection that the server is about to close.
+ */
+#define HTTP_POOL_TIMEOUT ( 4 * TICKS_PER_SEC )
+
+/** An idle pooled HTTP connection */
+struct http_connection {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** List of idle pooled connections */
+	struct list_head list;
+	/** Transport layer interface */
+	struct interface socket;
+	/** Idle timer */
+	struct retry_timer timer;
+	/** URI from which scheme and host were taken */
+	struct uri *uri;
+	/** Port number */
+	unsigned int port;
+};
+
+/** Idle pooled HTTP connections, most recently used first */
+static LIST_HEAD ( http_pool );
+
+/** Number of idle pooled HTTP connections */
+static unsigned int http_pool_count;
+
+/**
+ * Free pooled HTTP connection
+ *
+ * @v refcnt		Reference counter
+ */
+static void http_connection_free ( struct refcnt *refcnt ) {
+	struct http_connection *conn =
+		container_of ( refcnt, struct http_connection, refcnt );
+
+	uri_put ( conn->uri );
+	free ( conn );
+}
+
+/**
+ * Close pooled HTTP connection
+ *
+ * @v conn		Pooled HTTP connection
+ * @v rc		Reason for close
+ */
+static void http_connection_close ( struct http_connection *conn, int rc ) {
+
+	DBGC ( conn, "HTTP %p closing idle connection to %s:%d: %s\n", conn,
+	       conn->uri->host, conn->port, strerror ( rc ) );
+
+	/* Stop idle timer */
+	stop_timer ( &conn->timer );
+
+	/* Close socket */
+	intf_shutdown ( &conn->socket, rc );
+
+	/* Remove from pool and drop pool's reference */
+	list_del ( &conn->list );
+	http_pool_count--;
+	ref_put ( &conn->refcnt );
+}
+
+/**
+ * Handle pooled HTTP connection idle timer expiry
+ *
+ * @v timer		Idle timer
+ * @v over		Failure indicator
+ */
+static void http_connection_expired ( struct retry_timer *timer,
+				      int over __unused ) {
+	struct http_connection *conn =
+		container_of ( timer, struct http_connection, timer );
+
+	http_connection_close ( conn, 0 );
+}
+
+/**
+ * Handle data received on idle pooled HTTP connection
+ *
+ * @v conn		Pooled HTTP connection
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int http_connection_deliver ( struct http_connection *conn,
+				     struct io_buffer *iobuf,
+				     struct xfer_metadata *meta __unused ) {
+
+	/* Receiving any data while idle is an error */
+	DBGC ( conn, "HTTP %p received %zd bytes while idle\n",
+	       conn, iob_len ( iobuf ) );
+	free_iob ( iobuf );
+	http_connection_close ( conn, -EPROTO );
+	return -EPROTO;
+}
+
+/** Pooled HTTP connection socket interface operations */
+static struct interface_operation http_connection_operations[] = {
+	INTF_OP ( xfer_deliver, struct http_connection *,
+		  http_connection_deliver ),
+	INTF_OP ( intf_close, struct http_connection *,
+		  http_connection_close ),
+};
+
+/** Pooled HTTP connection socket interface descriptor */
+static struct interface_descriptor http_connection_desc =
+	INTF_DESC ( struct http_connection, socket,
+		    http_connection_operations );
+
+/**
+ * Return HTTP request's connection to pool
+ *
+ * @v http		HTTP request
+ */
+static void http_pool_add ( struct http_request *http ) {
+	struct http_connection *conn;
+
+	/* Evict least recently used connection if pool is full */
+	if ( http_pool_count >= HTTP_POOL_MAX ) {
+		conn = list_last_entry ( &http_pool, struct http_connection,
+					 list );
+		http_connection_close ( conn, 0 );
+	}
+
+	/* Allocate and initialise pooled connection */
+	conn = zalloc ( sizeof ( *conn ) );
+	if ( ! conn )
+		return;
+	ref_init ( &conn->refcnt, http_connection_free );
+	intf_init ( &conn->socket, &http_connection_desc, &conn->refcnt );
+	timer_init ( &conn->timer, http_connection_expired, &conn->refcnt );
+	conn->uri = uri_get ( http->uri );
+	conn->port = uri_port ( http->uri, http->default_port );
+
+	/* Transfer socket to pooled connection */
+	intf_plug_plug ( &conn->socket, http->socket.dest );
+	intf_unplug ( &http->socket );
+
+	/* Add to pool, transferring our reference to the pool */
+	list_add ( &conn->list, &http_pool );
+	http_pool_count++;
+	start_timer_fixed ( &conn->timer, HTTP_POOL_TIMEOUT );
+	DBGC ( conn, "HTTP %p pooled idle connection to %s:%d from %p\n",
+	       conn, conn->uri->host, conn->port, http );
+}
+
+/**
+ * Take connection for HTTP request from pool
+ *
+ * @v http		HTTP request
+ * @ret rc		Return status code
+ */
+static int http_pool_take ( struct http_request *http ) {
+	struct http_connection *conn;
+	const char *scheme = http->uri->scheme;
+	unsigned int port = uri_port ( http->uri, http->default_port );
+
+	list_for_each_entry ( conn, &http_pool, list ) {
+
+		/* Skip connections to different servers */
+		if ( ( conn->port != port ) ||
+		     ( strcasecmp ( conn->uri->host, http->uri->host ) != 0 ) )
+			continue;
+		if ( ( scheme == NULL ) != ( conn->uri->scheme == NULL ) )
+			continue;
+		if ( scheme && ( strcmp ( conn->uri->scheme, scheme ) != 0 ) )
+			continue;
+
+		/* Transfer socket to HTTP request */
+		DBGC ( http, "HTTP %p reusing idle connection %p\n",
+		       http, conn );
+		stop_timer ( &conn->timer );
+		intf_plug_plug ( &http->socket, conn->socket.dest );
+		intf_unplug ( &conn->socket );
+
+		/* Remove from pool and drop pool's reference */
+		list_del ( &conn->list );
+		http_pool_count--;
+		ref_put ( &conn->refcnt );
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
+/**
+ * Discard some cached HTTP data
+ *
+ * @ret discarded	Number of cached items discarded
+ */
+static unsigned int http_discard ( void ) {
+	struct http_connection *conn;
+
+	/* Close least recently used idle connection */
+	list_for_each_entry_reverse ( conn, &http_pool, list ) {
+		http_connection_close ( conn, 0 );
+		return 1;
+	}
+
+	return 0;
+}
+
+/** HTTP cache discarder */
+struct cache_discarder http_cache_discarder __cache_discarder = {
+	.discard = http_discard,
+};
+
+/**
+ * Get partial read currently being received
+ *
+ * @v http		HTTP request
+ * @ret read		Partial read
+ *
+ * This is meaningful only if @c read_rx differs from @c read_prod.
+ */
+static inline struct http_read * http_rx_read ( struct http_request *http ) {
+	return &http->reads[ http->read_rx % HTTP_PIPELINE_DEPTH ];
+}
+
+/**
+ * Start receiving response to next partial read
+ *
+ * @v http		HTTP request
+ */
+static void http_rx_next ( struct http_request *http ) {
+	struct http_read *read = http_rx_read ( http );
+
+	DBGC ( http, "HTTP %p awaiting response for range %zd+%zd\n",
+	       http, read->offset, read->len );
+	http->rx_state = HTTP_RX_RESPONSE;
+	http->rx_buffer = read->buffer;
+	http->remaining = read->len;
+	http->flags &= ~HTTP_HEAD_ONLY;
+	http->flags |= ( HTTP_KEEPALIVE | ( read->len ? 0 : HTTP_HEAD_ONLY ) );
+}
+
 /**
  * Close HTTP request
  *
@@ -135,6 +430,7 @@ static void http_free ( struct refcnt *refcnt ) {
  * @v rc		Return status code
  */
 static void http_close ( struct http_request *http, int rc ) {
+	unsigned int i;
 
 	/* Prevent further processing of any current packet */
 	http->rx_state = HTTP_RX_DEAD;
@@ -154,7 +450,8 @@ static void http_close ( struct http_request *http, int rc ) {
 
 	/* Close all data transfer interfaces */
 	intf_shutdown ( &http->socket, rc );
-	intf_shutdown ( &http->partial, rc );
+	for ( i = 0 ; i < HTTP_PIPELINE_DEPTH ; i++ )
+		intf_shutdown ( &http->reads[i].partial, rc );
 	intf_shutdown ( &http->xfer, rc );
 }
 
@@ -176,16 +473,32 @@ static void http_done ( struct http_request *http ) {
 	/* Enter idle state */
 	http->rx_state = HTTP_RX_IDLE;
 	http->rx_len = 0;
+	http->content_len = 0;
+	http->encoding = NULL;
 	assert ( http->remaining == 0 );
 	assert ( http->chunked == 0 );
 	assert ( http->chunk_remaining == 0 );
 
-	/* Close partial transfer interface */
-	intf_restart ( &http->partial, 0 );
+	/* Complete current partial read, if applicable */
+	if ( http->read_rx != http->read_prod ) {
+		intf_restart ( &http_rx_read ( http )->partial, 0 );
+		http->read_rx++;
+	}
 
-	/* Close everything unless we are keeping the connection alive */
-	if ( ! ( http->flags & HTTP_KEEPALIVE ) )
+	/* Close everything unless we are keeping the connection
+	 * alive, returning the connection to the pool if possible.
+	 */
+	if ( ! ( http->flags & HTTP_KEEPALIVE ) ) {
+		if ( http->flags & HTTP_POOL )
+			http_pool_add ( http );
 		http_close ( http, 0 );
+		return;
+	}
+
+	/* Start receiving next pipelined response, if applicable */
+	if ( ( http->rx_state == HTTP_RX_IDLE ) &&
+	     ( http->read_rx != http->read_prod ) )
+		http_rx_next ( http );
 }
 
 /**
@@ -239,6 +552,14 @@ static int http_rx_response ( struct http_request *http, char *response ) {
 	if ( ( rc = http_response_to_rc ( code ) ) != 0 )
 		return rc;
 
+	/* Partial content implies support for range requests */
+	if ( code == 206 )
+		http->flags |= HTTP_RANGES;
+
+	/* HTTP/1.0 servers do not keep connections alive by default */
+	if ( strncmp ( response, "HTTP/1.0", 8 ) == 0 )
+		http->flags &= ~HTTP_POOL;
+
 	/* Move to received headers */
 	http->rx_state = HTTP_RX_HEADER;
 	return 0;
@@ -262,6 +583,7 @@ static int http_rx_location ( struct http_request *http, const char *value ) {
 		       http, strerror ( rc ) );
 		return rc;
 	}
+	http->flags |= HTTP_REDIRECTED;
 
 	return 0;
 }
@@ -288,26 +610,24 @@ static int http_rx_content_length ( struct http_request *http,
 	}
 
 	/* If we already have an expected content length, and this
-	 * isn't it, then complain
+	 * isn't it, then complain.  A server that ignores the Range
+	 * header will respond with the whole resource.
 	 */
 	if ( http->remaining && ( http->remaining != content_len ) ) {
 		DBGC ( http, "HTTP %p incorrect Content-Length %zd (expected "
 		       "%zd)\n", http, content_len, http->remaining );
-		return -EIO;
+		return ( ( http->flags & HTTP_RANGES ) ? -EIO : -ENOTSUP );
 	}
+	http->content_len = content_len;
 	if ( ! ( http->flags & HTTP_HEAD_ONLY ) )
 		http->remaining = content_len;
 
-	/* Use seek() to notify recipient of filesize */
-	xfer_seek ( &http->xfer, http->remaining );
-	xfer_seek ( &http->xfer, 0 );
-
 	/* Report block device capacity if applicable */
 	if ( http->flags & HTTP_HEAD_ONLY ) {
 		capacity.blocks = ( content_len / HTTP_BLKSIZE );
 		capacity.blksize = HTTP_BLKSIZE;
 		capacity.max_count = -1U;
-		block_capacity ( &http->partial, &capacity );
+		block_capacity ( &http_rx_read ( http )->partial, &capacity );
 	}
 	return 0;
 }
@@ -330,6 +650,67 @@ static int http_rx_transfer_encoding ( struct http_request *http,
 	return 0;
 }
 
+/**
+ * Handle HTTP Content-Encoding header
+ *
+ * @v http		HTTP request
+ * @v value		HTTP header value
+ * @ret rc		Return status code
+ */
+static int http_rx_content_encoding ( struct http_request *http,
+				      const char *value ) {
+	struct http_content_encoding *encoding;
+
+	/* Identify content encoding */
+	for_each_table_entry ( encoding, HTTP_CONTENT_ENCODINGS ) {
+		if ( strcasecmp ( value, encoding->name ) == 0 ) {
+			http->encoding = encoding;
+			return 0;
+		}
+	}
+
+	/* Deliver content in any unsupported encoding unaltered */
+	DBGC ( http, "HTTP %p unsupported Content-Encoding \"%s\"\n",
+	       http, value );
+	return 0;
+}
+
+/**
+ * Handle HTTP Accept-Ranges header
+ *
+ * @v http		HTTP request
+ * @v value		HTTP header value
+ * @ret rc		Return status code
+ */
+static int http_rx_accept_ranges ( struct http_request *http,
+				   const char *value ) {
+
+	if ( strcasecmp ( value, "bytes" ) == 0 ) {
+		/* Server accepts byte range requests */
+		http->flags |= HTTP_RANGES;
+	}
+
+	return 0;
+}
+
+/**
+ * Handle HTTP Connection header
+ *
+ * @v http		HTTP request
+ * @v value		HTTP header value
+ * @ret rc		Return status code
+ */
+static int http_rx_connection ( struct http_request *http,
+				const char *value ) {
+
+	if ( strcasecmp ( value, "close" ) == 0 ) {
+		/* Server will close connection; do not reuse it */
+		http->flags &= ~HTTP_POOL;
+	}
+
+	return 0;
+}
+
 /** An HTTP header handler */
 struct http_header_handler {
 	/** Name (e.g. "Content-Length") */
@@ -359,9 +740,65 @@ static struct http_header_handler http_header_handlers[] = {
 		.header = "Transfer-Encoding",
 		.rx = http_rx_transfer_encoding,
 	},
+	{
+		.header = "Content-Encoding",
+		.rx = http_rx_content_encoding,
+	},
+	{
+		.header = "Connection",
+		.rx = http_rx_connection,
+	},
+	{
+		.header = "Accept-Ranges",
+		.rx = http_rx_accept_ranges,
+	},
 	{ NULL, NULL }
 };
 
+/**
+ * Handle end of HTTP headers
+ *
+ * @v http		HTTP request
+ * @ret rc		Return status code
+ */
+static int http_rx_headers_done ( struct http_request *http ) {
+	int rc;
+
+	/* Insert content decoder, if applicable.  The Content-Length
+	 * describes the encoded content, so is not passed on.
+	 */
+	if ( http->encoding && ( http->rx_buffer == UNULL ) &&
+	     ( ! ( http->flags & ( HTTP_HEAD_ONLY | HTTP_REDIRECTED ) ) ) ) {
+		DBGC ( http, "HTTP %p decoding %s content\n",
+		       http, http->encoding->name );
+		if ( ( rc = http->encoding->decode ( &http->xfer ) ) != 0 ) {
+			DBGC ( http, "HTTP %p could not decode %s content: "
+			       "%s\n", http, http->encoding->name,
+			       strerror ( rc ) );
+			return rc;
+		}
+		return 0;
+	}
+
+	/* A length probe is of no use if the resource cannot be
+	 * fetched using range requests.
+	 */
+	if ( ( http->flags & HTTP_RANGE_PROBE ) &&
+	     ( ! ( http->flags & HTTP_RANGES ) ) ) {
+		DBGC ( http, "HTTP %p server does not accept range requests\n",
+		       http );
+		return 0;
+	}
+
+	/* Use seek() to notify recipient of filesize */
+	if ( http->content_len ) {
+		xfer_seek ( &http->xfer, http->content_len );
+		xfer_seek ( &http->xfer, 0 );
+	}
+
+	return 0;
+}
+
 /**
  * Handle HTTP header
  *
@@ -378,6 +815,9 @@ static int http_rx_header ( struct http_request *http, char *header ) {
 	/* An empty header line marks the end of this phase */
 	if ( ! header[0] ) {
 		empty_line_buffer ( &http->linebuf );
+		if ( ( http->rx_state == HTTP_RX_HEADER ) &&
+		     ( ( rc = http_rx_headers_done ( http ) ) != 0 ) )
+			return rc;
 		if ( ( http->rx_state == HTTP_RX_HEADER ) &&
 		     ( ! ( http->flags & HTTP_HEAD_ONLY ) ) ) {
 			DBGC ( http, "HTTP %p start of data\n", http );
@@ -474,6 +914,29 @@ static struct http_line_handler http_line_handlers[] = {
 	[HTTP_RX_TRAILER]	= { .rx = http_rx_header },
 };
 
+/**
+ * Record consumption of HTTP body data
+ *
+ * @v http		HTTP request
+ * @v len		Length of data consumed
+ */
+static void http_rx_data ( struct http_request *http, size_t len ) {
+
+	http->rx_len += len;
+	if ( http->chunk_remaining ) {
+		http->chunk_remaining -= len;
+		if ( http->chunk_remaining == 0 )
+			http->rx_state = HTTP_RX_CHUNK_LEN;
+	}
+	if ( http->remaining ) {
+		http->remaining -= len;
+		if ( ( http->remaining == 0 ) &&
+		     ( http->rx_state == HTTP_RX_DATA ) ) {
+			http_done ( http );
+		}
+	}
+}
+
 /**
  * Handle new data arriving via HTTP connection
  *
@@ -534,19 +997,7 @@ static int http_socket_deliver ( struct http_request *http,
 						 iob_disown ( iobuf ) ) ) != 0 )
 					goto done;
 			}
-			http->rx_len += data_len;
-			if ( http->chunk_remaining ) {
-				http->chunk_remaining -= data_len;
-				if ( http->chunk_remaining == 0 )
-					http->rx_state = HTTP_RX_CHUNK_LEN;
-			}
-			if ( http->remaining ) {
-				http->remaining -= data_len;
-				if ( ( http->remaining == 0 ) &&
-				     ( http->rx_state == HTTP_RX_DATA ) ) {
-					http_done ( http );
-				}
-			}
+			http_rx_data ( http, data_len );
 			break;
 		case HTTP_RX_RESPONSE:
 		case HTTP_RX_HEADER:
@@ -584,6 +1035,53 @@ static int http_socket_deliver ( struct http_request *http,
 	return rc;
 }
 
+/**
+ * Handle new data arriving via HTTP connection with deferred checksum
+ *
+ * @v http		HTTP request
+ * @v data		Data
+ * @v len		Length of data
+ * @v partial		TCP/IP checksum of preceding data
+ * @ret rc		Return status code
+ *
+ * Data lying entirely within the body of the response is checksummed
+ * while being copied into the partial transfer buffer, or is passed
+ * through to our parent interface.  Anything else is declined, and
+ * will be delivered instead via http_socket_deliver().  Data with an
+ * incorrect checksum is copied but not recorded as received, and
+ * will be overwritten when it is retransmitted.
+ */
+static int http_socket_deliver_chksum ( struct http_request *http,
+					const void *data, size_t len,
+					uint16_t partial ) {
+	void *dest;
+	int rc;
+
+	/* Decline anything other than body data */
+	if ( ( http->rx_state != HTTP_RX_DATA ) ||
+	     ( http->chunk_remaining && ( http->chunk_remaining < len ) ) ||
+	     ( http->remaining && ( http->remaining < len ) ) )
+		return -ENOTSUP;
+
+	/* Copy and checksum data */
+	if ( http->rx_buffer != UNULL ) {
+		/* Copy to partial transfer buffer */
+		dest = user_to_virt ( http->rx_buffer, http->rx_len );
+		if ( tcpip_copy_chksum ( partial, dest, data, len ) != 0 )
+			return -EINVAL;
+	} else {
+		/* Pass through to caller */
+		if ( ( rc = xfer_deliver_chksum ( &http->xfer, data, len,
+						  partial ) ) != 0 )
+			return rc;
+	}
+
+	/* Record data as received */
+	http_rx_data ( http, len );
+
+	return 0;
+}
+
 /**
  * Check HTTP socket flow control window
  *
@@ -599,11 +1097,35 @@ static size_t http_socket_window ( struct http_request *http __unused ) {
 }
 
 /**
- * HTTP process
+ * Construct HTTP Accept-Encoding header value
+ *
+ * @v buf		Buffer, or NULL
+ * @v len		Length of buffer
+ * @ret len		Length of header value
+ */
+static size_t http_accept_encoding ( char *buf, size_t len ) {
+	struct http_content_encoding *encoding;
+	size_t used = 0;
+
+	for_each_table_entry ( encoding, HTTP_CONTENT_ENCODINGS ) {
+		used += ssnprintf ( ( buf ? ( buf + used ) : NULL ),
+				    ( len - used ), "%s%s",
+				    ( used ? ", " : "" ), encoding->name );
+	}
+	return used;
+}
+
+/**
+ * Transmit HTTP request
  *
  * @v http		HTTP request
+ * @v head		Fetch header only
+ * @v offset		Starting offset of partial transfer
+ * @v len		Length of partial transfer, or zero for whole resource
+ * @ret rc		Return status code
  */
-static void http_step ( struct http_request *http ) {
+static int http_tx_request ( struct http_request *http, int head,
+			     size_t offset, size_t len ) {
 	const char *host = http->uri->host;
 	const char *user = http->uri->user;
 	const char *password =
@@ -613,20 +1135,15 @@ static void http_step ( struct http_request *http ) {
 	size_t user_pw_base64_len = base64_encoded_len ( user_pw_len );
 	uint8_t user_pw[ user_pw_len + 1 /* NUL */ ];
 	char user_pw_base64[ user_pw_base64_len + 1 /* NUL */ ];
-	int rc;
 	int request_len = unparse_uri ( NULL, 0, http->uri,
 					URI_PATH_BIT | URI_QUERY_BIT );
 	char request[ request_len + 1 /* NUL */ ];
 	char range[48]; /* Enough for two 64-bit integers in decimal */
+	size_t accept_len = http_accept_encoding ( NULL, 0 );
+	char accept[ accept_len + 1 /* NUL */ ];
+	int keepalive = ( http->flags & ( HTTP_KEEPALIVE | HTTP_POOL ) );
 	int partial;
-
-	/* Do nothing if we have already transmitted the request */
-	if ( ! ( http->flags & HTTP_TX_PENDING ) )
-		return;
-
-	/* Do nothing until socket is ready */
-	if ( ! xfer_window ( &http->socket ) )
-		return;
+	int encoded;
 
 	/* Construct path?query request */
 	unparse_uri ( request, sizeof ( request ), http->uri,
@@ -642,46 +1159,94 @@ static void http_step ( struct http_request *http ) {
 		base64_encode ( user_pw, user_pw_len, user_pw_base64 );
 	}
 
-	/* Force a HEAD request if we have nowhere to send any received data */
-	if ( ( xfer_window ( &http->xfer ) == 0 ) &&
-	     ( http->rx_buffer == UNULL ) ) {
-		http->flags |= ( HTTP_HEAD_ONLY | HTTP_KEEPALIVE );
-	}
-
 	/* Determine type of request */
-	partial = ( http->partial_len != 0 );
-	snprintf ( range, sizeof ( range ), "%zd-%zd", http->partial_start,
-		   ( http->partial_start + http->partial_len - 1 ) );
+	partial = ( len != 0 );
+	snprintf ( range, sizeof ( range ), "%zd-%zd", offset,
+		   ( offset + len - 1 ) );
 
-	/* Mark request as transmitted */
-	http->flags &= ~HTTP_TX_PENDING;
+	/* Accept encoded content only for whole-resource requests */
+	http_accept_encoding ( accept, sizeof ( accept ) );
+	encoded = ( accept_len && ( ! head ) && ( ! partial ) );
 
 	/* Send GET request */
-	if ( ( rc = xfer_printf ( &http->socket,
-				  "%s %s%s HTTP/1.1\r\n"
-				  "User-Agent: iPXE/" VERSION "\r\n"
-				  "Host: %s%s%s\r\n"
-				  "%s%s%s%s%s%s%s"
-				  "\r\n",
-				  ( ( http->flags & HTTP_HEAD_ONLY ) ?
-				    "HEAD" : "GET" ),
-				  ( http->uri->path ? "" : "/" ),
-				  request, host,
-				  ( http->uri->port ?
-				    ":" : "" ),
-				  ( http->uri->port ?
-				    http->uri->port : "" ),
-				  ( ( http->flags & HTTP_KEEPALIVE ) ?
-				    "Connection: Keep-Alive\r\n" : "" ),
-				  ( partial ? "Range: bytes=" : "" ),
-				  ( partial ? range : "" ),
-				  ( partial ? "\r\n" : "" ),
-				  ( user ?
-				    "Authorization: Basic " : "" ),
-				  ( user ? user_pw_base64 : "" ),
-				  ( user ? "\r\n" : "" ) ) ) != 0 ) {
-		http_close ( http, rc );
+	return xfer_printf ( &http->socket,
+			     "%s %s%s HTTP/1.1\r\n"
+			     "User-Agent: iPXE/" VERSION "\r\n"
+			     "Host: %s%s%s\r\n"
+			     "%s%s%s%s%s%s%s%s%s%s"
+			     "\r\n",
+			     ( head ? "HEAD" : "GET" ),
+			     ( http->uri->path ? "" : "/" ),
+			     request, host,
+			     ( http->uri->port ?
+			       ":" : "" ),
+			     ( http->uri->port ?
+			       http->uri->port : "" ),
+			     ( keepalive ? "Connection: Keep-Alive\r\n" : "" ),
+			     ( partial ? "Range: bytes=" : "" ),
+			     ( partial ? range : "" ),
+			     ( partial ? "\r\n" : "" ),
+			     ( encoded ? "Accept-Encoding: " : "" ),
+			     ( encoded ? accept : "" ),
+			     ( encoded ? "\r\n" : "" ),
+			     ( user ?
+			       "Authorization: Basic " : "" ),
+			     ( user ? user_pw_base64 : "" ),
+			     ( user ? "\r\n" : "" ) );
+}
+
+/**
+ * HTTP process
+ *
+ * @v http		HTTP request
+ */
+static void http_step ( struct http_request *http ) {
+	struct http_read *read;
+	int rc;
+
+	/* Do nothing until socket is ready */
+	if ( ! xfer_window ( &http->socket ) )
+		return;
+
+	/* Transmit initial request, if applicable */
+	if ( http->flags & HTTP_TX_PENDING ) {
+
+		/* Force a HEAD request if we have nowhere to send any
+		 * received data
+		 */
+		if ( ( xfer_window ( &http->xfer ) == 0 ) &&
+		     ( http->rx_buffer == UNULL ) ) {
+			http->flags |= ( HTTP_HEAD_ONLY | HTTP_KEEPALIVE );
+		}
+
+		/* Mark request as transmitted */
+		http->flags &= ~HTTP_TX_PENDING;
+
+		/* Send request */
+		if ( ( rc = http_tx_request ( http,
+					      ( http->flags & HTTP_HEAD_ONLY ),
+					      http->partial_start,
+					      http->partial_len ) ) != 0 )
+			goto err;
+	}
+
+	/* Transmit any pending partial read requests.  Responses will
+	 * arrive in the order in which the requests were sent.
+	 */
+	while ( ( http->read_tx != http->read_prod ) &&
+		xfer_window ( &http->socket ) ) {
+		read = &http->reads[ http->read_tx % HTTP_PIPELINE_DEPTH ];
+		http->read_tx++;
+		if ( ( rc = http_tx_request ( http, ( read->len == 0 ),
+					      read->offset,
+					      read->len ) ) != 0 )
+			goto err;
 	}
+
+	return;
+
+ err:
+	http_close ( http, rc );
 }
 
 /**
@@ -692,8 +1257,17 @@ static void http_step ( struct http_request *http ) {
  */
 static size_t http_xfer_window ( struct http_request *http ) {
 
-	/* New block commands may be issued only when we are idle */
-	return ( ( http->rx_state == HTTP_RX_IDLE ) ? 1 : 0 );
+	/* New block commands may be issued only once any initial
+	 * request has completed, and only while the connection
+	 * remains alive.
+	 */
+	if ( ( http->rx_state == HTTP_RX_DEAD ) ||
+	     ( ( http->rx_state != HTTP_RX_IDLE ) &&
+	       ( http->read_rx == http->read_prod ) ) )
+		return 0;
+
+	/* Allow as many commands as there are free pipeline slots */
+	return ( HTTP_PIPELINE_DEPTH - ( http->read_prod - http->read_rx ) );
 }
 
 /**
@@ -709,26 +1283,31 @@ static size_t http_xfer_window ( struct http_request *http ) {
 static int http_partial_read ( struct http_request *http,
 			       struct interface *partial,
 			       size_t offset, userptr_t buffer, size_t len ) {
+	struct http_read *read;
 
 	/* Sanity check */
 	if ( http_xfer_window ( http ) == 0 )
 		return -EBUSY;
 
 	/* Initialise partial transfer parameters */
-	http->rx_buffer = buffer;
-	http->partial_start = offset;
-	http->partial_len = len;
-	http->remaining = len;
+	read = &http->reads[ http->read_prod % HTTP_PIPELINE_DEPTH ];
+	read->offset = offset;
+	read->len = len;
+	read->buffer = buffer;
+	http->read_prod++;
+
+	/* Start receiving response immediately if there are no other
+	 * responses outstanding
+	 */
+	if ( ( http->rx_state == HTTP_RX_IDLE ) &&
+	     ( ( http->read_prod - http->read_rx ) == 1 ) )
+		http_rx_next ( http );
 
 	/* Schedule request */
-	http->rx_state = HTTP_RX_RESPONSE;
-	http->flags = ( HTTP_TX_PENDING | HTTP_KEEPALIVE );
-	if ( ! len )
-		http->flags |= HTTP_HEAD_ONLY;
 	process_add ( &http->process );
 
 	/* Attach to parent interface and return */
-	intf_plug_plug ( &http->partial, partial );
+	intf_plug_plug ( &read->partial, partial );
 
 	return 0;
 }
@@ -785,12 +1364,77 @@ static int http_acpi_describe ( struct http_request *http,
 	return 0;
 }
 
+/**
+ * Open HTTP socket
+ *
+ * @v http		HTTP request
+ * @ret rc		Return status code
+ */
+static int http_open_socket ( struct http_request *http ) {
+	struct sockaddr_tcpip server;
+	struct interface *socket;
+	int rc;
+
+	/* Reuse an idle pooled connection, if available */
+	if ( http_pool_take ( http ) == 0 ) {
+		http->flags |= HTTP_REUSED;
+		return 0;
+	}
+
+	/* Open new socket */
+	memset ( &server, 0, sizeof ( server ) );
+	server.st_port = htons ( uri_port ( http->uri, http->default_port ) );
+	socket = &http->socket;
+	if ( http->filter ) {
+		if ( ( rc = http->filter ( socket, &socket ) ) != 0 )
+			return rc;
+	}
+	if ( ( rc = xfer_open_named_socket ( socket, SOCK_STREAM,
+					     ( struct sockaddr * ) &server,
+					     http->uri->host, NULL ) ) != 0 )
+		return rc;
+
+	return 0;
+}
+
+/**
+ * Handle HTTP socket closing
+ *
+ * @v http		HTTP request
+ * @v rc		Reason for close
+ */
+static void http_socket_close ( struct http_request *http, int rc ) {
+
+	/* Retry using another connection if a reused connection was
+	 * closed before any part of the response was received, since
+	 * the server may legitimately close an idle connection at
+	 * any time.
+	 */
+	if ( ( http->flags & HTTP_REUSED ) &&
+	     ( http->rx_state == HTTP_RX_RESPONSE ) &&
+	     ( http->linebuf.len == 0 ) ) {
+		DBGC ( http, "HTTP %p reused connection closed (%s); "
+		       "retrying\n", http, strerror ( rc ) );
+		intf_restart ( &http->socket, rc );
+		http->flags &= ~HTTP_REUSED;
+		http->flags |= HTTP_TX_PENDING;
+		if ( ( rc = http_open_socket ( http ) ) == 0 ) {
+			process_add ( &http->process );
+			return;
+		}
+	}
+
+	http_close ( http, rc );
+}
+
 /** HTTP socket interface operations */
 static struct interface_operation http_socket_operations[] = {
 	INTF_OP ( xfer_window, struct http_request *, http_socket_window ),
 	INTF_OP ( xfer_deliver, struct http_request *, http_socket_deliver ),
+	INTF_OP ( xfer_deliver_chksum, struct http_request *,
+		  http_socket_deliver_chksum ),
 	INTF_OP ( xfer_window_changed, struct http_request *, http_step ),
-	INTF_OP ( intf_close, struct http_request *, http_close ),
+	INTF_OP ( intf_close, struct http_request *, http_socket_close ),
 };
 
 /** HTTP socket interface descriptor */
@@ -798,14 +1442,26 @@ static struct interface_descriptor http_socket_desc =
 	INTF_DESC_PASSTHRU ( struct http_request, socket,
 			     http_socket_operations, xfer );
 
+/**
+ * Handle HTTP partial transfer interface closing
+ *
+ * @v read		Partial read
+ * @v rc		Reason for close
+ */
+static void http_read_close ( struct http_read *read, int rc ) {
+
+	/* Responses cannot be abandoned individually */
+	http_close ( read->http, rc );
+}
+
 /** HTTP partial transfer interface operations */
 static struct interface_operation http_partial_operations[] = {
-	INTF_OP ( intf_close, struct http_request *, http_close ),
+	INTF_OP ( intf_close, struct http_read *, http_read_close ),
 };
 
 /** HTTP partial transfer interface descriptor */
 static struct interface_descriptor http_partial_desc =
-	INTF_DESC ( struct http_request, partial, http_partial_operations );
+	INTF_DESC ( struct http_read, partial, http_partial_operations );
 
 /** HTTP data transfer interface operations */
 static struct interface_operation http_xfer_operations[] = {
@@ -827,21 +1483,25 @@ static struct process_descriptor http_process_desc =
 	PROC_DESC_ONCE ( struct http_request, process, http_step );
 
 /**
- * Initiate an HTTP connection, with optional filter
+ * Open HTTP request
  *
  * @v xfer		Data transfer interface
  * @v uri		Uniform Resource Identifier
  * @v default_port	Default port number
  * @v filter		Filter to apply to socket, or NULL
+ * @v flags		Additional request flags
+ * @v offset		Starting offset of partial transfer
+ * @v len		Length of partial transfer, or zero for whole resource
  * @ret rc		Return status code
  */
-int http_open_filter ( struct interface *xfer, struct uri *uri,
-		       unsigned int default_port,
-		       int ( * filter ) ( struct interface *xfer,
-					  struct interface **next ) ) {
+static int http_open_request ( struct interface *xfer, struct uri *uri,
+			       unsigned int default_port,
+			       int ( * filter ) ( struct interface *xfer,
+						  struct interface **next ),
+			       unsigned int flags, size_t offset, size_t len ) {
 	struct http_request *http;
-	struct sockaddr_tcpip server;
-	struct interface *socket;
+	struct http_read *read;
+	unsigned int i;
 	int rc;
 
 	/* Sanity checks */
@@ -854,23 +1514,24 @@ int http_open_filter ( struct interface *xfer, struct uri *uri,
 		return -ENOMEM;
 	ref_init ( &http->refcnt, http_free );
 	intf_init ( &http->xfer, &http_xfer_desc, &http->refcnt );
-	intf_init ( &http->partial, &http_partial_desc, &http->refcnt );
+	for ( i = 0 ; i < HTTP_PIPELINE_DEPTH ; i++ ) {
+		read = &http->reads[i];
+		read->http = http;
+		intf_init ( &read->partial, &http_partial_desc,
+			    &http->refcnt );
+	}
 	http->uri = uri_get ( uri );
+	http->default_port = default_port;
+	http->filter = filter;
 	intf_init ( &http->socket, &http_socket_desc, &http->refcnt );
 	process_init ( &http->process, &http_process_desc, &http->refcnt );
-	http->flags = HTTP_TX_PENDING;
+	http->flags = ( HTTP_TX_PENDING | HTTP_POOL | flags );
+	http->partial_start = offset;
+	http->partial_len = len;
+	http->remaining = len;
 
 	/* Open socket */
-	memset ( &server, 0, sizeof ( server ) );
-	server.st_port = htons ( uri_port ( http->uri, default_port ) );
-	socket = &http->socket;
-	if ( filter ) {
-		if ( ( rc = filter ( socket, &socket ) ) != 0 )
-			goto err;
-	}
-	if ( ( rc = xfer_open_named_socket ( socket, SOCK_STREAM,
-					     ( struct sockaddr * ) &server,
-					     uri->host, NULL ) ) != 0 )
+	if ( ( rc = http_open_socket ( http ) ) != 0 )
 		goto err;
 
 	/* Attach to parent interface, mortalise self, and return */
@@ -885,3 +1546,440 @@ int http_open_filter ( struct interface *xfer, struct uri *uri,
 	ref_put ( &http->refcnt );
 	return rc;
 }
+
+/** Maximum number of parallel HTTP streams */
+#define HTTP_MAX_STREAMS 16
+
+/** Number of parallel HTTP streams setting */
+struct setting http_streams_setting __setting ( SETTING_MISC ) = {
+	.name = "http-streams",
+	.description = "HTTP parallel streams",
+	.tag = DHCP_EB_HTTP_STREAMS,
+	.type = &setting_type_uint8,
+};
+
+/** A stream within a parallel HTTP download */
+struct http_stream {
+	/** Parallel HTTP download */
+	struct http_parallel *parallel;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Starting offset of stripe */
+	size_t start;
+	/** Current position within stripe */
+	size_t pos;
+};
+
+/**
+ * A parallel HTTP download
+ *
+ * The length of the resource is first determined using a HEAD
+ * request.  The resource is then divided into stripes, each of which
+ * is fetched using a separate HTTP range request.  Data from each
+ * stripe is delivered to the parent interface with an absolute
+ * offset.
+ *
+ * If the server does not accept range requests, or if the resource
+ * is too short to be worth dividing, then the whole resource is
+ * fetched using a single ordinary request.
+ */
+struct http_parallel {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Data transfer interface */
+	struct interface xfer;
+
+	/** URI being fetched */
+	struct uri *uri;
+	/** Default port number */
+	unsigned int default_port;
+	/** Filter to apply to socket, or NULL */
+	int ( * filter ) ( struct interface *xfer, struct interface **next );
+
+	/** Length of resource (or 0 if not using range requests) */
+	size_t len;
+	/** Maximum number of streams */
+	unsigned int max;
+	/** Number of streams in use (or 0 while determining length) */
+	unsigned int count;
+	/** Number of streams still open */
+	unsigned int active;
+	/** Streams */
+	struct http_stream stream[0];
+};
+
+/**
+ * Free parallel HTTP download
+ *
+ * @v refcnt		Reference counter
+ */
+static void http_parallel_free ( struct refcnt *refcnt ) {
+	struct http_parallel *parallel =
+		container_of ( refcnt, struct http_parallel, refcnt );
+
+	uri_put ( parallel->uri );
+	free ( parallel );
+}
+
+/**
+ * Close parallel HTTP download
+ *
+ * @v parallel		Parallel HTTP download
+ * @v rc		Reason for close
+ */
+static void http_parallel_close ( struct http_parallel *parallel, int rc ) {
+	unsigned int i;
+
+	/* Close all data transfer interfaces */
+	for ( i = 0 ; i < parallel->max ; i++ )
+		intf_shutdown ( &parallel->stream[i].xfer, rc );
+	intf_shutdown ( &parallel->xfer, rc );
+}
+
+/**
+ * Calculate number of stripes for parallel HTTP download
+ *
+ * @v len		Length of resource (or 0 if not using range requests)
+ * @v max		Maximum number of streams
+ * @ret count		Number of stripes, or 0 to use a single request
+ */
+unsigned int http_stripes ( size_t len, unsigned int max ) {
+	unsigned int count;
+
+	count = ( len / HTTP_MIN_STRIPE_LEN );
+	if ( count > max )
+		count = max;
+	return ( ( count > 1 ) ? count : 0 );
+}
+
+/**
+ * Fetch whole resource using a single ordinary request
+ *
+ * @v parallel		Parallel HTTP download
+ */
+static void http_parallel_fallback ( struct http_parallel *parallel ) {
+	struct http_stream *stream = &parallel->stream[0];
+	unsigned int i;
+	int rc;
+
+	/* Abandon any stripes already in progress */
+	for ( i = 0 ; i < parallel->max ; i++ )
+		intf_restart ( &parallel->stream[i].xfer, -ECANCELED );
+
+	/* Restart from the beginning of the resource */
+	xfer_seek ( &parallel->xfer, 0 );
+
+	/* Open a single request, passing data through unaltered */
+	DBGC ( parallel, "HTTP %p fetching using a single request\n",
+	       parallel );
+	parallel->len = 0;
+	parallel->count = 1;
+	parallel->active = 0;
+	stream->start = 0;
+	stream->pos = 0;
+	if ( ( rc = http_open_request ( &stream->xfer, parallel->uri,
+					parallel->default_port,
+					parallel->filter, 0, 0, 0 ) ) != 0 ) {
+		DBGC ( parallel, "HTTP %p could not open stream: %s\n",
+		       parallel, strerror ( rc ) );
+		http_parallel_close ( parallel, rc );
+		return;
+	}
+	parallel->active++;
+}
+
+/**
+ * Start fetching stripes of parallel HTTP download
+ *
+ * @v parallel		Parallel HTTP download
+ */
+static void http_parallel_start ( struct http_parallel *parallel ) {
+	struct http_stream *stream;
+	size_t stripe_len;
+	size_t len;
+	unsigned int count;
+	unsigned int i;
+	int rc;
+
+	/* Divide resource into stripes, if applicable */
+	count = http_stripes ( parallel->len, parallel->max );
+	if ( ! count ) {
+		http_parallel_fallback ( parallel );
+		return;
+	}
+	stripe_len = ( ( parallel->len + count - 1 ) / count );
+	parallel->count = count;
+	DBGC ( parallel, "HTTP %p fetching %zd bytes using %d streams\n",
+	       parallel, parallel->len, count );
+
+	/* Use seek() to notify recipient of filesize */
+	xfer_seek ( &parallel->xfer, parallel->len );
+	xfer_seek ( &parallel->xfer, 0 );
+
+	/* Open a range request for each stripe */
+	for ( i = 0 ; i < count ; i++ ) {
+		stream = &parallel->stream[i];
+		stream->start = ( i * stripe_len );
+		stream->pos = 0;
+		len = ( parallel->len - stream->start );
+		if ( len > stripe_len )
+			len = stripe_len;
+		if ( ( rc = http_open_request ( &stream->xfer, parallel->uri,
+						parallel->default_port,
+						parallel->filter, 0,
+						stream->start, len ) ) != 0 ) {
+			DBGC ( parallel, "HTTP %p could not open stream %d: "
+			       "%s\n", parallel, i, strerror ( rc ) );
+			http_parallel_close ( parallel, rc );
+			return;
+		}
+		parallel->active++;
+	}
+}
+
+/**
+ * Handle data received via parallel HTTP download stream
+ *
+ * @v stream		Parallel HTTP download stream
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int http_stream_deliver ( struct http_stream *stream,
+				 struct io_buffer *iobuf,
+				 struct xfer_metadata *meta ) {
+	struct http_parallel *parallel = stream->parallel;
+	struct xfer_metadata stripe_meta;
+	size_t len = iob_len ( iobuf );
+
+	/* While determining the length, the only thing of interest
+	 * is the filesize notification.
+	 */
+	if ( ! parallel->count ) {
+		if ( ( meta->flags & XFER_FL_ABS_OFFSET ) &&
+		     ( meta->offset > ( off_t ) parallel->len ) )
+			parallel->len = meta->offset;
+		free_iob ( iobuf );
+		return 0;
+	}
+
+	/* Pass through data from a single ordinary request */
+	if ( ! parallel->len )
+		return xfer_deliver ( &parallel->xfer, iobuf, meta );
+
+	/* Update position within stripe */
+	if ( meta->flags & XFER_FL_ABS_OFFSET )
+		stream->pos = 0;
+	stream->pos += meta->offset;
+
+	/* Discard filesize notifications, which refer only to the
+	 * length of the stripe.
+	 */
+	if ( ! len ) {
+		free_iob ( iobuf );
+		return 0;
+	}
+
+	/* Deliver data at its absolute position within the resource */
+	memset ( &stripe_meta, 0, sizeof ( stripe_meta ) );
+	stripe_meta.flags = XFER_FL_ABS_OFFSET;
+	stripe_meta.offset = ( stream->start + stream->pos );
+	stream->pos += len;
+	return xfer_deliver ( &parallel->xfer, iobuf, &stripe_meta );
+}
+
+/**
+ * Check parallel HTTP download stream flow control window
+ *
+ * @v stream		Parallel HTTP download stream
+ * @ret len		Length of window
+ */
+static size_t http_stream_window ( struct http_stream *stream ) {
+
+	return xfer_window ( &stream->parallel->xfer );
+}
+
+/**
+ * Handle parallel HTTP download stream redirection
+ *
+ * @v stream		Parallel HTTP download stream
+ * @v type		New location type
+ * @v args		Remaining arguments depend upon location type
+ * @ret rc		Return status code
+ */
+static int http_stream_vredirect ( struct http_stream *stream, int type,
+				   va_list args ) {
+
+	/* Redirect the download as a whole */
+	return xfer_vredirect ( &stream->parallel->xfer, type, args );
+}
+
+/**
+ * Handle parallel HTTP download stream closing
+ *
+ * @v stream		Parallel HTTP download stream
+ * @v rc		Reason for close
+ */
+static void http_stream_close ( struct http_stream *stream, int rc ) {
+	struct http_parallel *parallel = stream->parallel;
+
+	/* Close stream */
+	intf_restart ( &stream->xfer, rc );
+
+	/* Fall back to a single ordinary request if the length could
+	 * not be determined (e.g. because the server rejects HEAD
+	 * requests), or if the server ignores range requests.
+	 */
+	if ( ( rc != 0 ) &&
+	     ( ( ! parallel->count ) ||
+	       ( parallel->len && ( rc == -ENOTSUP ) ) ) ) {
+		DBGC ( parallel, "HTTP %p stream %d failed: %s\n", parallel,
+		       ( ( int ) ( stream - parallel->stream ) ),
+		       strerror ( rc ) );
+		http_parallel_fallback ( parallel );
+		return;
+	}
+
+	/* Abort download on any other error */
+	if ( rc != 0 ) {
+		DBGC ( parallel, "HTTP %p stream %d failed: %s\n", parallel,
+		       ( ( int ) ( stream - parallel->stream ) ),
+		       strerror ( rc ) );
+		http_parallel_close ( parallel, rc );
+		return;
+	}
+
+	/* Start fetching stripes once length has been determined */
+	if ( ! parallel->count ) {
+		http_parallel_start ( parallel );
+		return;
+	}
+
+	/* Finish download once all stripes have been fetched */
+	assert ( parallel->active > 0 );
+	if ( --parallel->active == 0 )
+		http_parallel_close ( parallel, 0 );
+}
+
+/** Parallel HTTP download stream interface operations */
+static struct interface_operation http_stream_operations[] = {
+	INTF_OP ( xfer_deliver, struct http_stream *, http_stream_deliver ),
+	INTF_OP ( xfer_window, struct http_stream *, http_stream_window ),
+	INTF_OP ( xfer_vredirect, struct http_stream *,
+		  http_stream_vredirect ),
+	INTF_OP ( intf_close, struct http_stream *, http_stream_close ),
+};
+
+/** Parallel HTTP download stream interface descriptor */
+static struct interface_descriptor http_stream_desc =
+	INTF_DESC ( struct http_stream, xfer, http_stream_operations );
+
+/** Parallel HTTP download data transfer interface operations */
+static struct interface_operation http_parallel_operations[] = {
+	INTF_OP ( intf_close, struct http_parallel *, http_parallel_close ),
+};
+
+/** Parallel HTTP download data transfer interface descriptor */
+static struct interface_descriptor http_parallel_desc =
+	INTF_DESC ( struct http_parallel, xfer, http_parallel_operations );
+
+/**
+ * Open parallel HTTP download
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		Uniform Resource Identifier
+ * @v default_port	Default port number
+ * @v filter		Filter to apply to socket, or NULL
+ * @v max		Maximum number of streams
+ * @ret rc		Return status code
+ */
+static int http_parallel_open ( struct interface *xfer, struct uri *uri,
+				unsigned int default_port,
+				int ( * filter ) ( struct interface *xfer,
+						   struct interface **next ),
+				unsigned int max ) {
+	struct http_parallel *parallel;
+	struct http_stream *stream;
+	unsigned int i;
+	int rc;
+
+	/* Allocate and initialise structure */
+	parallel = zalloc ( sizeof ( *parallel ) +
+			    ( max * sizeof ( parallel->stream[0] ) ) );
+	if ( ! parallel )
+		return -ENOMEM;
+	ref_init ( &parallel->refcnt, http_parallel_free );
+	intf_init ( &parallel->xfer, &http_parallel_desc, &parallel->refcnt );
+	parallel->uri = uri_get ( uri );
+	parallel->default_port = default_port;
+	parallel->filter = filter;
+	parallel->max = max;
+	for ( i = 0 ; i < max ; i++ ) {
+		stream = &parallel->stream[i];
+		stream->parallel = parallel;
+		intf_init ( &stream->xfer, &http_stream_desc,
+			    &parallel->refcnt );
+	}
+
+	/* Determine length using a HEAD request */
+	if ( ( rc = http_open_request ( &parallel->stream[0].xfer, uri,
+					default_port, filter,
+					( HTTP_HEAD_ONLY | HTTP_RANGE_PROBE ),
+					0, 0 ) ) != 0 )
+		goto err;
+
+	/* Attach to parent interface, mortalise self, and return */
+	intf_plug_plug ( &parallel->xfer, xfer );
+	ref_put ( &parallel->refcnt );
+	return 0;
+
+ err:
+	http_parallel_close ( parallel, rc );
+	ref_put ( &parallel->refcnt );
+	return rc;
+}
+
+/**
+ * Initiate an HTTP connection, with optional filter
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		Uniform Resource Identifier
+ * @v default_port	Default port number
+ * @v filter		Filter to apply to socket, or NULL
+ * @ret rc		Return status code
+ *
+ * If the "http-streams" setting specifies more than one stream, and
+ * the parent is able to accept stream data, then the resource will be
+ * fetched using multiple concurrent range requests.
+ */
+int http_open_filter ( struct interface *xfer, struct uri *uri,
+		       unsigned int default_port,
+		       int ( * filter ) ( struct interface *xfer,
+					  struct interface **next ) ) {
+	struct interface parent = INTF_INIT ( null_intf_desc );
+	unsigned int streams;
+	size_t window;
+
+	/* Sanity checks */
+	if ( ! uri->host )
+		return -EINVAL;
+
+	/* Check whether parent accepts stream data.  Block device
+	 * users (which report a zero window) must be given a single
+	 * request supporting partial reads.
+	 */
+	intf_plug ( &parent, xfer );
+	window = xfer_window ( &parent );
+	intf_unplug ( &parent );
+
+	/* Use parallel streams if applicable */
+	streams = fetch_uintz_setting ( NULL, &http_streams_setting );
+	if ( streams > HTTP_MAX_STREAMS )
+		streams = HTTP_MAX_STREAMS;
+	if ( ( streams > 1 ) && window ) {
+		return http_parallel_open ( xfer, uri, default_port, filter,
+					    streams );
+	}
+
+	return http_open_request ( xfer, uri, default_port, filter, 0, 0, 0 );
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+/**
+ * @file
+ *
+ * HTTP gzip and deflate content encodings
+ *
+ * The decoder sits between the HTTP request and the recipient of the
+ * HTTP content, inflating the content as it arrives.  Data is
+ * delivered to the recipient sequentially; the (encoded) length
+ * reported by the server is never passed on.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/interface.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/xfer.h>
+#include <ipxe/deflate.h>
+#include <ipxe/http.h>
+
+/** Size of decoded data buffers */
+#define HTTP_DECODER_BLKSIZE 8192
+
+/** An HTTP content decoder */
+struct http_decoder {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Encoded data interface */
+	struct interface raw;
+	/** Decoded data interface */
+	struct interface xfer;
+	/** Decompressor */
+	struct deflate deflate;
+};
+
+/**
+ * Close HTTP content decoder
+ *
+ * @v decoder		HTTP content decoder
+ * @v rc		Reason for close
+ */
+static void http_decoder_close ( struct http_decoder *decoder, int rc ) {
+
+	/* Treat premature end of encoded data as an error */
+	if ( ( rc == 0 ) && ! deflate_finished ( &decoder->deflate ) ) {
+		DBGC ( decoder, "HTTPGZIP %p truncated content\n", decoder );
+		rc = -EIO;
+	}
+
+	/* Shut down interfaces */
+	intf_shutdown ( &decoder->raw, rc );
+	intf_shutdown ( &decoder->xfer, rc );
+}
+
+/**
+ * Receive encoded data
+ *
+ * @v decoder		HTTP content decoder
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int http_decoder_deliver ( struct http_decoder *decoder,
+				  struct io_buffer *iobuf,
+				  struct xfer_metadata *meta __unused ) {
+	struct deflate_chunk in;
+	struct deflate_chunk out;
+	struct io_buffer *decoded;
+	int rc;
+
+	/* Inflate data, one output buffer at a time */
+	deflate_chunk_init ( &in, iobuf->data, 0, iob_len ( iobuf ) );
+	while ( ! deflate_finished ( &decoder->deflate ) ) {
+
+		/* Allocate output buffer */
+		decoded = xfer_alloc_iob ( &decoder->xfer,
+					   HTTP_DECODER_BLKSIZE );
+		if ( ! decoded ) {
+			rc = -ENOMEM;
+			goto err;
+		}
+		deflate_chunk_init ( &out, iob_put ( decoded, 0 ), 0,
+				     HTTP_DECODER_BLKSIZE );
+
+		/* Inflate as much as possible */
+		if ( ( rc = deflate_inflate ( &decoder->deflate, &in,
+					      &out ) ) != 0 ) {
+			DBGC ( decoder, "HTTPGZIP %p could not inflate: %s\n",
+			       decoder, strerror ( rc ) );
+			free_iob ( decoded );
+			goto err;
+		}
+
+		/* Deliver any decoded data */
+		if ( out.offset ) {
+			iob_put ( decoded, out.offset );
+			if ( ( rc = xfer_deliver_iob ( &decoder->xfer,
+						       decoded ) ) != 0 )
+				goto err;
+		} else {
+			free_iob ( decoded );
+		}
+
+		/* Stop when we need more input */
+		if ( out.offset < out.len )
+			break;
+	}
+
+	/* Ignore any trailing data */
+	if ( in.offset < in.len ) {
+		DBGC ( decoder, "HTTPGZIP %p ignoring %zd trailing bytes\n",
+		       decoder, ( in.len - in.offset ) );
+	}
+
+	free_iob ( iobuf );
+	return 0;
+
+ err:
+	free_iob ( iobuf );
+	http_decoder_close ( decoder, rc );
+	return rc;
+}
+
+/** HTTP content decoder encoded data interface operations */
+static struct interface_operation http_decoder_raw_ops[] = {
+	INTF_OP ( xfer_deliver, struct http_decoder *, http_decoder_deliver ),
+	INTF_OP ( intf_close, struct http_decoder *, http_decoder_close ),
+};
+
+/** HTTP content decoder encoded data interface descriptor */
+static struct interface_descriptor http_decoder_raw_desc =
+	INTF_DESC ( struct http_decoder, raw, http_decoder_raw_ops );
+
+/** HTTP content decoder decoded data interface operations */
+static struct interface_operation http_decoder_xfer_ops[] = {
+	INTF_OP ( intf_close, struct http_decoder *, http_decoder_close ),
+};
+
+/** HTTP content decoder decoded data interface descriptor */
+static struct interface_descriptor http_decoder_xfer_desc =
+	INTF_DESC ( struct http_decoder, xfer, http_decoder_xfer_ops );
+
+/**
+ * Insert HTTP content decoder
+ *
+ * @v xfer		HTTP data transfer interface
+ * @v format		Compression format
+ * @ret rc		Return status code
+ */
+static int http_decode ( struct interface *xfer,
+			 enum deflate_format format ) {
+	struct http_decoder *decoder;
+
+	/* Allocate and initialise structure */
+	decoder = zalloc ( sizeof ( *decoder ) );
+	if ( ! decoder )
+		return -ENOMEM;
+	ref_init ( &decoder->refcnt, NULL );
+	intf_init ( &decoder->raw, &http_decoder_raw_desc,
+		    &decoder->refcnt );
+	intf_init ( &decoder->xfer, &http_decoder_xfer_desc,
+		    &decoder->refcnt );
+	deflate_init ( &decoder->deflate, format );
+
+	/* Attach to parent interface, mortalise self, and return */
+	intf_insert ( xfer, &decoder->raw, &decoder->xfer );
+	ref_put ( &decoder->refcnt );
+	return 0;
+}
+
+/**
+ * Insert HTTP gzip content decoder
+ *
+ * @v xfer		HTTP data transfer interface
+ * @ret rc		Return status code
+ */
+static int http_decode_gzip ( struct interface *xfer ) {
+	return http_decode ( xfer, DEFLATE_GZIP );
+}
+
+/**
+ * Insert HTTP deflate content decoder
+ *
+ * @v xfer		HTTP data transfer interface
+ * @ret rc		Return status code
+ *
+ * The "deflate" content encoding is defined by RFC 2616 to be the
+ * ZLIB format, rather than raw DEFLATE data.
+ */
+static int http_decode_deflate ( struct interface *xfer ) {
+	return http_decode ( xfer, DEFLATE_ZLIB );
+}
+
+/** HTTP gzip content encoding */
+struct http_content_encoding http_gzip_encoding __http_content_encoding = {
+	.name = "gzip",
+	.decode = http_decode_gzip,
+};
+
+/** HTTP deflate content encoding */
+struct http_content_encoding http_deflate_encoding __http_content_encoding = {
+	.name = "deflate",
+	.decode = http_decode_deflate,
+};
@@ -1522,7 +1522,8 @@ static void iscsi_tx_step ( struct iscsi_session *iscsi ) {
 
 /** iSCSI TX process descriptor */
 static struct process_descriptor iscsi_process_desc =
-	PROC_DESC ( struct iscsi_session, process, iscsi_tx_step );
+	PROC_DESC_CLASS ( struct iscsi_session, process, iscsi_tx_step,
+			  PROC_CLASS_TX );
 
 /**
  * Receive basic header segment of an iSCSI PDU
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <ipxe/timer.h>
+#include <ipxe/tcp.h>
+
+/** @file
+ *
+ * TCP CUBIC congestion control
+ *
+ * This implements the window growth function and multiplicative
+ * decrease described in RFC 8312.  The TCP-friendly region is
+ * approximated by never growing more slowly than NewReno would.
+ *
+ */
+
+/** Multiplicative decrease factor (in tenths) */
+#define CUBIC_BETA 7
+
+/** Window growth scaling constant (in tenths) */
+#define CUBIC_C 4
+
+/** Maximum time since start of epoch considered (in seconds)
+ *
+ * This prevents overflow when cubing the elapsed time.
+ */
+#define CUBIC_MAX_EPOCH_SECS 64
+
+/**
+ * Calculate integer cube root
+ *
+ * @v value		Value
+ * @ret root		Cube root (rounded down)
+ */
+static uint32_t cubic_cbrt ( uint64_t value ) {
+	uint64_t trial;
+	uint32_t root = 0;
+	uint32_t bit;
+
+	for ( bit = ( 1 << 20 ) ; bit ; bit >>= 1 ) {
+		trial = ( root | bit );
+		if ( ( trial * trial * trial ) <= value )
+			root |= bit;
+	}
+	return root;
+}
+
+/**
+ * Handle acknowledgement of new data
+ *
+ * @v cong		Congestion control state
+ * @v acked		Length of newly acknowledged data
+ */
+static void cubic_ack ( struct tcp_congestion *cong, uint32_t acked ) {
+	unsigned long now = currticks();
+	int64_t ticks_per_sec_cubed;
+	int64_t elapsed;
+	int64_t delta;
+	int64_t target;
+	uint32_t increment;
+	uint32_t reno_increment;
+	uint32_t segments;
+
+	/* Use standard slow start below the slow start threshold */
+	if ( cong->cwnd < cong->ssthresh ) {
+		increment = acked;
+		if ( increment > TCP_PATH_MTU )
+			increment = TCP_PATH_MTU;
+		cong->cwnd += increment;
+		return;
+	}
+
+	/* Start a new congestion avoidance epoch if necessary,
+	 * calculating the time K taken to regrow to w_max as
+	 *
+	 *    K = cbrt ( ( w_max - cwnd ) / C )
+	 */
+	ticks_per_sec_cubed = TICKS_PER_SEC;
+	ticks_per_sec_cubed *= ( ticks_per_sec_cubed * ticks_per_sec_cubed );
+	if ( ! cong->epoch ) {
+		cong->epoch = ( now ? now : 1 );
+		if ( cong->w_max > cong->cwnd ) {
+			segments = ( ( cong->w_max - cong->cwnd ) /
+				     TCP_PATH_MTU );
+			cong->k = cubic_cbrt ( ( segments * 10 / CUBIC_C ) *
+					       ticks_per_sec_cubed );
+		} else {
+			cong->w_max = cong->cwnd;
+			cong->k = 0;
+		}
+	}
+
+	/* Calculate target window as
+	 *
+	 *    W(t) = C * ( t - K )^3 + w_max
+	 */
+	elapsed = ( now - cong->epoch );
+	if ( elapsed > ( int64_t ) ( CUBIC_MAX_EPOCH_SECS * TICKS_PER_SEC ) )
+		elapsed = ( CUBIC_MAX_EPOCH_SECS * TICKS_PER_SEC );
+	elapsed -= cong->k;
+	delta = ( ( CUBIC_C * elapsed * elapsed * elapsed * TCP_PATH_MTU ) /
+		  ( 10 * ticks_per_sec_cubed ) );
+	target = ( cong->w_max + delta );
+
+	/* Grow towards target window, but never more slowly than
+	 * NewReno would.
+	 */
+	increment = 0;
+	if ( target > cong->cwnd ) {
+		increment = ( ( ( target - cong->cwnd ) * acked ) /
+			      cong->cwnd );
+	}
+	reno_increment = ( ( TCP_PATH_MTU * TCP_PATH_MTU ) / cong->cwnd );
+	if ( increment < reno_increment )
+		increment = reno_increment;
+	if ( ! increment )
+		increment = 1;
+	cong->cwnd += increment;
+}
+
+/**
+ * Handle detection of a loss
+ *
+ * @v cong		Congestion control state
+ * @v flight		Length of data in flight
+ */
+static void cubic_loss ( struct tcp_congestion *cong,
+			 uint32_t flight __unused ) {
+
+	/* Record window prior to reduction, applying fast
+	 * convergence if the window has not regrown to its previous
+	 * maximum.
+	 */
+	if ( cong->cwnd < cong->w_max ) {
+		cong->w_max = ( ( cong->cwnd * ( 10 + CUBIC_BETA ) ) / 20 );
+	} else {
+		cong->w_max = cong->cwnd;
+	}
+
+	/* Reduce slow start threshold by factor beta */
+	cong->ssthresh = ( ( cong->cwnd * CUBIC_BETA ) / 10 );
+	if ( cong->ssthresh < ( 2 * TCP_PATH_MTU ) )
+		cong->ssthresh = ( 2 * TCP_PATH_MTU );
+
+	/* End current epoch */
+	cong->epoch = 0;
+}
+
+/** CUBIC congestion control algorithm */
+struct tcp_congestion_algorithm cubic_algorithm __tcp_congestion_algorithm = {
+	.name = "cubic",
+	.ack = cubic_ack,
+	.loss = cubic_loss,
+};
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <ipxe/tcp.h>
+
+/** @file
+ *
+ * TCP NewReno congestion control
+ *
+ * This implements the standard slow start and congestion avoidance
+ * algorithms from RFC 5681.  The fast recovery modifications
+ * described in RFC 6582 are implemented by the core TCP code.
+ *
+ */
+
+/**
+ * Handle acknowledgement of new data
+ *
+ * @v cong		Congestion control state
+ * @v acked		Length of newly acknowledged data
+ */
+static void newreno_ack ( struct tcp_congestion *cong, uint32_t acked ) {
+	uint32_t increment;
+
+	if ( cong->cwnd < cong->ssthresh ) {
+		/* Slow start: grow by up to one segment per ACK */
+		increment = acked;
+		if ( increment > TCP_PATH_MTU )
+			increment = TCP_PATH_MTU;
+	} else {
+		/* Congestion avoidance: grow by approximately one
+		 * segment per round-trip time.
+		 */
+		increment = ( ( TCP_PATH_MTU * TCP_PATH_MTU ) / cong->cwnd );
+		if ( ! increment )
+			increment = 1;
+	}
+	cong->cwnd += increment;
+}
+
+/**
+ * Handle detection of a loss
+ *
+ * @v cong		Congestion control state
+ * @v flight		Length of data in flight
+ */
+static void newreno_loss ( struct tcp_congestion *cong, uint32_t flight ) {
+
+	/* Halve the amount of data in flight, as per RFC 5681 */
+	cong->ssthresh = ( flight / 2 );
+	if ( cong->ssthresh < ( 2 * TCP_PATH_MTU ) )
+		cong->ssthresh = ( 2 * TCP_PATH_MTU );
+}
+
+/** NewReno congestion control algorithm */
+struct tcp_congestion_algorithm newreno_algorithm __tcp_congestion_algorithm = {
+	.name = "newreno",
+	.ack = newreno_ack,
+	.loss = newreno_loss,
+};
@@ -4,7 +4,9 @@
 #include <byteswap.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/tables.h>
+#include <ipxe/netdevice.h>
 #include <ipxe/tcpip.h>
+#include <ipxe/profile.h>
 
 /** @file
  *
@@ -16,6 +18,10 @@
 
 FILE_LICENCE ( GPL2_OR_LATER );
 
+/** TCP/IP checksum profiler */
+static struct profiler tcpip_chksum_profiler __profiler =
+	{ .name = "tcpip.chksum" };
+
 /** Process a received TCP/IP packet
  *
  * @v iobuf		I/O buffer
@@ -57,7 +63,7 @@ int tcpip_rx ( struct io_buffer *iobuf, uint8_t tcpip_proto,
  * @v st_src		Source address, or NULL to use route default
  * @v st_dest		Destination address
  * @v netdev		Network device to use if no route found, or NULL
- * @v trans_csum	Transport-layer checksum to complete, or NULL
+ * @v trans_csum	Transport-layer checksum to fill in, or NULL
  * @ret rc		Return status code
  */
 int tcpip_tx ( struct io_buffer *iobuf, struct tcpip_protocol *tcpip_protocol,
@@ -79,6 +85,174 @@ int tcpip_tx ( struct io_buffer *iobuf, struct tcpip_protocol *tcpip_protocol,
 	return -EAFNOSUPPORT;
 }
 
+/**
+ * Determine transmitting network device
+ *
+ * @v st_dest		Destination address
+ * @ret netdev		Network device, or NULL
+ */
+struct net_device * tcpip_netdev ( struct sockaddr_tcpip *st_dest ) {
+	struct tcpip_net_protocol *tcpip_net;
+
+	/* Hand off to the appropriate network-layer protocol */
+	for_each_table_entry ( tcpip_net, TCPIP_NET_PROTOCOLS ) {
+		if ( ( tcpip_net->sa_family == st_dest->st_family ) &&
+		     tcpip_net->netdev ) {
+			return tcpip_net->netdev ( st_dest );
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Fill in transport-layer checksum for transmission
+ *
+ * @v iobuf		I/O buffer (starting at network-layer header)
+ * @v netdev		Transmitting network device
+ * @v hdrlen		Length of network-layer header
+ * @v trans_csum	Transport-layer checksum field
+ * @v pshdr_csum	Pseudo-header checksum
+ *
+ * If the network device is able to complete the checksum, then the
+ * checksum field is seeded with the pseudo-header checksum and the
+ * I/O buffer is marked as requiring completion by the device.
+ * Otherwise, the checksum is calculated here.
+ */
+void tcpip_tx_chksum ( struct io_buffer *iobuf, struct net_device *netdev,
+		       size_t hdrlen, uint16_t *trans_csum,
+		       uint16_t pshdr_csum ) {
+	void *trans = ( iobuf->data + hdrlen );
+
+	/* Sanity check */
+	assert ( *trans_csum == 0 );
+
+	if ( netdev->offloads & NETDEV_OFFLOAD_TX_CSUM ) {
+		iobuf->flags |= IOB_CSUM_PARTIAL;
+		iobuf->csum_start = ( trans - iobuf->head );
+		iobuf->csum_offset = ( ( ( void * ) trans_csum ) - trans );
+		*trans_csum = ~pshdr_csum;
+	} else {
+		*trans_csum = tcpip_continue_chksum ( pshdr_csum, trans,
+						      ( iob_len ( iobuf ) -
+							hdrlen ) );
+	}
+}
+
+/**
+ * Calculate continued TCP/IP checkum, optionally copying data
+ *
+ * @v partial		Checksum of already-summed data, in network byte order
+ * @v dest		Destination buffer, or NULL
+ * @v src		Source data buffer
+ * @v len		Length of data buffer
+ * @ret cksum		Updated checksum, in network byte order
+ *
+ * This is always inlined, so that the checksum-only case compiles
+ * down to a pure summing loop.
+ */
+static inline __attribute__ (( always_inline )) uint16_t
+tcpip_do_chksum ( uint16_t partial, void *dest, const void *src,
+		  size_t len ) {
+	const uint8_t *bytes = src;
+	uint8_t *dest_bytes = dest;
+	const uint32_t *dwords;
+	uint64_t sum = 0;
+	uint32_t cksum;
+	uint32_t dword;
+	uint16_t word;
+	unsigned int swap = 0;
+
+	/* If the data starts on an odd address, sum the first byte
+	 * separately.  The remaining data will then be summed with
+	 * the wrong byte pairing, which we correct for by
+	 * byte-swapping its (folded) sum at the end.
+	 */
+	if ( ( ( ( intptr_t ) bytes ) & 1 ) && len ) {
+		/* First byte is an even byte: swap on big-endian systems */
+		cksum = le16_to_cpu ( *bytes );
+		if ( dest )
+			*(dest_bytes++) = *bytes;
+		bytes++;
+		len--;
+		swap = 1;
+	} else {
+		cksum = 0;
+	}
+
+	/* Sum up to one 16-bit word to reach 32-bit alignment */
+	if ( ( ( ( intptr_t ) bytes ) & 2 ) && ( len >= 2 ) ) {
+		word = *( ( uint16_t * ) bytes );
+		sum += word;
+		if ( dest ) {
+			memcpy ( dest_bytes, &word, sizeof ( word ) );
+			dest_bytes += sizeof ( word );
+		}
+		bytes += sizeof ( word );
+		len -= sizeof ( word );
+	}
+
+	/* Sum aligned 32-bit words into a 64-bit accumulator, with
+	 * folding deferred until the end.  The accumulator cannot
+	 * overflow for any length of data that could fit in memory.
+	 */
+	dwords = ( ( const uint32_t * ) bytes );
+	if ( dest ) {
+		for ( ; len >= 4 ; len -= 4 ) {
+			dword = *(dwords++);
+			sum += dword;
+			memcpy ( dest_bytes, &dword, sizeof ( dword ) );
+			dest_bytes += sizeof ( dword );
+		}
+	} else {
+		for ( ; len >= 16 ; len -= 16, dwords += 4 ) {
+			sum += dwords[0];
+			sum += dwords[1];
+			sum += dwords[2];
+			sum += dwords[3];
+		}
+		for ( ; len >= 4 ; len -= 4 )
+			sum += *(dwords++);
+	}
+	bytes = ( ( const uint8_t * ) dwords );
+
+	/* Sum any trailing 16-bit word and byte */
+	if ( len >= 2 ) {
+		word = *( ( uint16_t * ) bytes );
+		sum += word;
+		if ( dest ) {
+			memcpy ( dest_bytes, &word, sizeof ( word ) );
+			dest_bytes += sizeof ( word );
+		}
+		bytes += sizeof ( word );
+		len -= sizeof ( word );
+	}
+	if ( len ) {
+		/* Trailing byte is an even byte: swap on big-endian systems */
+		sum += le16_to_cpu ( *bytes );
+		if ( dest )
+			*dest_bytes = *bytes;
+	}
+
+	/* Fold accumulator down to 16 bits */
+	sum = ( ( sum & 0xffffffffUL ) + ( sum >> 32 ) );
+	sum = ( ( sum & 0xffffffffUL ) + ( sum >> 32 ) );
+	sum = ( ( sum & 0xffff ) + ( sum >> 16 ) );
+	sum = ( ( sum & 0xffff ) + ( sum >> 16 ) );
+	sum = ( ( sum & 0xffff ) + ( sum >> 16 ) );
+
+	/* Correct byte pairing if data started on an odd address */
+	if ( swap )
+		sum = bswap_16 ( sum );
+
+	/* Add in first byte (if applicable) and partial checksum */
+	cksum += ( sum + ( ( ~partial ) & 0xffff ) );
+	cksum = ( ( cksum & 0xffff ) + ( cksum >> 16 ) );
+	cksum = ( ( cksum & 0xffff ) + ( cksum >> 16 ) );
+
+	return ( ~cksum );
+}
+
 /**
  * Calculate continued TCP/IP checkum
  *
@@ -97,27 +271,27 @@ int tcpip_tx ( struct io_buffer *iobuf, struct tcpip_protocol *tcpip_protocol,
  * or both.  Deciding which to swap is left as an exercise for the
  * interested reader.
  */
-uint16_t tcpip_continue_chksum ( uint16_t partial, const void *data,
-				 size_t len ) {
-	unsigned int cksum = ( ( ~partial ) & 0xffff );
-	unsigned int value;
-	unsigned int i;
-	
-	for ( i = 0 ; i < len ; i++ ) {
-		value = * ( ( uint8_t * ) data + i );
-		if ( i & 1 ) {
-			/* Odd bytes: swap on little-endian systems */
-			value = be16_to_cpu ( value );
-		} else {
-			/* Even bytes: swap on big-endian systems */
-			value = le16_to_cpu ( value );
-		}
-		cksum += value;
-		if ( cksum > 0xffff )
-			cksum -= 0xffff;
-	}
-	
-	return ( ~cksum );
+uint16_t generic_tcpip_continue_chksum ( uint16_t partial,
+					 const void *data, size_t len ) {
+	return tcpip_do_chksum ( partial, NULL, data, len );
+}
+
+/**
+ * Copy data and calculate continued TCP/IP checksum
+ *
+ * @v partial		Checksum of already-summed data, in network byte order
+ * @v dest		Destination buffer
+ * @v src		Source data buffer
+ * @v len		Length of data buffer
+ * @ret cksum		Updated checksum, in network byte order
+ *
+ * Copies the data block while calculating its TCP/IP-style 16-bit
+ * checksum, so that the data need be read only once.  The same
+ * constraints as for tcpip_continue_chksum() apply.
+ */
+uint16_t tcpip_copy_chksum ( uint16_t partial, void *dest, const void *src,
+			     size_t len ) {
+	return tcpip_do_chksum ( partial, dest, src, len );
 }
 
 /**
@@ -131,5 +305,10 @@ uint16_t tcpip_continue_chksum ( uint16_t partial, const void *data,
  * checksum is returned in network byte order.
  */
 uint16_t tcpip_chksum ( const void *data, size_t len ) {
-	return tcpip_continue_chksum ( TCPIP_EMPTY_CSUM, data, len );
+	uint16_t csum;
+
+	profile_start ( &tcpip_chksum_profiler );
+	csum = tcpip_continue_chksum ( TCPIP_EMPTY_CSUM, data, len );
+	profile_stop ( &tcpip_chksum_profiler );
+	return csum;
 }
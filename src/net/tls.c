@@ -42,12 +42,19 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/x509.h>
 #include <ipxe/rbg.h>
 #include <ipxe/tls.h>
+#include <ipxe/profile.h>
 
 static int tls_send_plaintext ( struct tls_session *tls, unsigned int type,
 				const void *data, size_t len );
 static void tls_clear_cipher ( struct tls_session *tls,
 			       struct tls_cipherspec *cipherspec );
 
+/** Record decryption profiler
+ *
+ * This excludes the time spent processing the plaintext record.
+ */
+static struct profiler tls_rx_profiler __profiler = { .name = "tls.rx" };
+
 /******************************************************************************
  *
  * Utility functions
@@ -1461,13 +1468,15 @@ static int tls_new_ciphertext ( struct tls_session *tls,
 	uint8_t verify_mac[mac_len];
 	int rc;
 
+	profile_start ( &tls_rx_profiler );
+
 	/* Allocate buffer for plaintext */
 	plaintext = malloc ( record_len );
 	if ( ! plaintext ) {
 		DBGC ( tls, "TLS %p could not allocate %zd bytes for "
 		       "decryption buffer\n", tls, record_len );
 		rc = -ENOMEM;
-		goto done;
+		goto err;
 	}
 
 	/* Decrypt the record */
@@ -1478,11 +1487,11 @@ static int tls_new_ciphertext ( struct tls_session *tls,
 	if ( is_stream_cipher ( cipherspec->cipher ) ) {
 		if ( ( rc = tls_split_stream ( tls, plaintext, record_len,
 					       &data, &len, &mac ) ) != 0 )
-			goto done;
+			goto err;
 	} else {
 		if ( ( rc = tls_split_block ( tls, plaintext, record_len,
 					      &data, &len, &mac ) ) != 0 )
-			goto done;
+			goto err;
 	}
 
 	/* Verify MAC */
@@ -1494,18 +1503,23 @@ static int tls_new_ciphertext ( struct tls_session *tls,
 	if ( memcmp ( mac, verify_mac, mac_len ) != 0 ) {
 		DBGC ( tls, "TLS %p failed MAC verification\n", tls );
 		DBGC_HD ( tls, plaintext, record_len );
-		goto done;
+		goto err;
 	}
 
 	DBGC2 ( tls, "Received plaintext data:\n" );
 	DBGC2_HD ( tls, data, len );
+	profile_stop ( &tls_rx_profiler );
 
 	/* Process plaintext record */
 	if ( ( rc = tls_new_record ( tls, tlshdr->type, data, len ) ) != 0 )
-		goto done;
+		goto err_record;
 
-	rc = 0;
- done:
+	free ( plaintext );
+	return 0;
+
+ err:
+	profile_stop ( &tls_rx_profiler );
+ err_record:
 	free ( plaintext );
 	return rc;
 }
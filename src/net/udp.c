@@ -217,7 +217,6 @@ static int udp_tx ( struct udp_connection *udp, struct io_buffer *iobuf,
 	udphdr->src = src->st_port;
 	udphdr->len = htons ( len );
 	udphdr->chksum = 0;
-	udphdr->chksum = tcpip_chksum ( udphdr, len );
 
 	/* Dump debugging information */
 	DBGC ( udp, "UDP %p TX %d->%d len %d\n", udp,
@@ -299,7 +298,7 @@ static int udp_rx ( struct io_buffer *iobuf, struct sockaddr_tcpip *st_src,
 		rc = -EINVAL;
 		goto done;
 	}
-	if ( udphdr->chksum ) {
+	if ( udphdr->chksum && ! ( iobuf->flags & IOB_CSUM_VERIFIED ) ) {
 		csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data, ulen );
 		if ( csum != 0 ) {
 			DBG ( "UDP checksum incorrect (is %04x including "
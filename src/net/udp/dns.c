@@ -24,10 +24,15 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 #include <errno.h>
 #include <byteswap.h>
 #include <ipxe/refcnt.h>
+#include <ipxe/list.h>
+#include <ipxe/malloc.h>
+#include <ipxe/timer.h>
+#include <ipxe/process.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
@@ -62,6 +67,210 @@ static struct sockaddr_tcpip nameserver = {
 /** The local domain */
 static char *localdomain;
 
+/******************************************************************************
+ *
+ * DNS cache
+ *
+ ******************************************************************************
+ */
+
+/** Maximum number of DNS cache entries */
+#define DNS_CACHE_MAX 32
+
+/** Maximum time for which a DNS cache entry is retained (in seconds) */
+#define DNS_CACHE_MAX_TTL ( 24 * 60 * 60 )
+
+/** A DNS cache entry */
+struct dns_cache_entry {
+	/** List of DNS cache entries */
+	struct list_head list;
+	/** Query type */
+	unsigned int type;
+	/** Status code
+	 *
+	 * This is zero for a positive entry, or the error returned
+	 * for a name that does not exist.
+	 */
+	int rc;
+	/** Resolved address (for a positive entry) */
+	struct in_addr address;
+	/** Time at which entry was created */
+	unsigned long created;
+	/** Time to live (in ticks) */
+	unsigned long ttl;
+	/** Fully-qualified name */
+	char name[0];
+};
+
+/** DNS cache entries, most recently used first */
+static LIST_HEAD ( dns_cache );
+
+/** Number of DNS cache entries */
+static unsigned int dns_cache_count;
+
+/**
+ * Remove DNS cache entry
+ *
+ * @v entry		DNS cache entry
+ */
+static void dns_cache_del ( struct dns_cache_entry *entry ) {
+
+	list_del ( &entry->list );
+	dns_cache_count--;
+	free ( entry );
+}
+
+/**
+ * Remove expired DNS cache entries
+ *
+ */
+static void dns_cache_expire ( void ) {
+	struct dns_cache_entry *entry;
+	struct dns_cache_entry *tmp;
+	unsigned long now = currticks();
+
+	list_for_each_entry_safe ( entry, tmp, &dns_cache, list ) {
+		if ( ( now - entry->created ) >= entry->ttl ) {
+			DBG ( "DNS cache entry for %s expired\n", entry->name );
+			dns_cache_del ( entry );
+		}
+	}
+}
+
+/**
+ * Find DNS cache entry
+ *
+ * @v name		Fully-qualified name
+ * @v type		Query type
+ * @ret entry		DNS cache entry, or NULL if not found
+ */
+static struct dns_cache_entry * dns_cache_find ( const char *name,
+						 unsigned int type ) {
+	struct dns_cache_entry *entry;
+
+	dns_cache_expire();
+	list_for_each_entry ( entry, &dns_cache, list ) {
+		if ( ( entry->type == type ) &&
+		     ( strcasecmp ( entry->name, name ) == 0 ) ) {
+			/* Move to front of cache */
+			list_del ( &entry->list );
+			list_add ( &entry->list, &dns_cache );
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Add DNS cache entry
+ *
+ * @v name		Fully-qualified name
+ * @v type		Query type
+ * @v rc		Status code (zero for a positive entry)
+ * @v address		Resolved address, or NULL for a negative entry
+ * @v ttl		Time to live (in seconds)
+ */
+static void dns_cache_add ( const char *name, unsigned int type, int rc,
+			    const struct in_addr *address,
+			    unsigned long ttl ) {
+	struct dns_cache_entry *entry;
+	size_t name_len = ( strlen ( name ) + 1 /* NUL */ );
+
+	/* Do not cache records which must not be cached */
+	if ( ! ttl )
+		return;
+	if ( ttl > DNS_CACHE_MAX_TTL )
+		ttl = DNS_CACHE_MAX_TTL;
+
+	/* Remove any existing entry */
+	if ( ( entry = dns_cache_find ( name, type ) ) != NULL )
+		dns_cache_del ( entry );
+
+	/* Remove least recently used entry, if cache is full */
+	if ( dns_cache_count >= DNS_CACHE_MAX ) {
+		entry = list_last_entry ( &dns_cache, struct dns_cache_entry,
+					  list );
+		dns_cache_del ( entry );
+	}
+
+	/* Allocate and populate entry */
+	entry = zalloc ( sizeof ( *entry ) + name_len );
+	if ( ! entry )
+		return;
+	entry->type = type;
+	entry->rc = rc;
+	if ( address )
+		memcpy ( &entry->address, address,
+			 sizeof ( entry->address ) );
+	entry->created = currticks();
+	entry->ttl = ( ttl * TICKS_PER_SEC );
+	memcpy ( entry->name, name, name_len );
+	DBG ( "DNS cache entry for %s added with TTL %lds\n", name, ttl );
+
+	/* Add to front of cache */
+	list_add ( &entry->list, &dns_cache );
+	dns_cache_count++;
+}
+
+/**
+ * Show DNS cache
+ *
+ */
+void dns_cache_show ( void ) {
+	struct dns_cache_entry *entry;
+	unsigned long now = currticks();
+
+	dns_cache_expire();
+	list_for_each_entry ( entry, &dns_cache, list ) {
+		printf ( "%s: %s (expires in %lds)\n", entry->name,
+			 ( entry->rc ? strerror ( entry->rc ) :
+			   inet_ntoa ( entry->address ) ),
+			 ( ( entry->ttl - ( now - entry->created ) ) /
+			   TICKS_PER_SEC ) );
+	}
+}
+
+/**
+ * Flush DNS cache
+ *
+ */
+void dns_cache_flush ( void ) {
+	struct dns_cache_entry *entry;
+	struct dns_cache_entry *tmp;
+
+	list_for_each_entry_safe ( entry, tmp, &dns_cache, list )
+		dns_cache_del ( entry );
+}
+
+/**
+ * Discard some cached DNS data
+ *
+ * @ret discarded	Number of cached items discarded
+ */
+static unsigned int dns_discard ( void ) {
+	struct dns_cache_entry *entry;
+
+	/* Remove least recently used entry */
+	list_for_each_entry_reverse ( entry, &dns_cache, list ) {
+		dns_cache_del ( entry );
+		return 1;
+	}
+
+	return 0;
+}
+
+/** DNS cache discarder */
+struct cache_discarder dns_cache_discarder __cache_discarder = {
+	.discard = dns_discard,
+};
+
+/******************************************************************************
+ *
+ * DNS requests
+ *
+ ******************************************************************************
+ */
+
 /** A DNS request */
 struct dns_request {
 	/** Reference counter */
@@ -72,9 +281,17 @@ struct dns_request {
 	struct interface socket;
 	/** Retry timer */
 	struct retry_timer timer;
+	/** Cached result delivery process */
+	struct process process;
 
+	/** Fully-qualified name being resolved */
+	char *name;
 	/** Socket address to fill in with resolved address */
 	struct sockaddr sa;
+	/** Cached status code */
+	int rc;
+	/** Minimum TTL of records used so far (in seconds) */
+	unsigned long ttl;
 	/** Current query packet */
 	struct dns_query query;
 	/** Location of query info structure within current packet
@@ -87,6 +304,19 @@ struct dns_request {
 	unsigned int recursion;
 };
 
+/**
+ * Free DNS request
+ *
+ * @v refcnt		Reference counter
+ */
+static void dns_free ( struct refcnt *refcnt ) {
+	struct dns_request *dns =
+		container_of ( refcnt, struct dns_request, refcnt );
+
+	free ( dns->name );
+	free ( dns );
+}
+
 /**
  * Mark DNS request as complete
  *
@@ -95,8 +325,9 @@ struct dns_request {
  */
 static void dns_done ( struct dns_request *dns, int rc ) {
 
-	/* Stop the retry timer */
+	/* Stop the retry timer and cached result delivery process */
 	stop_timer ( &dns->timer );
+	process_del ( &dns->process );
 
 	/* Shut down interfaces */
 	intf_shutdown ( &dns->socket, rc );
@@ -191,6 +422,69 @@ static union dns_rr_info * dns_find_rr ( struct dns_request *dns,
 	return NULL;
 }
 
+/**
+ * Determine negative caching TTL for a DNS reply
+ *
+ * @v iobuf		I/O buffer containing DNS reply
+ * @ret ttl		Negative caching TTL (in seconds), or zero
+ *
+ * The negative caching TTL is taken from the SOA record in the
+ * authority section, as described in RFC 2308.  A reply without an
+ * SOA record must not be cached.
+ */
+static unsigned long dns_negative_ttl ( struct io_buffer *iobuf ) {
+	const struct dns_header *reply = iobuf->data;
+	const char *end = ( iobuf->data + iob_len ( iobuf ) );
+	const char *p = ( ( ( const char * ) reply ) + sizeof ( *reply ) );
+	const union dns_rr_info *rr_info;
+	const uint32_t *minimum;
+	unsigned long ttl;
+	size_t rdlength;
+	int i;
+
+	/* Skip over the questions section */
+	for ( i = ntohs ( reply->qdcount ) ; i > 0 ; i-- )
+		p = dns_skip_name ( p ) + sizeof ( struct dns_query_info );
+
+	/* Process the answers and authority sections */
+	for ( i = ( ntohs ( reply->ancount ) + ntohs ( reply->nscount ) ) ;
+	      i > 0 ; i-- ) {
+		p = dns_skip_name ( p );
+		rr_info = ( ( const union dns_rr_info * ) p );
+		if ( ( p + sizeof ( rr_info->common ) ) > end )
+			break;
+		rdlength = ntohs ( rr_info->common.rdlength );
+		p += ( sizeof ( rr_info->common ) + rdlength );
+		if ( p > end )
+			break;
+		if ( ( rr_info->common.type == htons ( DNS_TYPE_SOA ) ) &&
+		     ( rdlength >= sizeof ( *minimum ) ) ) {
+			/* SOA MINIMUM is the final field of the record */
+			minimum = ( ( ( const uint32_t * ) p ) - 1 );
+			ttl = ntohl ( rr_info->common.ttl );
+			if ( ttl > ntohl ( *minimum ) )
+				ttl = ntohl ( *minimum );
+			return ttl;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Update minimum TTL of records used in DNS request
+ *
+ * @v dns		DNS request
+ * @v rr_info		DNS RR
+ */
+static void dns_update_ttl ( struct dns_request *dns,
+			     const union dns_rr_info *rr_info ) {
+	unsigned long ttl = ntohl ( rr_info->common.ttl );
+
+	if ( ttl < dns->ttl )
+		dns->ttl = ttl;
+}
+
 /**
  * Append DHCP domain name if available and name is not fully qualified
  *
@@ -374,6 +668,17 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 	 */
 	stop_timer ( &dns->timer );
 
+	/* Fail immediately if the name does not exist */
+	if ( DNS_FLAG_RCODE ( ntohs ( reply->flags ) ) == DNS_FLAG_RCODE_NX ) {
+		DBGC ( dns, "DNS %p name does not exist\n", dns );
+		rc = -ENXIO_NO_RECORD;
+		dns_cache_add ( dns->name, DNS_TYPE_A, rc, NULL,
+				dns_negative_ttl ( iobuf ) );
+		dns_done ( dns, rc );
+		rc = 0;
+		goto done;
+	}
+
 	/* Search through response for useful answers.  Do this
 	 * multiple times, to take advantage of useful nameservers
 	 * which send us e.g. the CNAME *and* the A record for the
@@ -391,6 +696,11 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 			sin->sin_family = AF_INET;
 			sin->sin_addr = rr_info->a.in_addr;
 
+			/* Add to cache */
+			dns_update_ttl ( dns, rr_info );
+			dns_cache_add ( dns->name, DNS_TYPE_A, 0,
+					&sin->sin_addr, dns->ttl );
+
 			/* Return resolved address */
 			resolv_done ( &dns->resolv, &dns->sa );
 
@@ -403,6 +713,7 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 
 			/* Found a CNAME record; update query and recurse */
 			DBGC ( dns, "DNS %p found CNAME\n", dns );
+			dns_update_ttl ( dns, rr_info );
 			dns->qinfo = ( void * ) dns_decompress_name ( reply,
 							 rr_info->cname.cname,
 							 dns->query.payload );
@@ -452,7 +763,10 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 			goto done;
 		} else {
 			DBGC ( dns, "DNS %p found no CNAME record\n", dns );
-			dns_done ( dns, -ENXIO_NO_RECORD );
+			rc = -ENXIO_NO_RECORD;
+			dns_cache_add ( dns->name, DNS_TYPE_A, rc, NULL,
+					dns_negative_ttl ( iobuf ) );
+			dns_done ( dns, rc );
 			rc = 0;
 			goto done;
 		}
@@ -503,6 +817,22 @@ static struct interface_operation dns_resolv_op[] = {
 static struct interface_descriptor dns_resolv_desc =
 	INTF_DESC ( struct dns_request, resolv, dns_resolv_op );
 
+/**
+ * Deliver cached DNS result
+ *
+ * @v dns		DNS request
+ */
+static void dns_step ( struct dns_request *dns ) {
+
+	if ( dns->rc == 0 )
+		resolv_done ( &dns->resolv, &dns->sa );
+	dns_done ( dns, dns->rc );
+}
+
+/** DNS cached result delivery process descriptor */
+static struct process_descriptor dns_process_desc =
+	PROC_DESC_ONCE ( struct dns_request, process, dns_step );
+
 /**
  * Resolve name using DNS
  *
@@ -514,7 +844,8 @@ static struct interface_descriptor dns_resolv_desc =
 static int dns_resolv ( struct interface *resolv,
 			const char *name, struct sockaddr *sa ) {
 	struct dns_request *dns;
-	char *fqdn;
+	struct dns_cache_entry *entry;
+	struct sockaddr_in *sin;
 	int rc;
 
 	/* Fail immediately if no DNS servers */
@@ -525,30 +856,46 @@ static int dns_resolv ( struct interface *resolv,
 		goto err_no_nameserver;
 	}
 
-	/* Ensure fully-qualified domain name if DHCP option was given */
-	fqdn = dns_qualify_name ( name );
-	if ( ! fqdn ) {
-		rc = -ENOMEM;
-		goto err_qualify_name;
-	}
-
 	/* Allocate DNS structure */
 	dns = zalloc ( sizeof ( *dns ) );
 	if ( ! dns ) {
 		rc = -ENOMEM;
 		goto err_alloc_dns;
 	}
-	ref_init ( &dns->refcnt, NULL );
+	ref_init ( &dns->refcnt, dns_free );
 	intf_init ( &dns->resolv, &dns_resolv_desc, &dns->refcnt );
 	intf_init ( &dns->socket, &dns_socket_desc, &dns->refcnt );
 	timer_init ( &dns->timer, dns_timer_expired, &dns->refcnt );
+	process_init_stopped ( &dns->process, &dns_process_desc,
+			       &dns->refcnt );
 	memcpy ( &dns->sa, sa, sizeof ( dns->sa ) );
+	dns->ttl = DNS_CACHE_MAX_TTL;
+
+	/* Ensure fully-qualified domain name if DHCP option was given */
+	dns->name = dns_qualify_name ( name );
+	if ( ! dns->name ) {
+		rc = -ENOMEM;
+		goto err_qualify_name;
+	}
+
+	/* Use cached result, if available */
+	if ( ( entry = dns_cache_find ( dns->name, DNS_TYPE_A ) ) != NULL ) {
+		DBGC ( dns, "DNS %p using cached result for %s\n",
+		       dns, dns->name );
+		sin = ( struct sockaddr_in * ) &dns->sa;
+		sin->sin_family = AF_INET;
+		sin->sin_addr = entry->address;
+		dns->rc = entry->rc;
+		process_add ( &dns->process );
+		goto done;
+	}
 
 	/* Create query */
 	dns->query.dns.flags = htons ( DNS_FLAG_QUERY | DNS_FLAG_OPCODE_QUERY |
 				       DNS_FLAG_RD );
 	dns->query.dns.qdcount = htons ( 1 );
-	dns->qinfo = ( void * ) dns_make_name ( fqdn, dns->query.payload );
+	dns->qinfo = ( void * ) dns_make_name ( dns->name,
+						dns->query.payload );
 	dns->qinfo->qtype = htons ( DNS_TYPE_A );
 	dns->qinfo->qclass = htons ( DNS_CLASS_IN );
 
@@ -564,17 +911,16 @@ static int dns_resolv ( struct interface *resolv,
 	/* Send first DNS packet */
 	dns_send_packet ( dns );
 
+ done:
 	/* Attach parent interface, mortalise self, and return */
 	intf_plug_plug ( &dns->resolv, resolv );
 	ref_put ( &dns->refcnt );
-	free ( fqdn );
 	return 0;	
 
  err_open_socket:
- err_alloc_dns:
-	ref_put ( &dns->refcnt );
  err_qualify_name:
-	free ( fqdn );
+	ref_put ( &dns->refcnt );
+ err_alloc_dns:
  err_no_nameserver:
 	return rc;
 }
@@ -616,6 +962,7 @@ struct setting domain_setting __setting ( SETTING_IPv4_EXTRA ) = {
 static int apply_dns_settings ( void ) {
 	struct sockaddr_in *sin_nameserver =
 		( struct sockaddr_in * ) &nameserver;
+	struct in_addr old_nameserver = sin_nameserver->sin_addr;
 	int len;
 
 	/* Fetch DNS server address */
@@ -627,6 +974,12 @@ static int apply_dns_settings ( void ) {
 		      inet_ntoa ( sin_nameserver->sin_addr ) );
 	}
 
+	/* Flush cache if DNS server has changed */
+	if ( sin_nameserver->sin_addr.s_addr != old_nameserver.s_addr ) {
+		DBG ( "DNS flushing cache\n" );
+		dns_cache_flush();
+	}
+
 	/* Get local domain DHCP option */
 	free ( localdomain );
 	if ( ( len = fetch_string_setting_copy ( NULL, &domain_setting,
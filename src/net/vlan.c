@@ -358,6 +358,13 @@ int vlan_create ( struct net_device *trunk, unsigned int tag,
 	netdev_init ( netdev, &vlan_operations );
 	netdev->dev = trunk->dev;
 	memcpy ( netdev->hw_addr, trunk->ll_addr, ETH_ALEN );
+
+	/* Received packets are passed through from the trunk device,
+	 * and so may carry checksums already verified by the trunk.
+	 * Transmit offloads are not inherited, since the trunk would
+	 * see checksum offsets relative to the untagged packet.
+	 */
+	netdev->offloads = ( trunk->offloads & NETDEV_OFFLOAD_RX_CSUM );
 	vlan = netdev->priv;
 	vlan->trunk = netdev_get ( trunk );
 	vlan->tag = tag;
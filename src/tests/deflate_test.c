@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+/** @file
+ *
+ * DEFLATE tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <ipxe/deflate.h>
+#include <ipxe/test.h>
+
+/** Define inline compressed data */
+#define DATA(...) { __VA_ARGS__ }
+
+/** Define inline expected data */
+#define EXPECT(...) { __VA_ARGS__ }
+
+/** A DEFLATE test */
+struct deflate_test {
+	/** Compression format */
+	enum deflate_format format;
+	/** Compressed data */
+	const void *data;
+	/** Length of compressed data */
+	size_t len;
+	/** Expected uncompressed data */
+	const void *expected;
+	/** Length of expected uncompressed data */
+	size_t expected_len;
+};
+
+/**
+ * Define a DEFLATE test
+ *
+ * @v name		Test name
+ * @v FORMAT		Compression format
+ * @v DATA		Compressed data
+ * @v EXPECT		Expected uncompressed data
+ * @ret test		DEFLATE test
+ */
+#define DEFLATE_TEST( name, FORMAT, DATA, EXPECT )			\
+	static const uint8_t name ## _data[] = DATA;			\
+	static const uint8_t name ## _expected[] = EXPECT;		\
+	static struct deflate_test name = {				\
+		.format = FORMAT,					\
+		.data = name ## _data,					\
+		.len = sizeof ( name ## _data ),			\
+		.expected = name ## _expected,				\
+		.expected_len = sizeof ( name ## _expected ),		\
+	}
+
+/** Empty file */
+DEFLATE_TEST ( empty_literal, DEFLATE_RAW,
+	DATA ( 0x03, 0x00 ),
+	EXPECT ( ) );
+
+/** "Hello world" using fixed Huffman codes */
+DEFLATE_TEST ( literal, DEFLATE_RAW,
+	DATA ( 0xf3, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0x28, 0xcf, 0x2f, 0xca,
+	       0x49, 0x01, 0x00 ),
+	EXPECT ( 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x20, 0x77, 0x6f, 0x72, 0x6c,
+		 0x64 ) );
+
+/** "Hello world" using a stored block */
+DEFLATE_TEST ( stored, DEFLATE_RAW,
+	DATA ( 0x01, 0x0b, 0x00, 0xf4, 0xff, 0x48, 0x65, 0x6c, 0x6c, 0x6f,
+	       0x20, 0x77, 0x6f, 0x72, 0x6c, 0x64 ),
+	EXPECT ( 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x20, 0x77, 0x6f, 0x72, 0x6c,
+		 0x64 ) );
+
+/** "Hello world" split across several blocks */
+DEFLATE_TEST ( split, DEFLATE_RAW,
+	DATA ( 0xf2, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0x00, 0x00, 0x00, 0x00,
+	       0xff, 0xff, 0x2b, 0xcf, 0x2f, 0xca, 0x49, 0x01, 0x00 ),
+	EXPECT ( 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x20, 0x77, 0x6f, 0x72, 0x6c,
+		 0x64 ) );
+
+/** Long runs of a single character */
+DEFLATE_TEST ( repeat, DEFLATE_RAW,
+	DATA ( 0x4b, 0x4c, 0x1c, 0x05, 0xc4, 0x02, 0x00 ),
+	EXPECT ( 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61 ) );
+
+/** Text using dynamic Huffman codes */
+DEFLATE_TEST ( dynamic, DEFLATE_RAW,
+	DATA ( 0x4d, 0x90, 0xd1, 0x6d, 0x04, 0x31, 0x08, 0x44, 0x5b, 0x99,
+	       0x02, 0x56, 0x57, 0x46, 0xbe, 0xa2, 0xf4, 0xc0, 0xd9, 0x9c,
+	       0x8d, 0xe4, 0xc0, 0x05, 0xb3, 0x6b, 0x6d, 0xf7, 0xb1, 0xf7,
+	       0x12, 0x25, 0x9f, 0xa3, 0x19, 0x86, 0x07, 0x6f, 0xb6, 0x3b,
+	       0x7a, 0x32, 0x67, 0x90, 0x66, 0x74, 0x3e, 0x58, 0x71, 0x32,
+	       0x79, 0x07, 0x15, 0xc3, 0x72, 0x1f, 0x14, 0x95, 0xa7, 0xbe,
+	       0xbb, 0xed, 0xa5, 0x06, 0x1e, 0xe6, 0x51, 0x61, 0x8a, 0xa8,
+	       0xd2, 0x91, 0x4c, 0x43, 0x94, 0x35, 0x36, 0x10, 0x94, 0x07,
+	       0x94, 0x42, 0x4c, 0xb7, 0x65, 0x24, 0x96, 0x83, 0x33, 0x44,
+	       0xf1, 0x2e, 0x77, 0xf6, 0x38, 0xb7, 0x6b, 0x49, 0xe6, 0x2c,
+	       0x89, 0x62, 0x3a, 0x61, 0xb3, 0x84, 0xf1, 0x74, 0x7b, 0x5a,
+	       0x97, 0x35, 0x37, 0x35, 0x05, 0xa8, 0x35, 0x7c, 0x4e, 0x10,
+	       0x9a, 0x58, 0xc9, 0xf9, 0xca, 0xf2, 0xd7, 0x4e, 0xed, 0x86,
+	       0x0f, 0x1b, 0x18, 0x7c, 0x39, 0xac, 0x85, 0xca, 0xab, 0x9f,
+	       0x50, 0x56, 0x0c, 0x49, 0x0e, 0x69, 0x18, 0xe4, 0x1b, 0x82,
+	       0xfb, 0x04, 0x2b, 0x18, 0x95, 0x17, 0xff, 0xab, 0xf8, 0x17,
+	       0xce, 0x7c, 0x92, 0x9c, 0x3f, 0x12, 0xdd, 0xfe, 0xd1, 0x5e,
+	       0x6f, 0xb0, 0x3f, 0xc8, 0x79, 0x09, 0x29, 0x9a, 0xcd, 0x2a,
+	       0xd6, 0xbc, 0x3b, 0xdf, 0xbe, 0x01 ),
+	EXPECT ( 0x46, 0x6f, 0x75, 0x72, 0x20, 0x73, 0x63, 0x6f, 0x72, 0x65,
+		 0x20, 0x61, 0x6e, 0x64, 0x20, 0x73, 0x65, 0x76, 0x65, 0x6e,
+		 0x20, 0x79, 0x65, 0x61, 0x72, 0x73, 0x20, 0x61, 0x67, 0x6f,
+		 0x20, 0x6f, 0x75, 0x72, 0x20, 0x66, 0x61, 0x74, 0x68, 0x65,
+		 0x72, 0x73, 0x20, 0x62, 0x72, 0x6f, 0x75, 0x67, 0x68, 0x74,
+		 0x20, 0x66, 0x6f, 0x72, 0x74, 0x68, 0x20, 0x6f, 0x6e, 0x20,
+		 0x74, 0x68, 0x69, 0x73, 0x20, 0x63, 0x6f, 0x6e, 0x74, 0x69,
+		 0x6e, 0x65, 0x6e, 0x74, 0x2c, 0x20, 0x61, 0x20, 0x6e, 0x65,
+		 0x77, 0x20, 0x6e, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x2c, 0x20,
+		 0x63, 0x6f, 0x6e, 0x63, 0x65, 0x69, 0x76, 0x65, 0x64, 0x20,
+		 0x69, 0x6e, 0x20, 0x4c, 0x69, 0x62, 0x65, 0x72, 0x74, 0x79,
+		 0x2c, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x64, 0x65, 0x64, 0x69,
+		 0x63, 0x61, 0x74, 0x65, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x74,
+		 0x68, 0x65, 0x20, 0x70, 0x72, 0x6f, 0x70, 0x6f, 0x73, 0x69,
+		 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20,
+		 0x61, 0x6c, 0x6c, 0x20, 0x6d, 0x65, 0x6e, 0x20, 0x61, 0x72,
+		 0x65, 0x20, 0x63, 0x72, 0x65, 0x61, 0x74, 0x65, 0x64, 0x20,
+		 0x65, 0x71, 0x75, 0x61, 0x6c, 0x2e, 0x20, 0x4e, 0x6f, 0x77,
+		 0x20, 0x77, 0x65, 0x20, 0x61, 0x72, 0x65, 0x20, 0x65, 0x6e,
+		 0x67, 0x61, 0x67, 0x65, 0x64, 0x20, 0x69, 0x6e, 0x20, 0x61,
+		 0x20, 0x67, 0x72, 0x65, 0x61, 0x74, 0x20, 0x63, 0x69, 0x76,
+		 0x69, 0x6c, 0x20, 0x77, 0x61, 0x72, 0x2c, 0x20, 0x74, 0x65,
+		 0x73, 0x74, 0x69, 0x6e, 0x67, 0x20, 0x77, 0x68, 0x65, 0x74,
+		 0x68, 0x65, 0x72, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x6e,
+		 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x2c, 0x20, 0x6f, 0x72, 0x20,
+		 0x61, 0x6e, 0x79, 0x20, 0x6e, 0x61, 0x74, 0x69, 0x6f, 0x6e,
+		 0x20, 0x73, 0x6f, 0x20, 0x63, 0x6f, 0x6e, 0x63, 0x65, 0x69,
+		 0x76, 0x65, 0x64, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x73, 0x6f,
+		 0x20, 0x64, 0x65, 0x64, 0x69, 0x63, 0x61, 0x74, 0x65, 0x64,
+		 0x2c, 0x20, 0x63, 0x61, 0x6e, 0x20, 0x6c, 0x6f, 0x6e, 0x67,
+		 0x20, 0x65, 0x6e, 0x64, 0x75, 0x72, 0x65, 0x2e ) );
+
+/** "Hello world" with ZLIB header */
+DEFLATE_TEST ( zlib, DEFLATE_ZLIB,
+	DATA ( 0x78, 0xda, 0xf3, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0x28, 0xcf,
+	       0x2f, 0xca, 0x49, 0x01, 0x00, 0x18, 0xab, 0x04, 0x3d ),
+	EXPECT ( 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x20, 0x77, 0x6f, 0x72, 0x6c,
+		 0x64 ) );
+
+/** "Hello world" with GZIP header and file name */
+DEFLATE_TEST ( gzip, DEFLATE_GZIP,
+	DATA ( 0x1f, 0x8b, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x02, 0xff,
+	       0x68, 0x65, 0x6c, 0x6c, 0x6f, 0x2e, 0x74, 0x78, 0x74, 0x00,
+	       0xf3, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0x28, 0xcf, 0x2f, 0xca,
+	       0x49, 0x01, 0x00, 0x52, 0x9e, 0xd6, 0x8b, 0x0b, 0x00, 0x00,
+	       0x00 ),
+	EXPECT ( 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x20, 0x77, 0x6f, 0x72, 0x6c,
+		 0x64 ) );
+
+/** Decompressor used for tests */
+static struct deflate deflate_test_deflate;
+
+/** Output buffer used for tests */
+static uint8_t deflate_test_out[512];
+
+/**
+ * Report DEFLATE test result
+ *
+ * @v test		DEFLATE test
+ * @v in_frag		Length of each fragment of compressed data
+ * @v out_frag		Length by which output buffer is extended
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void deflate_okx ( struct deflate_test *test, size_t in_frag,
+			  size_t out_frag, const char *file,
+			  unsigned int line ) {
+	struct deflate *deflate = &deflate_test_deflate;
+	struct deflate_chunk in;
+	struct deflate_chunk out;
+	size_t offset;
+	size_t len;
+	int rc = 0;
+
+	/* Sanity check */
+	assert ( test->expected_len <= sizeof ( deflate_test_out ) );
+
+	/* Decompress data, one fragment at a time */
+	deflate_init ( deflate, test->format );
+	deflate_chunk_init ( &out, deflate_test_out, 0, 0 );
+	for ( offset = 0 ; offset < test->len ; offset += in_frag ) {
+
+		/* Provide next fragment of input */
+		len = ( offset + in_frag );
+		if ( len > test->len )
+			len = test->len;
+		deflate_chunk_init ( &in, ( ( void * ) test->data ),
+				     offset, len );
+
+		/* Decompress, extending output buffer as needed */
+		while ( ( rc = deflate_inflate ( deflate, &in, &out ) ) == 0 ){
+			if ( ( out.offset < out.len ) ||
+			     ( out.len == sizeof ( deflate_test_out ) ) ||
+			     deflate_finished ( deflate ) )
+				break;
+			out.len += out_frag;
+			if ( out.len > sizeof ( deflate_test_out ) )
+				out.len = sizeof ( deflate_test_out );
+		}
+		okx ( rc == 0, file, line );
+		okx ( in.offset == in.len, file, line );
+	}
+
+	/* Check result */
+	okx ( deflate_finished ( deflate ), file, line );
+	okx ( out.offset == test->expected_len, file, line );
+	okx ( memcmp ( deflate_test_out, test->expected,
+		       test->expected_len ) == 0, file, line );
+}
+#define deflate_ok( test, in_frag, out_frag )				\
+	deflate_okx ( test, in_frag, out_frag, __FILE__, __LINE__ )
+
+/**
+ * Perform DEFLATE self-test
+ *
+ */
+static void deflate_test_exec ( void ) {
+	struct deflate_test *tests[] = {
+		&empty_literal, &literal, &stored, &split, &repeat,
+		&dynamic, &zlib, &gzip,
+	};
+	struct deflate_test *test;
+	unsigned int i;
+
+	for ( i = 0 ; i < ( sizeof ( tests ) / sizeof ( tests[0] ) ) ; i++ ) {
+		test = tests[i];
+
+		/* Test decompression in a single pass */
+		deflate_ok ( test, test->len, sizeof ( deflate_test_out ) );
+
+		/* Test decompression one byte at a time */
+		deflate_ok ( test, 1, 1 );
+
+		/* Test decompression with mismatched fragment sizes */
+		deflate_ok ( test, 3, 7 );
+	}
+}
+
+/** DEFLATE self-test */
+struct self_test deflate_test __self_test = {
+	.name = "deflate",
+	.exec = deflate_test_exec,
+};
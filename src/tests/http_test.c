@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+/** @file
+ *
+ * HTTP self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <ipxe/http.h>
+#include <ipxe/test.h>
+
+/**
+ * Perform HTTP self-tests
+ *
+ */
+static void http_test_exec ( void ) {
+
+	/* Servers not accepting range requests report no length, and
+	 * must be fetched using a single ordinary request.
+	 */
+	ok ( http_stripes ( 0, 4 ) == 0 );
+
+	/* Resources too short to divide use a single request */
+	ok ( http_stripes ( 1, 4 ) == 0 );
+	ok ( http_stripes ( HTTP_MIN_STRIPE_LEN, 4 ) == 0 );
+	ok ( http_stripes ( ( ( 2 * HTTP_MIN_STRIPE_LEN ) - 1 ), 4 ) == 0 );
+
+	/* Only one stream permitted */
+	ok ( http_stripes ( ( 8 * HTTP_MIN_STRIPE_LEN ), 1 ) == 0 );
+
+	/* Resources long enough to divide use stripes */
+	ok ( http_stripes ( ( 2 * HTTP_MIN_STRIPE_LEN ), 4 ) == 2 );
+	ok ( http_stripes ( ( ( 3 * HTTP_MIN_STRIPE_LEN ) + 1 ), 4 ) == 3 );
+
+	/* Number of stripes is limited by number of streams */
+	ok ( http_stripes ( ( 100 * HTTP_MIN_STRIPE_LEN ), 4 ) == 4 );
+}
+
+/** HTTP self-test */
+struct self_test http_test __self_test = {
+	.name = "http",
+	.exec = http_test_exec,
+};
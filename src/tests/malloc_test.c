@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+/** @file
+ *
+ * Memory allocator tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ipxe/io.h>
+#include <ipxe/malloc.h>
+#include <ipxe/profile.h>
+#include <ipxe/test.h>
+
+/** Number of simultaneously allocated test blocks */
+#define MALLOC_TEST_BLOCKS 64
+
+/** Maximum length of a test block */
+#define MALLOC_TEST_MAX_LEN 512
+
+/** Maximum alignment of a test block */
+#define MALLOC_TEST_MAX_ALIGN 256
+
+/** Number of random test iterations */
+#define MALLOC_TEST_RANDOM_COUNT 8192
+
+/** A test block */
+struct malloc_test_block {
+	/** Allocated memory, or NULL */
+	uint8_t *data;
+	/** Length */
+	size_t len;
+	/** Fill pattern */
+	uint8_t fill;
+};
+
+/** Test blocks */
+static struct malloc_test_block malloc_test_blocks[MALLOC_TEST_BLOCKS];
+
+/**
+ * Check that a test block is intact
+ *
+ * @v block		Test block
+ * @ret ok		Test block is intact
+ */
+static int malloc_test_intact ( struct malloc_test_block *block ) {
+	size_t i;
+
+	for ( i = 0 ; i < block->len ; i++ ) {
+		if ( block->data[i] != block->fill )
+			return 0;
+	}
+	return 1;
+}
+
+/**
+ * Free a test block, checking that it is intact
+ *
+ * @v block		Test block
+ */
+static void malloc_test_free ( struct malloc_test_block *block ) {
+
+	ok ( malloc_test_intact ( block ) );
+	free_dma ( block->data, block->len );
+	block->data = NULL;
+}
+
+/**
+ * Perform memory allocator self-tests
+ *
+ */
+static void malloc_test_exec ( void ) {
+	struct malloc_test_block *block;
+	unsigned long started;
+	unsigned long cycles = 0;
+	unsigned long count = 0;
+	size_t initial_free;
+	size_t initial_largest;
+	size_t min_largest;
+	size_t align;
+	unsigned int i;
+	void *ptr;
+
+	/* Record initial heap state */
+	initial_free = freemem;
+	initial_largest = mlargest();
+	min_largest = initial_largest;
+
+	/* Allocate and free random blocks with random alignments */
+	srandom ( 0 );
+	for ( i = 0 ; i < MALLOC_TEST_RANDOM_COUNT ; i++ ) {
+		block = &malloc_test_blocks[ random() % MALLOC_TEST_BLOCKS ];
+		started = profile_timestamp();
+		if ( block->data ) {
+			malloc_test_free ( block );
+		} else {
+			block->len = ( ( random() % MALLOC_TEST_MAX_LEN ) + 1 );
+			block->fill = random();
+			align = ( 1 << ( random() %
+					 fls ( MALLOC_TEST_MAX_ALIGN ) ) );
+			block->data = malloc_dma ( block->len, align );
+			ok ( block->data != NULL );
+			if ( ! block->data )
+				continue;
+			ok ( ( virt_to_phys ( block->data ) &
+			       ( align - 1 ) ) == 0 );
+			memset ( block->data, block->fill, block->len );
+		}
+		cycles += ( profile_timestamp() - started );
+		count++;
+		if ( mlargest() < min_largest )
+			min_largest = mlargest();
+	}
+
+	/* Free all remaining blocks */
+	for ( i = 0 ; i < MALLOC_TEST_BLOCKS ; i++ ) {
+		block = &malloc_test_blocks[i];
+		if ( block->data )
+			malloc_test_free ( block );
+	}
+
+	/* Check that all memory has been coalesced */
+	ok ( freemem == initial_free );
+	ok ( mlargest() == initial_largest );
+
+	/* Check that realloc() preserves contents */
+	ptr = malloc ( 16 );
+	ok ( ptr != NULL );
+	memset ( ptr, 0x5a, 16 );
+	ptr = realloc ( ptr, 1024 );
+	ok ( ptr != NULL );
+	ok ( ptr && ( memcmp ( ptr, "\x5a\x5a\x5a\x5a", 4 ) == 0 ) );
+	free ( ptr );
+	ok ( freemem == initial_free );
+
+	/* Report speed and worst-case fragmentation */
+	printf ( "malloc: %ld cycles per operation, largest free block "
+		 "%zd/%zd bytes at worst\n", ( cycles / count ),
+		 min_largest, initial_largest );
+}
+
+/** Memory allocator self-test */
+struct self_test malloc_test __self_test = {
+	.name = "malloc",
+	.exec = malloc_test_exec,
+};
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+/** @file
+ *
+ * Profiling self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <string.h>
+#include <ipxe/profile.h>
+#include <ipxe/test.h>
+
+/** A profiling test */
+struct profile_test {
+	/** Sample values */
+	const unsigned long *samples;
+	/** Number of samples */
+	unsigned int count;
+	/** Expected mean sample value */
+	unsigned long mean;
+	/** Expected sample variance */
+	unsigned long variance;
+	/** Expected sample standard deviation */
+	unsigned long stddev;
+};
+
+/** Define inline sample data */
+#define DATA(...) { __VA_ARGS__ }
+
+/** Define a profiling test */
+#define PROFILE_TEST( name, MEAN, VARIANCE, STDDEV, SAMPLES )		\
+	static const unsigned long name ## _samples[] = SAMPLES;	\
+	static struct profile_test name = {				\
+		.samples = name ## _samples,				\
+		.count = ( sizeof ( name ## _samples ) /		\
+			   sizeof ( name ## _samples[0] ) ),		\
+		.mean = MEAN,						\
+		.variance = VARIANCE,					\
+		.stddev = STDDEV,					\
+	}
+
+/** Evenly spaced samples */
+PROFILE_TEST ( profile_linear, 350, 20000, 141,
+	       DATA ( 150, 250, 350, 450, 550 ) );
+
+/** Constant samples */
+PROFILE_TEST ( profile_constant, 42, 0, 0,
+	       DATA ( 42, 42, 42, 42, 42, 42, 42, 42 ) );
+
+/** Alternating samples */
+PROFILE_TEST ( profile_alternating, 5, 9, 3,
+	       DATA ( 8, 2, 8, 2, 8, 2, 8, 2 ) );
+
+/** Unordered samples */
+PROFILE_TEST ( profile_unordered, 2000, 666666, 816,
+	       DATA ( 1000, 3000, 2000 ) );
+
+/**
+ * Report a profiling test result
+ *
+ * @v test		Profiling test
+ */
+static void profile_ok ( struct profile_test *test ) {
+	struct profiler profiler;
+	unsigned int i;
+
+	/* Initialise profiler */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+
+	/* Record samples */
+	for ( i = 0 ; i < test->count ; i++ )
+		profile_update ( &profiler, test->samples[i] );
+
+	/* Check resulting statistics */
+	ok ( profiler.count == test->count );
+	ok ( profiler.mean == test->mean );
+	ok ( profile_variance ( &profiler ) == test->variance );
+	ok ( profile_stddev ( &profiler ) == test->stddev );
+}
+
+/**
+ * Perform profiling self-tests
+ *
+ */
+static void profile_test_exec ( void ) {
+	struct profiler profiler;
+
+	/* An empty profiler has no variance */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	ok ( profile_variance ( &profiler ) == 0 );
+	ok ( profile_stddev ( &profiler ) == 0 );
+
+	/* Check statistics */
+	profile_ok ( &profile_linear );
+	profile_ok ( &profile_constant );
+	profile_ok ( &profile_alternating );
+	profile_ok ( &profile_unordered );
+}
+
+/** Profiling self-test */
+struct self_test profile_test __self_test = {
+	.name = "profile",
+	.exec = profile_test_exec,
+};
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+/** @file
+ *
+ * Retry timer tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ipxe/timer.h>
+#include <ipxe/process.h>
+#include <ipxe/retry.h>
+#include <ipxe/test.h>
+
+/** Number of test timers */
+#define RETRY_TEST_COUNT 4096
+
+/** A test timer */
+struct retry_test_timer {
+	/** Retry timer */
+	struct retry_timer timer;
+	/** Expected expiry time (in ticks) */
+	unsigned long expiry;
+	/** Number of times expired */
+	unsigned int expired;
+	/** Expected number of expiries */
+	unsigned int expected;
+	/** Number of times to restart on expiry */
+	unsigned int restart;
+	/** Timer that should be stopped on expiry, if any */
+	struct retry_test_timer *victim;
+};
+
+/** Test timers */
+static struct retry_test_timer retry_test_timers[RETRY_TEST_COUNT];
+
+/** Number of test timers that have expired prematurely */
+static unsigned int retry_test_premature;
+
+/**
+ * Handle test timer expiry
+ *
+ * @v timer		Retry timer
+ * @v fail		Failure indicator
+ */
+static void retry_test_expired ( struct retry_timer *timer,
+				 int fail __unused ) {
+	struct retry_test_timer *test =
+		container_of ( timer, struct retry_test_timer, timer );
+
+	/* Record expiry */
+	test->expired++;
+	if ( ( ( signed long ) ( currticks() - test->expiry ) ) < 0 )
+		retry_test_premature++;
+
+	/* Stop another timer, if applicable */
+	if ( test->victim ) {
+		stop_timer ( &test->victim->timer );
+		test->victim = NULL;
+	}
+
+	/* Restart timer, if applicable */
+	if ( test->restart ) {
+		test->restart--;
+		test->expiry = currticks();
+		start_timer_nodelay ( &test->timer );
+	}
+}
+
+/**
+ * Perform retry timer self-tests
+ *
+ */
+static void retry_test_exec ( void ) {
+	struct retry_test_timer *test;
+	unsigned long timeout;
+	unsigned long start;
+	unsigned long max_timeout;
+	unsigned int running;
+	unsigned int i;
+
+	/* Start many timers with a spread of timeouts, covering
+	 * several revolutions of the timer wheel on platforms with
+	 * fine-grained ticks.
+	 */
+	srandom ( 0 );
+	memset ( retry_test_timers, 0, sizeof ( retry_test_timers ) );
+	retry_test_premature = 0;
+	max_timeout = ( TICKS_PER_SEC * 2 );
+	start = currticks();
+	for ( i = 0 ; i < RETRY_TEST_COUNT ; i++ ) {
+		test = &retry_test_timers[i];
+		timer_init ( &test->timer, retry_test_expired, NULL );
+		timeout = ( random() % max_timeout );
+		test->expiry = ( currticks() + timeout );
+		test->restart = ( ( random() % 4 ) == 0 );
+		test->expected = ( 1 + test->restart );
+		start_timer_fixed ( &test->timer, timeout );
+	}
+
+	/* Restart some timers with a new timeout */
+	for ( i = 0 ; i < RETRY_TEST_COUNT ; i += 7 ) {
+		test = &retry_test_timers[i];
+		timeout = ( random() % max_timeout );
+		test->expiry = ( currticks() + timeout );
+		start_timer_fixed ( &test->timer, timeout );
+	}
+
+	/* Stop some timers explicitly, and arrange for some others to
+	 * be stopped by the expiry of another timer.
+	 */
+	for ( i = 3 ; i < RETRY_TEST_COUNT ; i += 11 ) {
+		test = &retry_test_timers[i];
+		stop_timer ( &test->timer );
+		test->expected = 0;
+	}
+	for ( i = 5 ; i < RETRY_TEST_COUNT ; i += 13 ) {
+		test = &retry_test_timers[i];
+		if ( ! timer_running ( &test->timer ) )
+			continue;
+		test->victim = &retry_test_timers[ i - 1 ];
+		if ( ( ! timer_running ( &test->victim->timer ) ) ||
+		     ( test->victim->expiry == test->expiry ) ) {
+			/* Avoid ambiguous ordering */
+			test->victim = NULL;
+			continue;
+		}
+		test->victim->restart = 0;
+		test->victim->expected =
+			( ( test->expiry < test->victim->expiry ) ? 0 : 1 );
+	}
+
+	/* Run until all timers have stopped */
+	do {
+		step();
+		running = 0;
+		for ( i = 0 ; i < RETRY_TEST_COUNT ; i++ ) {
+			if ( timer_running ( &retry_test_timers[i].timer ) )
+				running++;
+		}
+	} while ( running &&
+		  ( ( currticks() - start ) < ( 2 * max_timeout ) ) );
+	ok ( running == 0 );
+
+	/* Check that each timer expired the expected number of times,
+	 * and never before its expiry time.
+	 */
+	for ( i = 0 ; i < RETRY_TEST_COUNT ; i++ ) {
+		test = &retry_test_timers[i];
+		ok ( test->expired == test->expected );
+	}
+	ok ( retry_test_premature == 0 );
+}
+
+/** Retry timer self-test */
+struct self_test retry_test __self_test = {
+	.name = "retry",
+	.exec = retry_test_exec,
+};
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+/** @file
+ *
+ * TCP/IP checksum tests
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <byteswap.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/profile.h>
+#include <ipxe/test.h>
+
+/** Maximum length of test data */
+#define TCPIP_TEST_MAX_LEN 4096
+
+/** Maximum alignment offset of test data */
+#define TCPIP_TEST_MAX_OFFSET 16
+
+/** Number of random test iterations */
+#define TCPIP_TEST_RANDOM_COUNT 1024
+
+/** Number of speed test iterations */
+#define TCPIP_TEST_SPEED_COUNT 256
+
+/** Length of speed test data */
+#define TCPIP_TEST_SPEED_LEN 1460
+
+/** Test data buffer */
+static uint8_t tcpip_test_data[ TCPIP_TEST_MAX_LEN + TCPIP_TEST_MAX_OFFSET ]
+	__attribute__ (( aligned ( 16 ) ));
+
+/** Test copy destination buffer */
+static uint8_t tcpip_test_copy[ TCPIP_TEST_MAX_LEN + TCPIP_TEST_MAX_OFFSET ]
+	__attribute__ (( aligned ( 16 ) ));
+
+/**
+ * Calculate continued TCP/IP checksum (reference implementation)
+ *
+ * @v partial		Checksum of already-summed data, in network byte order
+ * @v data		Data buffer
+ * @v len		Length of data buffer
+ * @ret cksum		Updated checksum, in network byte order
+ *
+ * This is the simple byte-at-a-time implementation against which
+ * the optimised implementations are verified.
+ */
+static uint16_t tcpip_reference_chksum ( uint16_t partial, const void *data,
+					 size_t len ) {
+	unsigned int cksum = ( ( ~partial ) & 0xffff );
+	unsigned int value;
+	unsigned int i;
+
+	for ( i = 0 ; i < len ; i++ ) {
+		value = * ( ( uint8_t * ) data + i );
+		if ( i & 1 ) {
+			/* Odd bytes: swap on little-endian systems */
+			value = be16_to_cpu ( value );
+		} else {
+			/* Even bytes: swap on big-endian systems */
+			value = le16_to_cpu ( value );
+		}
+		cksum += value;
+		if ( cksum > 0xffff )
+			cksum -= 0xffff;
+	}
+
+	return ( ~cksum );
+}
+
+/**
+ * Report TCP/IP checksum test result
+ *
+ * @v partial		Checksum of already-summed data
+ * @v offset		Offset of data within test buffer
+ * @v len		Length of data
+ * @v copy_offset	Offset of copy within test copy buffer
+ */
+#define tcpip_ok( partial, offset, len, copy_offset ) do {		\
+	const void *data = &tcpip_test_data[offset];			\
+	void *copy = &tcpip_test_copy[copy_offset];			\
+	uint16_t expected;						\
+									\
+	expected = tcpip_reference_chksum ( (partial), data, (len) );	\
+	ok ( tcpip_continue_chksum ( (partial), data, (len) ) ==	\
+	     expected );						\
+	ok ( generic_tcpip_continue_chksum ( (partial), data, (len) ) ==\
+	     expected );						\
+	memset ( tcpip_test_copy, 0, sizeof ( tcpip_test_copy ) );	\
+	ok ( tcpip_copy_chksum ( (partial), copy, data, (len) ) ==	\
+	     expected );						\
+	ok ( memcmp ( copy, data, (len) ) == 0 );			\
+	} while ( 0 )
+
+/**
+ * Test TCP/IP transmit checksum offload
+ *
+ * @v pshdr_csum	Pseudo-header checksum
+ * @v hdrlen		Length of network-layer header
+ * @v len		Length of transport-layer data
+ * @v csum_offset	Offset of checksum field within transport-layer data
+ * @ret ok		Offloaded checksum matches software checksum
+ *
+ * The checksum is filled in once in software and once by emulating
+ * a network device capable of completing the checksum.
+ */
+static int tcpip_tx_offload_ok ( uint16_t pshdr_csum, size_t hdrlen,
+				 size_t len, size_t csum_offset ) {
+	static struct net_device netdev;
+	struct io_buffer iobuf;
+	void *data = tcpip_test_copy;
+	uint16_t *csum = ( data + hdrlen + csum_offset );
+	uint16_t expected;
+
+	/* Calculate checksum in software */
+	memcpy ( data, tcpip_test_data, ( hdrlen + len ) );
+	*csum = 0;
+	iob_populate ( &iobuf, data, ( hdrlen + len ),
+		       sizeof ( tcpip_test_copy ) );
+	netdev.offloads = 0;
+	tcpip_tx_chksum ( &iobuf, &netdev, hdrlen, csum, pshdr_csum );
+	if ( iobuf.flags & IOB_CSUM_PARTIAL )
+		return 0;
+	expected = *csum;
+
+	/* Leave checksum to the emulated network device */
+	*csum = 0;
+	netdev.offloads = NETDEV_OFFLOAD_TX_CSUM;
+	tcpip_tx_chksum ( &iobuf, &netdev, hdrlen, csum, pshdr_csum );
+	if ( ! ( iobuf.flags & IOB_CSUM_PARTIAL ) )
+		return 0;
+	if ( ( iobuf.head + iobuf.csum_start + iobuf.csum_offset ) !=
+	     ( ( void * ) csum ) )
+		return 0;
+	*csum = tcpip_chksum ( ( iobuf.head + iobuf.csum_start ),
+			       ( iob_len ( &iobuf ) - iobuf.csum_start ) );
+
+	return ( *csum == expected );
+}
+
+/**
+ * Report TCP/IP checksum speed
+ *
+ * @v name		Implementation name
+ * @v chksum		Checksum function
+ */
+static void tcpip_speed ( const char *name,
+			  uint16_t ( * chksum ) ( uint16_t partial,
+						  const void *data,
+						  size_t len ) ) {
+	unsigned long started;
+	unsigned long cycles;
+	unsigned long bytes;
+	unsigned int i;
+
+	started = profile_timestamp();
+	for ( i = 0 ; i < TCPIP_TEST_SPEED_COUNT ; i++ ) {
+		chksum ( TCPIP_EMPTY_CSUM, tcpip_test_data,
+			 TCPIP_TEST_SPEED_LEN );
+	}
+	cycles = ( profile_timestamp() - started );
+	if ( ! cycles )
+		cycles = 1;
+	bytes = ( TCPIP_TEST_SPEED_COUNT * TCPIP_TEST_SPEED_LEN );
+	printf ( "TCP/IP checksum (%s): %ld.%02ld bytes/cycle\n", name,
+		 ( bytes / cycles ), ( ( ( bytes * 100 ) / cycles ) % 100 ) );
+}
+
+/**
+ * Calculate continued TCP/IP checksum (via inline wrapper)
+ *
+ * @v partial		Checksum of already-summed data, in network byte order
+ * @v data		Data buffer
+ * @v len		Length of data buffer
+ * @ret cksum		Updated checksum, in network byte order
+ */
+static uint16_t tcpip_optimised_chksum ( uint16_t partial, const void *data,
+					 size_t len ) {
+	return tcpip_continue_chksum ( partial, data, len );
+}
+
+/**
+ * Perform TCP/IP checksum self-tests
+ *
+ */
+static void tcpip_test_exec ( void ) {
+	unsigned int offset;
+	unsigned int copy_offset;
+	unsigned int partial;
+	size_t len;
+	unsigned int i;
+
+	/* Fill test buffer with pseudo-random data */
+	srandom ( 0 );
+	for ( i = 0 ; i < sizeof ( tcpip_test_data ) ; i++ )
+		tcpip_test_data[i] = random();
+
+	/* Test all short lengths at all alignments */
+	for ( offset = 0 ; offset < TCPIP_TEST_MAX_OFFSET ; offset++ ) {
+		for ( len = 0 ; len < 64 ; len++ ) {
+			tcpip_ok ( TCPIP_EMPTY_CSUM, offset, len,
+				   ( len % TCPIP_TEST_MAX_OFFSET ) );
+		}
+	}
+
+	/* Test random lengths, alignments and partial checksums */
+	for ( i = 0 ; i < TCPIP_TEST_RANDOM_COUNT ; i++ ) {
+		offset = ( random() % TCPIP_TEST_MAX_OFFSET );
+		len = ( random() % ( TCPIP_TEST_MAX_LEN + 1 ) );
+		partial = ( random() & 0xffff );
+		copy_offset = ( random() % TCPIP_TEST_MAX_OFFSET );
+		tcpip_ok ( partial, offset, len, copy_offset );
+	}
+
+	/* Test transmit checksum offload */
+	for ( i = 0 ; i < TCPIP_TEST_RANDOM_COUNT ; i++ ) {
+		len = ( 8 + ( random() % ( TCPIP_TEST_MAX_LEN - 64 ) ) );
+		ok ( tcpip_tx_offload_ok ( ( random() & 0xffff ), 20, len,
+					   ( 2 * ( random() % 4 ) ) ) );
+	}
+
+	/* Test worst-case carry propagation */
+	memset ( tcpip_test_data, 0xff, sizeof ( tcpip_test_data ) );
+	tcpip_ok ( 0x0000, 0, TCPIP_TEST_MAX_LEN, 0 );
+	tcpip_ok ( 0x0000, 1, ( TCPIP_TEST_MAX_LEN - 1 ), 2 );
+	tcpip_ok ( 0xffff, 0, TCPIP_TEST_MAX_LEN, 1 );
+	memset ( tcpip_test_data, 0, sizeof ( tcpip_test_data ) );
+	tcpip_ok ( 0x0000, 0, TCPIP_TEST_MAX_LEN, 0 );
+	tcpip_ok ( 0xffff, 3, ( TCPIP_TEST_MAX_LEN - 3 ), 3 );
+
+	/* Report speed of each implementation */
+	tcpip_speed ( "reference", tcpip_reference_chksum );
+	tcpip_speed ( "generic", generic_tcpip_continue_chksum );
+	tcpip_speed ( "optimised", tcpip_optimised_chksum );
+}
+
+/** TCP/IP checksum self-test */
+struct self_test tcpip_test __self_test = {
+	.name = "tcpip",
+	.exec = tcpip_test_exec,
+};
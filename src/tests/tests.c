@@ -29,3 +29,9 @@ REQUIRE_OBJECT ( list_test );
 REQUIRE_OBJECT ( sha1_test );
 REQUIRE_OBJECT ( hmac_drbg_test );
 REQUIRE_OBJECT ( hash_df_test );
+REQUIRE_OBJECT ( tcpip_test );
+REQUIRE_OBJECT ( malloc_test );
+REQUIRE_OBJECT ( retry_test );
+REQUIRE_OBJECT ( profile_test );
+REQUIRE_OBJECT ( deflate_test );
+REQUIRE_OBJECT ( http_test );
@@ -95,6 +95,10 @@ void ifstat ( struct net_device *netdev ) {
 		 ( netdev_link_ok ( netdev ) ? "up" : "down" ),
 		 netdev->tx_stats.good, netdev->tx_stats.bad,
 		 netdev->rx_stats.good, netdev->rx_stats.bad );
+	printf ( "  [TXQ:%u (max %u) RXQ:%u (max %u) RXD:%u]\n",
+		 netdev->tx_depth, netdev->tx_max_depth,
+		 netdev->rx_depth, netdev->rx_max_depth,
+		 netdev->rx_stats.dropped );
 	if ( ! netdev_link_ok ( netdev ) ) {
 		printf ( "  [Link status: %s]\n",
 			 strerror ( netdev->link_rc ) );